@@ -23,6 +23,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <glib.h>
 
 
@@ -38,6 +40,7 @@ get_mime_type_from_magic_numbers (char *buffer)
 		{ "application/x-bzip2", "BZh", 0, 3 },
 		{ "application/x-gzip", "\037\213", 0, 2 },
 		{ "application/x-xz", "\3757zXZ\000", 0, 6 },
+		{ "application/zstd", "\050\265\057\375", 0, 4 },
 		{ NULL, NULL, 0 }
 	};
 	int  i;
@@ -65,6 +68,7 @@ main (int argc, char **argv)
 	int         il, dl, sigsize, offset;
 	const char *mime_type;
 	const char *archive_command;
+	int         fd;
 	char       *command;
 
 	if (argc < 3)
@@ -73,8 +77,10 @@ main (int argc, char **argv)
 	filename = argv[1];
 	cpio_args = g_string_new (argv[2]);
 	for (i = 3; i < argc; i++) {
+		char *arg = g_shell_quote (argv[i]);
 		g_string_append (cpio_args, " ");
-		g_string_append (cpio_args, argv[i]);
+		g_string_append (cpio_args, arg);
+		g_free (arg);
 	}
 
 	stream = fopen (filename, "r");
@@ -123,11 +129,29 @@ main (int argc, char **argv)
 		archive_command = "xz -dc";
 	else if (strcmp (mime_type, "application/x-gzip") == 0)
 		archive_command = "gzip -dc";
+	else if (strcmp (mime_type, "application/zstd") == 0)
+		archive_command = "zstd -dc";
 	else
 		archive_command = "bzip2 -dc";
 	fclose (stream);
 
-	command = g_strdup_printf ("sh -c \"dd if=%s ibs=%u skip=1 2>/dev/null | %s | " CPIO_PATH " %s\"", g_shell_quote (filename), offset, archive_command, cpio_args->str);
+	/* feed the payload to the decompressor directly from the package
+	 * file, positioned at the payload offset, instead of copying it
+	 * through dd. */
+
+	fd = open (filename, O_RDONLY);
+	if (fd < 0)
+		return 1;
+	if ((lseek (fd, offset, SEEK_SET) != offset)
+	    || (dup2 (fd, STDIN_FILENO) < 0))
+	{
+		close (fd);
+		return 1;
+	}
+	if (fd != STDIN_FILENO)
+		close (fd);
+
+	command = g_strdup_printf ("%s | " CPIO_PATH " %s", archive_command, cpio_args->str);
 
 	return system (command);
 }
@@ -681,30 +681,28 @@ _g_file_dir_contains_one_object (GFile *file)
 /* program */
 
 
-gboolean
-_g_program_is_in_path (const char *filename)
+/* Returns the absolute path of the program, or NULL if the program is not
+ * in the path.  The result is cached until the next call to
+ * update_registered_archives_capabilities(). */
+const char *
+_g_program_get_path (const char *filename)
 {
-	char *str;
-	char *value;
-	int   result = FALSE;
-
-	value = g_hash_table_lookup (ProgramsCache, filename);
-	if (value != NULL) {
-		result = (strcmp (value, "1") == 0);
-		return result;
-	}
+	char *path;
 
-	str = g_find_program_in_path (filename);
-	if (str != NULL) {
-		g_free (str);
-		result = TRUE;
-	}
+	if (g_hash_table_lookup_extended (ProgramsCache, filename, NULL, (gpointer *) &path))
+		return path;
 
-	g_hash_table_insert (ProgramsCache,
-			     g_strdup (filename),
-			     result ? "1" : "0");
+	path = g_find_program_in_path (filename);
+	g_hash_table_insert (ProgramsCache, g_strdup (filename), path);
 
-	return result;
+	return path;
+}
+
+
+gboolean
+_g_program_is_in_path (const char *filename)
+{
+	return _g_program_get_path (filename) != NULL;
 }
 
 
@@ -63,6 +63,7 @@ gboolean            _g_file_dir_contains_one_object       (GFile       *file);
 
 /* program */
 
+const char *        _g_program_get_path                   (const char *filename);
 gboolean 	    _g_program_is_in_path		  (const char *filename);
 gboolean 	    _g_program_is_available	          (const char *filename,
 							   gboolean    check);
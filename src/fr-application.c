@@ -34,12 +34,15 @@
 #include "fr-application.h"
 #include "fr-application-menu.h"
 #include "fr-init.h"
+#include "fr-job.h"
+#include "fr-manifest.h"
 #include "glib-utils.h"
 #include "gtk-utils.h"
 
 
 #define ORG_GNOME_ARCHIVEMANAGER_XML "/org/gnome/FileRoller/../data/org.gnome.ArchiveManager1.xml"
 #define SERVICE_TIMEOUT 10
+#define MAX_RUNNING_BATCH_EXTRACTIONS 4
 
 
 gint                ForceDirectoryCreation;
@@ -53,6 +56,9 @@ static char        *arg_default_dir = NULL;
 static gboolean     arg_version = FALSE;
 static gboolean     arg_service = FALSE;
 static gboolean     arg_notify = FALSE;
+static gboolean     arg_no_progress = FALSE;
+static char        *arg_manifest = NULL;
+static char        *arg_verify_manifest = NULL;
 static const char  *program_argv0 = NULL; /* argv[0] from main(); used as the command to restart the program */
 
 
@@ -88,6 +94,17 @@ static const GOptionEntry options[] = {
 	{ "notify", '\0', 0, G_OPTION_ARG_NONE, &arg_notify,
 	  N_("Use the notification system to notify the operation completion"), NULL },
 
+	{ "no-progress", '\0', 0, G_OPTION_ARG_NONE, &arg_no_progress,
+	  N_("Do not show the progress dialog with the '--add-to' and '--extract-to' commands"), NULL },
+
+	{ "manifest", '\0', 0, G_OPTION_ARG_STRING, &arg_manifest,
+	  N_("Save the checksum of the files extracted or added by the '--add-to' and '--extract-to' commands in a manifest, implies '--no-progress'"),
+	  N_("FILE") },
+
+	{ "verify-manifest", '\0', 0, G_OPTION_ARG_STRING, &arg_verify_manifest,
+	  N_("Check the files of the specified folder against a manifest and quit the program"),
+	  N_("FILE") },
+
 	{ "service", '\0', 0, G_OPTION_ARG_NONE, &arg_service,
 	  N_("Start as a service"), NULL },
 
@@ -143,6 +160,281 @@ window_progress_cb (FrWindow *window,
 }
 
 
+/* -- ExtractBatch -- */
+
+
+/* The archives of all the ExtractBatch calls are extracted by a limited
+ * number of jobs: extracting is mostly limited by the disk, running
+ * more jobs than processors only adds seeks.  Without the progress dialog
+ * the archives are extracted by a FrJob instead of a window. */
+
+
+typedef struct {
+	GDBusConnection         *connection;
+	GDBusMethodInvocation   *invocation;
+	GApplicationCommandLine *command_line;
+	GFile                   *destination;
+	gboolean                 use_progress_dialog;
+	int                      n_archives;
+	int                      n_completed;
+	GList                   *running;      /* BatchJob list */
+	GError                  *error;
+	FrManifest              *manifest;
+	GFile                   *manifest_file;
+} BatchData;
+
+
+typedef struct {
+	BatchData *batch;
+	GFile     *archive;
+	GObject   *runner;                   /* FrWindow or FrJob */
+	double     fraction;
+} BatchJob;
+
+
+static GQueue *batch_jobs_queue = NULL;
+static int     n_running_batch_jobs = 0;
+
+
+static void batch_start_next_jobs (void);
+
+
+static void
+batch_data_free (BatchData *batch)
+{
+	_g_object_unref (batch->connection);
+	_g_object_unref (batch->command_line);
+	_g_object_unref (batch->destination);
+	_g_error_free (batch->error);
+	fr_manifest_free (batch->manifest);
+	_g_object_unref (batch->manifest_file);
+	g_free (batch);
+}
+
+
+static void
+batch_job_free (BatchJob *job)
+{
+	g_object_unref (job->archive);
+	g_free (job);
+}
+
+
+static gboolean
+batch_job_progress_cb (GObject  *runner,
+		       double    fraction,
+		       char     *details,
+		       gpointer  user_data)
+{
+	BatchJob  *job = user_data;
+	BatchData *batch = job->batch;
+	FrAction   action;
+	double     total;
+	GList     *scan;
+
+	if (batch->connection == NULL)
+		return TRUE;
+
+	/* each archive is loaded and listed before being extracted, only the
+	 * extraction is counted so the batch progress never goes back. */
+
+	if (FR_IS_JOB (runner))
+		action = fr_job_get_action (FR_JOB (runner));
+	else
+		action = fr_window_get_archive_action (FR_WINDOW (runner));
+	if ((fraction >= 0.0) && (action == FR_ACTION_EXTRACTING_FILES))
+		job->fraction = MAX (job->fraction, CLAMP (fraction, 0.0, 1.0));
+
+	total = batch->n_completed;
+	for (scan = batch->running; scan; scan = scan->next) {
+		BatchJob *running_job = scan->data;
+		total += running_job->fraction;
+	}
+
+	g_dbus_connection_emit_signal (batch->connection,
+				       NULL,
+				       "/org/gnome/ArchiveManager1",
+				       "org.gnome.ArchiveManager1",
+				       "Progress",
+				       g_variant_new ("(ds)",
+						      total / batch->n_archives,
+						      details),
+				       NULL);
+
+	return TRUE;
+}
+
+
+static void
+batch_data_completed (BatchData *batch)
+{
+	if ((batch->manifest != NULL) && (batch->error == NULL))
+		fr_manifest_save (batch->manifest, batch->manifest_file, NULL, &batch->error);
+
+	if (batch->invocation != NULL) {
+		if (batch->error == NULL)
+			g_dbus_method_invocation_return_value (batch->invocation, NULL);
+		else
+			g_dbus_method_invocation_return_error (batch->invocation,
+							       batch->error->domain,
+							       batch->error->code,
+							       "%s",
+							       batch->error->message);
+	}
+
+	if (batch->command_line != NULL) {
+		if (batch->error != NULL) {
+			g_application_command_line_printerr (batch->command_line, "%s\n", batch->error->message);
+			g_application_command_line_set_exit_status (batch->command_line, EXIT_FAILURE);
+		}
+		g_application_release (g_application_get_default ());
+	}
+
+	batch_data_free (batch);
+}
+
+
+static void
+batch_job_ready_cb (GObject  *runner,
+		    GError   *error,
+		    gpointer  user_data)
+{
+	BatchJob  *job = user_data;
+	BatchData *batch = job->batch;
+
+	g_signal_handlers_disconnect_by_data (job->runner, job);
+
+	if ((error != NULL)
+	    && ! g_error_matches (error, FR_ERROR, FR_ERROR_STOPPED)
+	    && (batch->error == NULL))
+	{
+		batch->error = g_error_copy (error);
+	}
+
+	batch->running = g_list_remove (batch->running, job);
+	batch->n_completed++;
+	n_running_batch_jobs--;
+	batch_job_free (job);
+
+	if (batch->n_completed == batch->n_archives)
+		batch_data_completed (batch);
+
+	batch_start_next_jobs ();
+}
+
+
+static void
+batch_job_start (BatchJob *job)
+{
+	BatchData *batch = job->batch;
+
+	batch->running = g_list_prepend (batch->running, job);
+	n_running_batch_jobs++;
+
+	if (! batch->use_progress_dialog) {
+		FrJob *fr_job;
+
+		fr_job = fr_job_new ();
+		job->runner = G_OBJECT (fr_job);
+		g_signal_connect (fr_job, "progress", G_CALLBACK (batch_job_progress_cb), job);
+		g_signal_connect (fr_job, "ready", G_CALLBACK (batch_job_ready_cb), job);
+		fr_job_set_manifest (fr_job, batch->manifest);
+		fr_job_extract (fr_job, job->archive, batch->destination);
+
+		/* the job keeps a reference to itself while running. */
+		g_object_unref (fr_job);
+	}
+	else {
+		GtkWidget *window;
+
+		window = fr_window_new ();
+		fr_window_use_progress_dialog (FR_WINDOW (window), batch->use_progress_dialog);
+		if (batch->destination != NULL)
+			fr_window_set_default_dir (FR_WINDOW (window), batch->destination, TRUE);
+
+		job->runner = G_OBJECT (window);
+		g_signal_connect (window, "progress", G_CALLBACK (batch_job_progress_cb), job);
+		g_signal_connect (window, "ready", G_CALLBACK (batch_job_ready_cb), job);
+
+		fr_window_batch_new (FR_WINDOW (window), C_("Window title", "Extract archive"));
+		if (batch->destination != NULL)
+			fr_window_batch__extract (FR_WINDOW (window), job->archive, batch->destination, batch->use_progress_dialog);
+		else
+			fr_window_batch__extract_here (FR_WINDOW (window), job->archive, batch->use_progress_dialog);
+		fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
+		fr_window_batch_start (FR_WINDOW (window));
+	}
+}
+
+
+static void
+batch_start_next_jobs (void)
+{
+	int max_jobs;
+
+	max_jobs = MIN (g_get_num_processors (), MAX_RUNNING_BATCH_EXTRACTIONS);
+	while ((n_running_batch_jobs < max_jobs) && ! g_queue_is_empty (batch_jobs_queue))
+		batch_job_start (g_queue_pop_head (batch_jobs_queue));
+}
+
+
+static void
+batch_data_extract (BatchData  *batch,
+		    GList      *archives) /* GFile list */
+{
+	GList *scan;
+
+	batch->n_archives = g_list_length (archives);
+	if (batch->n_archives == 0) {
+		batch_data_completed (batch);
+		return;
+	}
+
+	if (batch_jobs_queue == NULL)
+		batch_jobs_queue = g_queue_new ();
+
+	for (scan = archives; scan; scan = scan->next) {
+		BatchJob *job;
+
+		job = g_new0 (BatchJob, 1);
+		job->batch = batch;
+		job->archive = g_object_ref (scan->data);
+		g_queue_push_tail (batch_jobs_queue, job);
+	}
+
+	batch_start_next_jobs ();
+}
+
+
+static void
+extract_batch (GDBusConnection       *connection,
+	       GDBusMethodInvocation *invocation,
+	       char                 **archives,
+	       const char            *destination_uri,
+	       gboolean               use_progress_dialog)
+{
+	BatchData *batch;
+	GList     *file_list;
+	int        i;
+
+	batch = g_new0 (BatchData, 1);
+	batch->connection = g_object_ref (connection);
+	batch->invocation = invocation;
+	if ((destination_uri != NULL) && (strcmp (destination_uri, "") != 0))
+		batch->destination = g_file_new_for_uri (destination_uri);
+	batch->use_progress_dialog = use_progress_dialog;
+
+	file_list = NULL;
+	for (i = 0; (archives != NULL) && (archives[i] != NULL); i++)
+		file_list = g_list_prepend (file_list, g_file_new_for_uri (archives[i]));
+	file_list = g_list_reverse (file_list);
+
+	batch_data_extract (batch, file_list);
+
+	_g_object_list_unref (file_list);
+}
+
+
 static void
 handle_method_call (GDBusConnection       *connection,
 		    const char            *sender,
@@ -161,6 +453,7 @@ handle_method_call (GDBusConnection       *connection,
 
 		g_variant_get (parameters, "(s)", &action);
 
+		compute_supported_archive_types ();
 		if (g_strcmp0 (action, "create") == 0) {
 			supported_types = save_type;
 		}
@@ -217,16 +510,28 @@ handle_method_call (GDBusConnection       *connection,
 			file_list = g_list_prepend (file_list, g_file_new_for_uri (files[i]));
 		file_list = g_list_reverse (file_list);
 
-		window = fr_window_new ();
-		fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
+		if (! use_progress_dialog) {
+			FrJob *job;
 
-		g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
-		g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+			job = fr_job_new ();
+			g_signal_connect (job, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (job, "ready", G_CALLBACK (window_ready_cb), invocation);
+			fr_job_add_files (job, file, file_list);
 
-		fr_window_batch_new (FR_WINDOW (window), _("Compress"));
-		fr_window_batch__add_files (FR_WINDOW (window), file, file_list);
-		fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
-		fr_window_batch_start (FR_WINDOW (window));
+			g_object_unref (job);
+		}
+		else {
+			window = fr_window_new ();
+			fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
+
+			g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+
+			fr_window_batch_new (FR_WINDOW (window), _("Compress"));
+			fr_window_batch__add_files (FR_WINDOW (window), file, file_list);
+			fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
+			fr_window_batch_start (FR_WINDOW (window));
+		}
 
 		g_object_unref (file);
 		_g_object_list_unref (file_list);
@@ -281,24 +586,36 @@ handle_method_call (GDBusConnection       *connection,
 		archive = g_file_new_for_uri (archive_uri);
 		destination = g_file_new_for_uri (destination_uri);
 
-		window = fr_window_new ();
-		fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
-		if ((destination_uri != NULL) & (strcmp (destination_uri, "") != 0)) {
-			GFile *file;
+		if (! use_progress_dialog) {
+			FrJob *job;
 
-			file = g_file_new_for_uri (destination_uri);
-			fr_window_set_default_dir (FR_WINDOW (window), file, TRUE);
+			job = fr_job_new ();
+			g_signal_connect (job, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (job, "ready", G_CALLBACK (window_ready_cb), invocation);
+			fr_job_extract (job, archive, destination);
 
-			g_object_unref (file);
+			g_object_unref (job);
 		}
+		else {
+			window = fr_window_new ();
+			fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
+			if ((destination_uri != NULL) & (strcmp (destination_uri, "") != 0)) {
+				GFile *file;
 
-		g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
-		g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+				file = g_file_new_for_uri (destination_uri);
+				fr_window_set_default_dir (FR_WINDOW (window), file, TRUE);
 
-		fr_window_batch_new (FR_WINDOW (window), C_("Window title", "Extract archive"));
-		fr_window_batch__extract (FR_WINDOW (window), archive, destination, use_progress_dialog);
-		fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
-		fr_window_batch_start (FR_WINDOW (window));
+				g_object_unref (file);
+			}
+
+			g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+
+			fr_window_batch_new (FR_WINDOW (window), C_("Window title", "Extract archive"));
+			fr_window_batch__extract (FR_WINDOW (window), archive, destination, use_progress_dialog);
+			fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
+			fr_window_batch_start (FR_WINDOW (window));
+		}
 
 		g_object_unref (archive);
 		g_object_unref (destination);
@@ -315,20 +632,43 @@ handle_method_call (GDBusConnection       *connection,
 
 		archive = g_file_new_for_uri (uri);
 
-		window = fr_window_new ();
-		fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
+		if (! use_progress_dialog) {
+			FrJob *job;
 
-		g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
-		g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+			job = fr_job_new ();
+			g_signal_connect (job, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (job, "ready", G_CALLBACK (window_ready_cb), invocation);
+			fr_job_extract (job, archive, NULL);
 
-		fr_window_batch_new (FR_WINDOW (window), C_("Window title", "Extract archive"));
-		fr_window_batch__extract_here (FR_WINDOW (window), archive, use_progress_dialog);
-		fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
-		fr_window_batch_start (FR_WINDOW (window));
+			g_object_unref (job);
+		}
+		else {
+			window = fr_window_new ();
+			fr_window_use_progress_dialog (FR_WINDOW (window), use_progress_dialog);
+
+			g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), connection);
+			g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), invocation);
+
+			fr_window_batch_new (FR_WINDOW (window), C_("Window title", "Extract archive"));
+			fr_window_batch__extract_here (FR_WINDOW (window), archive, use_progress_dialog);
+			fr_window_batch_append_action (FR_WINDOW (window), FR_BATCH_ACTION_QUIT, NULL, NULL);
+			fr_window_batch_start (FR_WINDOW (window));
+		}
 
 		g_object_unref (archive);
 		g_free (uri);
 	}
+	else if (g_strcmp0 (method_name, "ExtractBatch") == 0) {
+		char     **archives;
+		char      *destination_uri;
+		gboolean   use_progress_dialog;
+
+		g_variant_get (parameters, "(^assb)", &archives, &destination_uri, &use_progress_dialog);
+		extract_batch (connection, invocation, archives, destination_uri, use_progress_dialog);
+
+		g_strfreev (archives);
+		g_free (destination_uri);
+	}
 }
 
 
@@ -513,11 +853,96 @@ fr_application_command_line_finished (GApplication *application,
 	arg_extract_here = FALSE;
 	arg_default_dir = NULL;
 	arg_version = FALSE;
+	arg_no_progress = FALSE;
+	arg_manifest = NULL;
+	arg_verify_manifest = NULL;
 
 	return status;
 }
 
 
+typedef struct {
+	GApplicationCommandLine *command_line;
+	FrManifest              *manifest;
+	GFile                   *manifest_file;
+} CommandLineData;
+
+
+static CommandLineData *
+command_line_data_new (GApplicationCommandLine *command_line,
+		       FrManifest              *manifest,
+		       GFile                   *manifest_file)
+{
+	CommandLineData *data;
+
+	data = g_new0 (CommandLineData, 1);
+	data->command_line = g_object_ref (command_line);
+	data->manifest = manifest;
+	data->manifest_file = _g_object_ref (manifest_file);
+
+	return data;
+}
+
+
+static void
+command_line_data_free (CommandLineData *data)
+{
+	fr_manifest_free (data->manifest);
+	_g_object_unref (data->manifest_file);
+	g_object_unref (data->command_line);
+	g_free (data);
+}
+
+
+static void
+command_line_job_ready_cb (FrJob    *job,
+			   GError   *error,
+			   gpointer  user_data)
+{
+	CommandLineData *data = user_data;
+	GError          *local_error = NULL;
+
+	if ((error == NULL) && (data->manifest != NULL)) {
+		if (! fr_manifest_save (data->manifest, data->manifest_file, NULL, &local_error))
+			error = local_error;
+	}
+
+	if ((error != NULL) && ! g_error_matches (error, FR_ERROR, FR_ERROR_STOPPED)) {
+		g_application_command_line_printerr (data->command_line, "%s\n", error->message);
+		g_application_command_line_set_exit_status (data->command_line, EXIT_FAILURE);
+	}
+
+	_g_error_free (local_error);
+	command_line_data_free (data);
+	g_application_release (g_application_get_default ());
+}
+
+
+static void
+verify_manifest_ready_cb (GObject      *source_object,
+			  GAsyncResult *result,
+			  gpointer      user_data)
+{
+	CommandLineData *data = user_data;
+	GList           *failures = NULL;
+	GError          *error = NULL;
+
+	if (! fr_manifest_verify_finish (data->manifest, result, &failures, &error)) {
+		GList *scan;
+
+		for (scan = failures; scan; scan = scan->next)
+			g_application_command_line_printerr (data->command_line, "%s\n", (char *) scan->data);
+		g_application_command_line_printerr (data->command_line, "%s\n", error->message);
+		g_application_command_line_set_exit_status (data->command_line, EXIT_FAILURE);
+	}
+
+	_g_string_list_free (failures);
+	_g_error_free (error);
+	command_line_data_free (data);
+	g_application_release (g_application_get_default ());
+}
+
+
 static int
 fr_application_command_line (GApplication            *application,
                              GApplicationCommandLine *command_line)
@@ -529,6 +954,7 @@ fr_application_command_line (GApplication            *application,
 	GFile           *extraction_destination = NULL;
 	GFile           *add_to_archive = NULL;
 	GFile           *default_directory = NULL;
+	GFile           *manifest_file = NULL;
 
 	argv = g_application_command_line_get_arguments (command_line, &argc);
 
@@ -546,6 +972,34 @@ fr_application_command_line (GApplication            *application,
 	g_strfreev (argv);
 	g_option_context_free (context);
 
+	if (arg_verify_manifest != NULL) { /* Check a folder against a manifest */
+		GFile      *manifest_file;
+		GFile      *folder;
+		FrManifest *manifest;
+
+		manifest_file = g_application_command_line_create_file_for_arg (command_line, arg_verify_manifest);
+		manifest = fr_manifest_load (manifest_file, NULL, &error);
+		g_object_unref (manifest_file);
+
+		if (manifest == NULL) {
+			g_application_command_line_printerr (command_line, "%s\n", error->message);
+			g_error_free (error);
+			return fr_application_command_line_finished (application, EXIT_FAILURE);
+		}
+
+		folder = g_application_command_line_create_file_for_arg (command_line, (remaining_args != NULL) ? remaining_args[0] : ".");
+		g_application_hold (application);
+		fr_manifest_verify (manifest,
+				    folder,
+				    NULL,
+				    verify_manifest_ready_cb,
+				    command_line_data_new (command_line, manifest, NULL));
+
+		g_object_unref (folder);
+
+		return fr_application_command_line_finished (application, EXIT_SUCCESS);
+	}
+
 	if (remaining_args == NULL) { /* No archive specified. */
 		if (! arg_service)
 			gtk_widget_show (fr_window_new ());
@@ -561,7 +1015,74 @@ fr_application_command_line (GApplication            *application,
 	if (arg_default_dir != NULL)
 		default_directory = g_application_command_line_create_file_for_arg (command_line, arg_default_dir);
 
-	if ((arg_add_to != NULL) || (arg_add == 1)) { /* Add files to an archive */
+	if (arg_manifest != NULL)
+		manifest_file = g_application_command_line_create_file_for_arg (command_line, arg_manifest);
+
+	if ((arg_add_to != NULL) && (arg_no_progress || (manifest_file != NULL))) { /* Add files without a window */
+		FrManifest  *manifest = NULL;
+		FrJob       *job;
+		GList       *file_list;
+		const char  *filename;
+		int          i = 0;
+
+		file_list = NULL;
+		while ((filename = remaining_args[i++]) != NULL)
+			file_list = g_list_prepend (file_list, g_application_command_line_create_file_for_arg (command_line, filename));
+		file_list = g_list_reverse (file_list);
+
+		g_application_hold (application);
+
+		/* the manifest paths are the paths in the archive */
+
+		if (manifest_file != NULL)
+			manifest = fr_manifest_new (NULL);
+
+		job = fr_job_new ();
+		g_signal_connect (job, "ready", G_CALLBACK (command_line_job_ready_cb), command_line_data_new (command_line, manifest, manifest_file));
+		fr_job_set_manifest (job, manifest);
+		fr_job_add_files (job, add_to_archive, file_list);
+
+		g_object_unref (job);
+		_g_object_list_unref (file_list);
+	}
+	else if (((arg_extract_to != NULL) || (arg_extract_here == 1)) && (arg_no_progress || (manifest_file != NULL))) { /* Extract without a window */
+		BatchData  *batch;
+		GList      *file_list;
+		const char *archive;
+		int         i = 0;
+
+		file_list = NULL;
+		while ((archive = remaining_args[i++]) != NULL)
+			file_list = g_list_prepend (file_list, g_application_command_line_create_file_for_arg (command_line, archive));
+		file_list = g_list_reverse (file_list);
+
+		g_application_hold (application);
+
+		batch = g_new0 (BatchData, 1);
+		batch->command_line = g_object_ref (command_line);
+		batch->destination = _g_object_ref (extraction_destination);
+		batch->use_progress_dialog = FALSE;
+		if (manifest_file != NULL) {
+			GFile *root;
+
+			/* the manifest paths are relative to the destination,
+			 * or to the folder of the first archive when each
+			 * archive is extracted next to itself. */
+
+			if (extraction_destination != NULL)
+				root = g_object_ref (extraction_destination);
+			else
+				root = g_file_get_parent (file_list->data);
+			batch->manifest = fr_manifest_new (root);
+			batch->manifest_file = g_object_ref (manifest_file);
+
+			g_object_unref (root);
+		}
+		batch_data_extract (batch, file_list);
+
+		_g_object_list_unref (file_list);
+	}
+	else if ((arg_add_to != NULL) || (arg_add == 1)) { /* Add files to an archive */
 		GtkWidget   *window;
 		GList       *file_list;
 		const char  *filename;
@@ -639,6 +1160,7 @@ fr_application_command_line (GApplication            *application,
 		}
 	}
 
+	_g_object_unref (manifest_file);
 	_g_object_unref (default_directory);
 	_g_object_unref (add_to_archive);
 	_g_object_unref (extraction_destination);
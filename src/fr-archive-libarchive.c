@@ -20,13 +20,16 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <string.h>
 #include <pwd.h>
 #include <grp.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
+#include <gio/gfiledescriptorbased.h>
 #include <archive.h>
 #include <archive_entry.h>
 #include "file-data.h"
@@ -36,10 +39,11 @@
 #include "gio-utils.h"
 #include "glib-utils.h"
 #include "typedefs.h"
+#include "volume-set.h"
 
 
 #define BUFFER_SIZE (64 * 1024)
-#define FILE_ATTRIBUTES_NEEDED_BY_ARCHIVE_ENTRY ("standard::*,time::*,access::*,unix::*")
+#define FILE_ATTRIBUTES_NEEDED_BY_ARCHIVE_ENTRY ("standard::type,standard::size,standard::symlink-target,time::*,unix::*")
 
 
 G_DEFINE_TYPE (FrArchiveLibarchive, fr_archive_libarchive, FR_TYPE_ARCHIVE)
@@ -105,26 +109,36 @@ fr_archive_libarchive_get_capabilities (FrArchive  *archive,
 					const char *mime_type,
 					gboolean    check_command)
 {
-	FrArchiveCap capabilities;
+	FrArchiveCap  capabilities;
+	GFile        *file;
+	gboolean      prefer_tools;
 
 	capabilities = FR_ARCHIVE_CAN_STORE_MANY_FILES;
 
+	/* the external tools need a local copy of the whole archive, remote
+	 * archives are read as a stream instead.  The volumes of a split
+	 * archive are only joined by the stream reader. */
+	file = fr_archive_get_file (archive);
+	prefer_tools = (file == NULL) || (g_file_is_native (file) && ! volume_set_is_split_volume (file));
+
 	/* write-only formats */
 	if (strcmp (mime_type, "application/x-7z-compressed") == 0) {
-		capabilities |= FR_ARCHIVE_CAN_WRITE;
+		capabilities |= FR_ARCHIVE_CAN_WRITE | FR_ARCHIVE_CAN_CREATE_VOLUMES;
 		return capabilities;
 	}
 
 	/* give priority to 7za that supports CAB files better. */
-	if ((strcmp (mime_type, "application/vnd.ms-cab-compressed") == 0)
+	if (prefer_tools
+	    && (strcmp (mime_type, "application/vnd.ms-cab-compressed") == 0)
 	    && _g_program_is_available ("7za", check_command))
 	{
 		return capabilities;
 	}
 
 	/* give priority to 7z, unzip and zip that supports ZIP files better. */
-	if ((strcmp (mime_type, "application/zip") == 0)
-	    || (strcmp (mime_type, "application/x-cbz") == 0))
+	if (prefer_tools
+	    && ((strcmp (mime_type, "application/zip") == 0)
+		|| (strcmp (mime_type, "application/x-cbz") == 0)))
 	{
 		if (_g_program_is_available ("7z", check_command)) {
 			return capabilities;
@@ -133,14 +147,15 @@ fr_archive_libarchive_get_capabilities (FrArchive  *archive,
 			capabilities |= FR_ARCHIVE_CAN_READ;
 		}
 		if (!_g_program_is_available ("zip", check_command)) {
-			capabilities |= FR_ARCHIVE_CAN_WRITE;
+			capabilities |= FR_ARCHIVE_CAN_WRITE | FR_ARCHIVE_CAN_CREATE_VOLUMES;
 		}
 		return capabilities;
 	}
 
 	/* give priority to utilities that support RAR files better. */
-	if ((strcmp (mime_type, "application/x-rar") == 0)
-	    || (strcmp (mime_type, "application/x-cbr") == 0))
+	if (prefer_tools
+	    && ((strcmp (mime_type, "application/x-rar") == 0)
+		|| (strcmp (mime_type, "application/x-cbr") == 0)))
 	{
 		if (_g_program_is_available ("rar", check_command)
 		    || _g_program_is_available ("unrar", check_command)
@@ -170,8 +185,12 @@ fr_archive_libarchive_get_capabilities (FrArchive  *archive,
 		return capabilities;
 	}
 
+	/* multi-volumes are read-only */
+	if ((archive->files->len > 0) && archive->multi_volume)
+		return capabilities;
+
 	/* all other formats can be read and written */
-	capabilities |= FR_ARCHIVE_CAN_WRITE;
+	capabilities |= FR_ARCHIVE_CAN_WRITE | FR_ARCHIVE_CAN_CREATE_VOLUMES;
 
 	return capabilities;
 }
@@ -185,6 +204,502 @@ fr_archive_libarchive_get_packages (FrArchive  *archive,
 }
 
 
+/* BlockCache */
+
+
+/* Remote archives are read in blocks, kept in memory and in the user cache
+ * folder, so that reading the central directory of a zip file or a single
+ * file doesn't transfer the whole archive. */
+
+
+#define CACHE_BLOCK_SIZE (256 * 1024)
+#define CACHE_READ_AHEAD 4                        /* blocks */
+#define CACHE_MAX_MEMORY_BLOCKS 64
+#define CACHE_MAX_DISK_BLOCKS 1024                /* for each archive */
+#define CACHE_MAX_DISK_SIZE (512 * 1024 * 1024)   /* for all the archives */
+#define CACHE_MAX_AGE (24 * 60 * 60)              /* seconds */
+
+
+typedef struct {
+	GInputStream *istream;
+	goffset       size;
+	goffset       position;
+	GHashTable   *blocks;         /* block number -> GBytes */
+	GQueue       *lru;            /* block numbers, most recently used first */
+	GFile        *cache_dir;      /* NULL if the blocks are only kept in memory */
+	int           n_disk_blocks;
+	gboolean      cache_dir_used;
+} BlockCache;
+
+
+typedef struct {
+	GFile   *dir;
+	guint64  mtime;
+	goffset  size;
+	int      n_blocks;
+} CacheDirInfo;
+
+
+static void
+cache_dir_info_free (CacheDirInfo *dir_info)
+{
+	g_object_unref (dir_info->dir);
+	g_free (dir_info);
+}
+
+
+static int
+cache_dir_info_cmp_mtime (gconstpointer a,
+			  gconstpointer b)
+{
+	const CacheDirInfo *dir_info_a = * (CacheDirInfo **) a;
+	const CacheDirInfo *dir_info_b = * (CacheDirInfo **) b;
+
+	if (dir_info_a->mtime < dir_info_b->mtime)
+		return -1;
+	if (dir_info_a->mtime > dir_info_b->mtime)
+		return 1;
+	return 0;
+}
+
+
+static void
+cache_dir_info_count_blocks (CacheDirInfo *dir_info,
+			     GCancellable *cancellable)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo       *info;
+
+	enumerator = g_file_enumerate_children (dir_info->dir,
+						G_FILE_ATTRIBUTE_STANDARD_SIZE,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable,
+						NULL);
+	if (enumerator == NULL)
+		return;
+
+	while ((info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+		dir_info->size += g_file_info_get_size (info);
+		dir_info->n_blocks++;
+		g_object_unref (info);
+	}
+	g_object_unref (enumerator);
+}
+
+
+/* The folder name identifies the archive.  The folders of the archives not
+ * read recently are removed, then the oldest ones if the cache is bigger
+ * than CACHE_MAX_DISK_SIZE.  @n_blocks is set to the number of blocks
+ * already saved for the archive. */
+static GFile *
+block_cache_get_cache_dir (GFile        *file,
+			   GFileInfo    *info,
+			   int          *n_blocks,
+			   GCancellable *cancellable)
+{
+	GFile           *blocks_dir;
+	GFileEnumerator *enumerator;
+	char            *path;
+	char            *uri;
+	char            *key;
+	char            *id;
+	GFile           *cache_dir;
+	guint64          now;
+	GPtrArray       *dirs;
+	goffset          total_size;
+	int              i;
+
+	*n_blocks = 0;
+
+	path = g_build_filename (g_get_user_cache_dir (), "file-roller", "blocks", NULL);
+	blocks_dir = g_file_new_for_path (path);
+	g_free (path);
+
+	/* the blocks of a modified archive are not valid anymore. */
+
+	uri = g_file_get_uri (file);
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_ETAG_VALUE))
+		id = g_strdup (g_file_info_get_etag (info));
+	else
+		id = g_strdup_printf ("%" G_GUINT64_FORMAT, g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	key = g_strdup_printf ("%s\n%" G_GOFFSET_FORMAT "\n%s", uri, g_file_info_get_size (info), id);
+	g_free (id);
+	g_free (uri);
+
+	id = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+	cache_dir = g_file_get_child (blocks_dir, id);
+
+	/* remove the blocks of the archives not read recently. */
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	dirs = g_ptr_array_new_with_free_func ((GDestroyNotify) cache_dir_info_free);
+	total_size = 0;
+	enumerator = g_file_enumerate_children (blocks_dir,
+						G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable,
+						NULL);
+	if (enumerator != NULL) {
+		GFileInfo *child_info;
+
+		while ((child_info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL) {
+			CacheDirInfo *dir_info;
+
+			dir_info = g_new0 (CacheDirInfo, 1);
+			dir_info->dir = g_file_get_child (blocks_dir, g_file_info_get_name (child_info));
+			dir_info->mtime = g_file_info_get_attribute_uint64 (child_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+			if (dir_info->mtime + CACHE_MAX_AGE < now) {
+				_g_file_remove_directory (dir_info->dir, NULL, NULL);
+				cache_dir_info_free (dir_info);
+			}
+			else if (g_file_equal (dir_info->dir, cache_dir)) {
+				cache_dir_info_count_blocks (dir_info, cancellable);
+				*n_blocks = dir_info->n_blocks;
+				cache_dir_info_free (dir_info);
+			}
+			else {
+				cache_dir_info_count_blocks (dir_info, cancellable);
+				total_size += dir_info->size;
+				g_ptr_array_add (dirs, dir_info);
+			}
+			g_object_unref (child_info);
+		}
+		g_object_unref (enumerator);
+	}
+
+	/* keep room for the blocks of this archive, removing the archives
+	 * read least recently. */
+
+	g_ptr_array_sort (dirs, cache_dir_info_cmp_mtime);
+	for (i = 0; (i < dirs->len) && (total_size + (goffset) CACHE_MAX_DISK_BLOCKS * CACHE_BLOCK_SIZE > CACHE_MAX_DISK_SIZE); i++) {
+		CacheDirInfo *dir_info = g_ptr_array_index (dirs, i);
+
+		_g_file_remove_directory (dir_info->dir, NULL, NULL);
+		total_size -= dir_info->size;
+	}
+
+	if (! _g_file_make_directory_tree (cache_dir, 0700, NULL))
+		_g_clear_object (&cache_dir);
+
+	g_ptr_array_unref (dirs);
+	g_free (id);
+	g_free (key);
+	g_object_unref (blocks_dir);
+
+	return cache_dir;
+}
+
+
+static BlockCache *
+block_cache_new (GFile         *file,
+		 GInputStream  *istream,
+		 GCancellable  *cancellable)
+{
+	GFileInfo  *info;
+	BlockCache *cache;
+
+	if (! g_seekable_can_seek (G_SEEKABLE (istream)))
+		return NULL;
+
+	info = g_file_input_stream_query_info (G_FILE_INPUT_STREAM (istream),
+					       G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_ETAG_VALUE "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					       cancellable,
+					       NULL);
+	if (info == NULL)
+		info = g_file_query_info (file,
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_ETAG_VALUE "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
+	if (info == NULL)
+		return NULL;
+
+	if (! g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
+		g_object_unref (info);
+		return NULL;
+	}
+
+	cache = g_new0 (BlockCache, 1);
+	cache->istream = g_object_ref (istream);
+	cache->size = g_file_info_get_size (info);
+	cache->position = 0;
+	cache->blocks = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_bytes_unref);
+	cache->lru = g_queue_new ();
+	cache->cache_dir = block_cache_get_cache_dir (file, info, &cache->n_disk_blocks, cancellable);
+
+	g_object_unref (info);
+
+	return cache;
+}
+
+
+static void
+block_cache_free (BlockCache *cache)
+{
+	if (cache == NULL)
+		return;
+	g_object_unref (cache->istream);
+	g_hash_table_unref (cache->blocks);
+	g_queue_free (cache->lru);
+	_g_object_unref (cache->cache_dir);
+	g_free (cache);
+}
+
+
+static gsize
+block_cache_get_block_size (BlockCache *cache,
+			    guint       n_block)
+{
+	return MIN (CACHE_BLOCK_SIZE, cache->size - (goffset) n_block * CACHE_BLOCK_SIZE);
+}
+
+
+static GFile *
+block_cache_get_block_file (BlockCache *cache,
+			    guint       n_block)
+{
+	char  *name;
+	GFile *file;
+
+	name = g_strdup_printf ("%u", n_block);
+	file = g_file_get_child (cache->cache_dir, name);
+	g_free (name);
+
+	return file;
+}
+
+
+static void
+block_cache_add_block (BlockCache *cache,
+		       guint       n_block,
+		       GBytes     *bytes)
+{
+	g_hash_table_insert (cache->blocks, GUINT_TO_POINTER (n_block), g_bytes_ref (bytes));
+	g_queue_push_head (cache->lru, GUINT_TO_POINTER (n_block));
+
+	if (g_queue_get_length (cache->lru) > CACHE_MAX_MEMORY_BLOCKS)
+		g_hash_table_remove (cache->blocks, g_queue_pop_tail (cache->lru));
+}
+
+
+static GBytes *
+block_cache_load_block (BlockCache    *cache,
+			guint          n_block,
+			GCancellable  *cancellable)
+{
+	GFile  *file;
+	char   *buffer;
+	gsize   size;
+	GBytes *bytes;
+
+	if (cache->cache_dir == NULL)
+		return NULL;
+
+	bytes = NULL;
+	file = block_cache_get_block_file (cache, n_block);
+	if (g_file_load_contents (file, cancellable, &buffer, &size, NULL, NULL)) {
+		if (size == block_cache_get_block_size (cache, n_block))
+			bytes = g_bytes_new_take (buffer, size);
+		else
+			g_free (buffer);
+	}
+	g_object_unref (file);
+
+	/* the age of the cached archives is the modification time of their
+	 * folder, reading the blocks doesn't change it. */
+
+	if ((bytes != NULL) && ! cache->cache_dir_used) {
+		g_file_set_attribute_uint64 (cache->cache_dir,
+					     G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					     g_get_real_time () / G_USEC_PER_SEC,
+					     G_FILE_QUERY_INFO_NONE,
+					     cancellable,
+					     NULL);
+		cache->cache_dir_used = TRUE;
+	}
+
+	return bytes;
+}
+
+
+static void
+block_cache_save_block (BlockCache    *cache,
+			guint          n_block,
+			GBytes        *bytes,
+			GCancellable  *cancellable)
+{
+	GFile *file;
+
+	if ((cache->cache_dir == NULL) || (cache->n_disk_blocks >= CACHE_MAX_DISK_BLOCKS))
+		return;
+
+	file = block_cache_get_block_file (cache, n_block);
+	if (g_file_replace_contents (file,
+				     g_bytes_get_data (bytes, NULL),
+				     g_bytes_get_size (bytes),
+				     NULL,
+				     FALSE,
+				     G_FILE_CREATE_PRIVATE,
+				     NULL,
+				     cancellable,
+				     NULL))
+	{
+		cache->n_disk_blocks++;
+	}
+	g_object_unref (file);
+}
+
+
+/* Reads @n_block and the following blocks not in memory with a single
+ * request. */
+static GBytes *
+block_cache_read_blocks (BlockCache    *cache,
+			 guint          n_block,
+			 GCancellable  *cancellable,
+			 GError       **error)
+{
+	guint   n_blocks;
+	gsize   size;
+	char   *buffer;
+	gsize   bytes_read;
+	gsize   offset;
+	GBytes *result;
+	guint   i;
+
+	n_blocks = 1;
+	size = block_cache_get_block_size (cache, n_block);
+	while ((n_blocks < CACHE_READ_AHEAD)
+	       && ((goffset) (n_block + n_blocks) * CACHE_BLOCK_SIZE < cache->size)
+	       && ! g_hash_table_contains (cache->blocks, GUINT_TO_POINTER (n_block + n_blocks)))
+	{
+		size += block_cache_get_block_size (cache, n_block + n_blocks);
+		n_blocks++;
+	}
+
+	if (! g_seekable_seek (G_SEEKABLE (cache->istream), (goffset) n_block * CACHE_BLOCK_SIZE, G_SEEK_SET, cancellable, error))
+		return NULL;
+
+	buffer = g_malloc (size);
+	if (! g_input_stream_read_all (cache->istream, buffer, size, &bytes_read, cancellable, error)) {
+		g_free (buffer);
+		return NULL;
+	}
+
+	/* the file is shorter than expected, don't cache the last block. */
+
+	if (bytes_read < size)
+		cache->size = (goffset) n_block * CACHE_BLOCK_SIZE + bytes_read;
+
+	result = NULL;
+	offset = 0;
+	for (i = 0; (i < n_blocks) && (offset < bytes_read); i++) {
+		gsize   block_size = MIN (CACHE_BLOCK_SIZE, bytes_read - offset);
+		GBytes *bytes;
+
+		bytes = g_bytes_new (buffer + offset, block_size);
+		block_cache_add_block (cache, n_block + i, bytes);
+		if (block_size == block_cache_get_block_size (cache, n_block + i))
+			block_cache_save_block (cache, n_block + i, bytes, cancellable);
+		if (i == 0)
+			result = g_bytes_ref (bytes);
+		g_bytes_unref (bytes);
+
+		offset += block_size;
+	}
+
+	g_free (buffer);
+
+	if (result == NULL)
+		result = g_bytes_new (NULL, 0);
+
+	return result;
+}
+
+
+static GBytes *
+block_cache_get_block (BlockCache    *cache,
+		       guint          n_block,
+		       GCancellable  *cancellable,
+		       GError       **error)
+{
+	GBytes *bytes;
+
+	bytes = g_hash_table_lookup (cache->blocks, GUINT_TO_POINTER (n_block));
+	if (bytes != NULL) {
+		g_queue_remove (cache->lru, GUINT_TO_POINTER (n_block));
+		g_queue_push_head (cache->lru, GUINT_TO_POINTER (n_block));
+		return g_bytes_ref (bytes);
+	}
+
+	bytes = block_cache_load_block (cache, n_block, cancellable);
+	if (bytes != NULL) {
+		block_cache_add_block (cache, n_block, bytes);
+		return bytes;
+	}
+
+	return block_cache_read_blocks (cache, n_block, cancellable, error);
+}
+
+
+static gssize
+block_cache_read (BlockCache    *cache,
+		  void          *buffer,
+		  gsize          size,
+		  GCancellable  *cancellable,
+		  GError       **error)
+{
+	guint   n_block;
+	gsize   offset;
+	GBytes *bytes;
+	gsize   block_size;
+	gsize   bytes_read;
+
+	if (cache->position >= cache->size)
+		return 0;
+
+	n_block = cache->position / CACHE_BLOCK_SIZE;
+	offset = cache->position % CACHE_BLOCK_SIZE;
+	bytes = block_cache_get_block (cache, n_block, cancellable, error);
+	if (bytes == NULL)
+		return -1;
+
+	block_size = g_bytes_get_size (bytes);
+	bytes_read = (offset < block_size) ? MIN (size, block_size - offset) : 0;
+	memcpy (buffer, (const char *) g_bytes_get_data (bytes, NULL) + offset, bytes_read);
+	cache->position += bytes_read;
+
+	g_bytes_unref (bytes);
+
+	return bytes_read;
+}
+
+
+static goffset
+block_cache_seek (BlockCache *cache,
+		  goffset     offset,
+		  GSeekType   type)
+{
+	switch (type) {
+	case G_SEEK_SET:
+		break;
+	case G_SEEK_CUR:
+		offset += cache->position;
+		break;
+	case G_SEEK_END:
+		offset += cache->size;
+		break;
+	}
+
+	if (offset < 0)
+		return -1;
+
+	cache->position = offset;
+
+	return cache->position;
+}
+
+
 /* LoadData */
 
 
@@ -193,9 +708,13 @@ fr_archive_libarchive_get_packages (FrArchive  *archive,
 
 typedef struct {
 	FrArchive          *archive;
+	GFile              *file;         /* the file to read if not the archive file */
 	GCancellable       *cancellable;
 	GSimpleAsyncResult *result;
 	GInputStream       *istream;
+	BlockCache         *block_cache;
+	VolumeSet          *volume_set;
+	gboolean            random_access;
 	void               *buffer;
 	gssize              buffer_size;
 	GError             *error;
@@ -214,14 +733,24 @@ static void
 load_data_free (LoadData *load_data)
 {
 	_g_object_unref (load_data->archive);
+	_g_object_unref (load_data->file);
 	_g_object_unref (load_data->cancellable);
 	_g_object_unref (load_data->result);
 	_g_object_unref (load_data->istream);
+	block_cache_free (load_data->block_cache);
+	volume_set_free (load_data->volume_set);
 	g_free (load_data->buffer);
 	g_free (load_data);
 }
 
 
+static GFile *
+load_data_get_file (LoadData *load_data)
+{
+	return (load_data->file != NULL) ? load_data->file : fr_archive_get_file (load_data->archive);
+}
+
+
 static int
 load_data_open (struct archive *a,
 		void           *client_data)
@@ -236,10 +765,23 @@ load_data_open (struct archive *a,
 		FR_ARCHIVE_LIBARCHIVE (load_data->archive)->priv->uncompressed_size = 0;
 	}
 
-	load_data->istream = (GInputStream *) g_file_read (fr_archive_get_file (load_data->archive),
+	if (load_data->volume_set != NULL) {
+		volume_set_seek (load_data->volume_set, 0, G_SEEK_SET);
+		return ARCHIVE_OK;
+	}
+
+	load_data->istream = (GInputStream *) g_file_read (load_data_get_file (load_data),
 							   load_data->cancellable,
 							   &load_data->error);
-	return (load_data->error == NULL) ? ARCHIVE_OK : ARCHIVE_FATAL;
+	if (load_data->error != NULL)
+		return ARCHIVE_FATAL;
+
+	if (! g_file_is_native (load_data_get_file (load_data)))
+		load_data->block_cache = block_cache_new (load_data_get_file (load_data),
+							  load_data->istream,
+							  load_data->cancellable);
+
+	return ARCHIVE_OK;
 }
 
 
@@ -255,16 +797,36 @@ load_data_read (struct archive  *a,
 		return -1;
 
 	*buff = load_data->buffer;
-	bytes = g_input_stream_read (load_data->istream,
-				     load_data->buffer,
-				     load_data->buffer_size,
-				     load_data->cancellable,
-				     &load_data->error);
+	if (load_data->volume_set != NULL)
+		bytes = volume_set_read (load_data->volume_set,
+					 load_data->buffer,
+					 load_data->buffer_size,
+					 load_data->cancellable,
+					 &load_data->error);
+	else if (load_data->block_cache != NULL)
+		bytes = block_cache_read (load_data->block_cache,
+					  load_data->buffer,
+					  load_data->buffer_size,
+					  load_data->cancellable,
+					  &load_data->error);
+	else
+		bytes = g_input_stream_read (load_data->istream,
+					     load_data->buffer,
+					     load_data->buffer_size,
+					     load_data->cancellable,
+					     &load_data->error);
 
 	/* update the progress only if listing the content */
 	if (g_simple_async_result_get_source_tag (load_data->result) == fr_archive_list) {
-		fr_archive_progress_set_completed_bytes (load_data->archive,
-							 g_seekable_tell (G_SEEKABLE (load_data->istream)));
+		goffset position;
+
+		if (load_data->volume_set != NULL)
+			position = volume_set_tell (load_data->volume_set);
+		else if (load_data->block_cache != NULL)
+			position = load_data->block_cache->position;
+		else
+			position = g_seekable_tell (G_SEEKABLE (load_data->istream));
+		fr_archive_progress_set_completed_bytes (load_data->archive, position);
 		FR_ARCHIVE_LIBARCHIVE (load_data->archive)->priv->compressed_size += bytes;
 	}
 
@@ -281,6 +843,11 @@ load_data_close (struct archive *a,
 	if (load_data->error != NULL)
 		return ARCHIVE_FATAL;
 
+	if (load_data->block_cache != NULL) {
+		block_cache_free (load_data->block_cache);
+		load_data->block_cache = NULL;
+	}
+
 	if (load_data->istream != NULL) {
 		_g_object_unref (load_data->istream);
 		load_data->istream = NULL;
@@ -290,6 +857,79 @@ load_data_close (struct archive *a,
 }
 
 
+#if ARCHIVE_VERSION_NUMBER >= 3001000
+
+
+static gint64
+load_data_seek (struct archive *a,
+		void           *client_data,
+		gint64          request,
+		int             whence)
+{
+	LoadData  *load_data = client_data;
+	GSeekType  seek_type;
+
+	if (load_data->error != NULL)
+		return ARCHIVE_FATAL;
+
+	switch (whence) {
+	case SEEK_CUR:
+		seek_type = G_SEEK_CUR;
+		break;
+	case SEEK_END:
+		seek_type = G_SEEK_END;
+		break;
+	default:
+		seek_type = G_SEEK_SET;
+		break;
+	}
+
+	if (load_data->volume_set != NULL)
+		return volume_set_seek (load_data->volume_set, request, seek_type);
+
+	if (load_data->block_cache != NULL)
+		return block_cache_seek (load_data->block_cache, request, seek_type);
+
+	if (! g_seekable_seek (G_SEEKABLE (load_data->istream), request, seek_type, load_data->cancellable, &load_data->error))
+		return ARCHIVE_FATAL;
+
+	return g_seekable_tell (G_SEEKABLE (load_data->istream));
+}
+
+
+#endif
+
+
+/* Remote archives can be read at random positions, this way libarchive
+ * reads only the central directory and the requested entries of the
+ * formats that support it.  The volumes of a local multi-volume archive
+ * are read as a single stream.  Set random_access to read a local archive
+ * at random positions as well. */
+static int
+load_data_archive_read_open (struct archive *a,
+			     LoadData       *load_data)
+{
+	if ((load_data->volume_set == NULL) && g_file_is_native (load_data_get_file (load_data)))
+		load_data->volume_set = volume_set_new (load_data_get_file (load_data), load_data->cancellable);
+
+#if ARCHIVE_VERSION_NUMBER >= 3001000
+	if (! g_file_is_native (load_data_get_file (load_data))
+	    || (load_data->volume_set != NULL)
+	    || load_data->random_access)
+	{
+		archive_read_set_open_callback (a, load_data_open);
+		archive_read_set_read_callback (a, load_data_read);
+		archive_read_set_seek_callback (a, load_data_seek);
+		archive_read_set_close_callback (a, load_data_close);
+		archive_read_set_callback_data (a, load_data);
+		return archive_read_open1 (a);
+	}
+#endif
+
+	return archive_read_open (a, load_data, load_data_open, load_data_read, load_data_close);
+}
+
+
 /* -- list -- */
 
 
@@ -344,13 +984,15 @@ list_archive_thread (GSimpleAsyncResult *result,
 
 	load_data = g_simple_async_result_get_op_res_gpointer (result);
 
-	fr_archive_progress_set_total_bytes (load_data->archive,
-					     _g_file_get_size (fr_archive_get_file (load_data->archive), cancellable));
-
 	a = archive_read_new ();
 	archive_read_support_filter_all (a);
 	archive_read_support_format_all (a);
-	archive_read_open (a, load_data, load_data_open, load_data_read, load_data_close);
+	load_data_archive_read_open (a, load_data);
+
+	load_data->archive->multi_volume = (load_data->volume_set != NULL);
+	fr_archive_progress_set_total_bytes (load_data->archive,
+					     (load_data->volume_set != NULL) ? volume_set_get_size (load_data->volume_set) : _g_file_get_size (fr_archive_get_file (load_data->archive), cancellable));
+
 	while ((r = archive_read_next_header (a, &entry)) == ARCHIVE_OK) {
 		FileData   *file_data;
 		const char *pathname;
@@ -460,6 +1102,8 @@ typedef struct {
 	GHashTable *usernames;
 	GHashTable *groupnames;
 	char       *null_buffer;
+	FrManifest *manifest;
+	GChecksum  *checksum;          /* digest of the file being extracted */
 } ExtractData;
 
 
@@ -473,6 +1117,8 @@ extract_data_free (ExtractData *extract_data)
 	g_hash_table_unref (extract_data->usernames);
 	g_hash_table_unref (extract_data->groupnames);
 	g_free (extract_data->null_buffer);
+	if (extract_data->checksum != NULL)
+		g_checksum_free (extract_data->checksum);
 	load_data_free (LOAD_DATA (extract_data));
 }
 
@@ -594,6 +1240,9 @@ _g_output_stream_add_padding (ExtractData    *extract_data,
 		if (! success)
 			break;
 
+		if (extract_data->checksum != NULL)
+			g_checksum_update (extract_data->checksum, (guchar *) extract_data->null_buffer, bytes_written);
+
 		actual_offset += bytes_written;
 	}
 
@@ -626,7 +1275,7 @@ extract_archive_thread (GSimpleAsyncResult *result,
 	a = archive_read_new ();
 	archive_read_support_filter_all (a);
 	archive_read_support_format_all (a);
-	archive_read_open (a, load_data, load_data_open, load_data_read, load_data_close);
+	load_data_archive_read_open (a, load_data);
 	while ((r = archive_read_next_header (a, &entry)) == ARCHIVE_OK) {
 		const char    *pathname;
 		char          *fullpath;
@@ -825,6 +1474,9 @@ extract_archive_thread (GSimpleAsyncResult *result,
 				if (ostream == NULL)
 					break;
 
+				if (extract_data->manifest != NULL)
+					extract_data->checksum = g_checksum_new (FR_MANIFEST_CHECKSUM);
+
 				actual_offset = 0;
 				while ((r = archive_read_data_block (a, &buffer, &buffer_size, &target_offset)) == ARCHIVE_OK) {
 					gsize bytes_written;
@@ -839,6 +1491,9 @@ extract_archive_thread (GSimpleAsyncResult *result,
 					if (! g_output_stream_write_all (ostream, buffer, buffer_size, &bytes_written, cancellable, &load_data->error))
 						break;
 
+					if (extract_data->checksum != NULL)
+						g_checksum_update (extract_data->checksum, buffer, bytes_written);
+
 					actual_offset += bytes_written;
 					fr_archive_progress_inc_completed_bytes (load_data->archive, bytes_written);
 				}
@@ -852,6 +1507,17 @@ extract_archive_thread (GSimpleAsyncResult *result,
 					load_data->error = _g_error_new_from_archive_error (archive_error_string (a));
 				else
 					g_hash_table_insert (created_files, g_object_ref (file), _g_file_info_create_from_entry (entry, extract_data));
+
+				if (extract_data->checksum != NULL) {
+					if (load_data->error == NULL)
+						fr_manifest_add_file (extract_data->manifest,
+								      file,
+								      MAX (target_offset, actual_offset),
+								      archive_entry_mtime (entry),
+								      g_checksum_get_string (extract_data->checksum));
+					g_checksum_free (extract_data->checksum);
+					extract_data->checksum = NULL;
+				}
 				break;
 
 			case AE_IFLNK:
@@ -938,6 +1604,7 @@ fr_archive_libarchive_extract_files (FrArchive           *archive,
 	extract_data->n_files_to_extract = 0;
 	extract_data->usernames = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	extract_data->groupnames = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	extract_data->manifest = fr_archive_get_manifest (archive);
 
 	for (scan = extract_data->file_list; scan; scan = scan->next) {
 		g_hash_table_insert (extract_data->files_to_extract, scan->data, GINT_TO_POINTER (1));
@@ -952,12 +1619,306 @@ fr_archive_libarchive_extract_files (FrArchive           *archive,
 }
 
 
+/* -- test_integrity -- */
+
+
+#define MAX_TEST_WORKERS 8
+
+
+typedef struct {
+	LoadData  parent;
+	char     *password;
+	int       n_workers;
+} TestData;
+
+
+typedef struct {
+	int   n_entry;                 /* G_MAXINT if the error is not about an entry */
+	char *path;
+	char *message;
+} TestFailure;
+
+
+typedef struct {
+	TestData *test_data;
+	LoadData *load_data;
+	int       n_worker;
+	GList    *failures;            /* TestFailure list, in reverse order */
+} TestWorker;
+
+
+static void
+test_data_free (TestData *test_data)
+{
+	g_free (test_data->password);
+	load_data_free (LOAD_DATA (test_data));
+}
+
+
+static void
+test_failure_free (TestFailure *failure)
+{
+	g_free (failure->path);
+	g_free (failure->message);
+	g_free (failure);
+}
+
+
+static int
+test_failure_compare (gconstpointer a,
+		      gconstpointer b)
+{
+	const TestFailure *failure_a = a;
+	const TestFailure *failure_b = b;
+
+	if (failure_a->n_entry < failure_b->n_entry)
+		return -1;
+	if (failure_a->n_entry > failure_b->n_entry)
+		return 1;
+	return 0;
+}
+
+
+static void
+test_worker_add_failure (TestWorker *worker,
+			 int         n_entry,
+			 const char *path,
+			 const char *message)
+{
+	TestFailure *failure;
+
+	failure = g_new0 (TestFailure, 1);
+	failure->n_entry = n_entry;
+	failure->path = g_strdup (path);
+	failure->message = (message != NULL) ? g_locale_to_utf8 (message, -1, NULL, NULL, NULL) : NULL;
+	if (failure->message == NULL)
+		failure->message = g_strdup ("Fatal error");
+	worker->failures = g_list_prepend (worker->failures, failure);
+}
+
+
+/* Each worker reads the archive with its own reader and checks only the
+ * entries assigned to it, reading the data is enough to verify the
+ * checksums. */
+static gpointer
+test_worker_thread (gpointer user_data)
+{
+	TestWorker           *worker = user_data;
+	TestData             *test_data = worker->test_data;
+	LoadData             *load_data = worker->load_data;
+	struct archive       *a;
+	struct archive_entry *entry;
+	int                   n_entry;
+	gboolean              entry_failed;
+	int                   r;
+
+	a = archive_read_new ();
+	archive_read_support_filter_all (a);
+	archive_read_support_format_all (a);
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+	if (test_data->password != NULL)
+		archive_read_add_passphrase (a, test_data->password);
+#endif
+	load_data_archive_read_open (a, load_data);
+
+	n_entry = 0;
+	entry_failed = FALSE;
+	while ((r = archive_read_next_header (a, &entry)) == ARCHIVE_OK) {
+		const void   *buffer;
+		size_t        buffer_size;
+		__LA_INT64_T  offset;
+
+		if (g_cancellable_is_cancelled (load_data->cancellable))
+			break;
+
+		if ((n_entry % test_data->n_workers != worker->n_worker)
+		    || (archive_entry_filetype (entry) != AE_IFREG))
+		{
+			archive_read_data_skip (a);
+			n_entry++;
+			continue;
+		}
+
+		while ((r = archive_read_data_block (a, &buffer, &buffer_size, &offset)) == ARCHIVE_OK)
+			fr_archive_progress_inc_completed_bytes (load_data->archive, buffer_size);
+
+		if (r != ARCHIVE_EOF) {
+			test_worker_add_failure (worker,
+						 n_entry,
+						 archive_entry_pathname (entry),
+						 (load_data->error != NULL) ? load_data->error->message : archive_error_string (a));
+			if (r == ARCHIVE_FATAL) {
+				entry_failed = TRUE;
+				break;
+			}
+		}
+
+		n_entry++;
+	}
+
+	/* the errors not about a single entry are reported by the first
+	 * worker only. */
+
+	if ((r != ARCHIVE_EOF)
+	    && ! entry_failed
+	    && (worker->n_worker == 0)
+	    && ! g_cancellable_is_cancelled (load_data->cancellable))
+	{
+		test_worker_add_failure (worker,
+					 G_MAXINT,
+					 NULL,
+					 (load_data->error != NULL) ? load_data->error->message : archive_error_string (a));
+	}
+
+	archive_read_free (a);
+
+	return NULL;
+}
+
+
+static void
+test_archive_thread (GSimpleAsyncResult *result,
+		     GObject            *object,
+		     GCancellable       *cancellable)
+{
+	TestData   *test_data;
+	LoadData   *load_data;
+	TestWorker *workers;
+	GThread   **threads;
+	GList      *failures;
+	GList      *scan;
+	int         n_failures;
+	int         i;
+
+	test_data = g_simple_async_result_get_op_res_gpointer (result);
+	load_data = LOAD_DATA (test_data);
+
+	workers = g_new0 (TestWorker, test_data->n_workers);
+	threads = g_new0 (GThread *, test_data->n_workers);
+	for (i = 0; i < test_data->n_workers; i++) {
+		LoadData *worker_data;
+
+		worker_data = g_new0 (LoadData, 1);
+		load_data_init (worker_data);
+		worker_data->archive = g_object_ref (load_data->archive);
+		worker_data->cancellable = _g_object_ref (load_data->cancellable);
+		worker_data->result = g_object_ref (load_data->result);
+		worker_data->random_access = (test_data->n_workers > 1);
+
+		workers[i].test_data = test_data;
+		workers[i].load_data = worker_data;
+		workers[i].n_worker = i;
+	}
+
+	/* the first worker runs in this thread */
+
+	for (i = 1; i < test_data->n_workers; i++)
+		threads[i] = g_thread_new ("test-worker", test_worker_thread, workers + i);
+	test_worker_thread (workers);
+	for (i = 1; i < test_data->n_workers; i++)
+		g_thread_join (threads[i]);
+
+	failures = NULL;
+	for (i = 0; i < test_data->n_workers; i++) {
+		failures = g_list_concat (failures, workers[i].failures);
+		g_clear_error (&workers[i].load_data->error);
+		load_data_free (workers[i].load_data);
+	}
+	failures = g_list_sort (failures, test_failure_compare);
+
+	n_failures = 0;
+	for (scan = failures; scan; scan = scan->next) {
+		TestFailure *failure = scan->data;
+
+		fr_archive_add_test_failure (load_data->archive, failure->path, failure->message);
+		n_failures++;
+	}
+
+	if (n_failures == 1) {
+		TestFailure *failure = failures->data;
+
+		if (failure->path != NULL)
+			load_data->error = g_error_new (FR_ERROR, FR_ERROR_COMMAND_ERROR, "%s: %s", failure->path, failure->message);
+		else
+			load_data->error = g_error_new_literal (FR_ERROR, FR_ERROR_COMMAND_ERROR, failure->message);
+	}
+	else if (n_failures > 1)
+		load_data->error = g_error_new (FR_ERROR,
+						FR_ERROR_COMMAND_ERROR,
+						ngettext ("%d error found", "%d errors found", n_failures),
+						n_failures);
+
+	if (load_data->error == NULL)
+		g_cancellable_set_error_if_cancelled (cancellable, &load_data->error);
+	if (load_data->error != NULL)
+		g_simple_async_result_set_from_error (result, load_data->error);
+
+	g_list_free_full (failures, (GDestroyNotify) test_failure_free);
+	g_free (threads);
+	g_free (workers);
+	test_data_free (test_data);
+}
+
+
+static void
+fr_archive_libarchive_test_integrity (FrArchive           *archive,
+				      const char          *password,
+				      GCancellable        *cancellable,
+				      GAsyncReadyCallback  callback,
+				      gpointer             user_data)
+{
+	TestData *test_data;
+	LoadData *load_data;
+	goffset   total_size;
+	int       i;
+
+	test_data = g_new0 (TestData, 1);
+	load_data_init (LOAD_DATA (test_data));
+
+	load_data = LOAD_DATA (test_data);
+	load_data->archive = g_object_ref (archive);
+	load_data->cancellable = _g_object_ref (cancellable);
+	load_data->result = g_simple_async_result_new (G_OBJECT (archive),
+						       callback,
+						       user_data,
+						       fr_archive_test);
+
+	test_data->password = g_strdup (password);
+
+	/* the entries of a zip file can be read independently from each
+	 * other, check them in parallel. */
+
+	test_data->n_workers = 1;
+	if ((_g_str_equal (archive->mime_type, "application/zip") || _g_str_equal (archive->mime_type, "application/x-cbz"))
+	    && g_file_is_native (fr_archive_get_file (archive))
+	    && ! archive->multi_volume)
+	{
+		test_data->n_workers = CLAMP (g_get_num_processors (), 1, MAX_TEST_WORKERS);
+		test_data->n_workers = MIN (test_data->n_workers, MAX (archive->files->len, 1));
+	}
+
+	total_size = 0;
+	for (i = 0; i < archive->files->len; i++) {
+		FileData *file_data = g_ptr_array_index (archive->files, i);
+		total_size += file_data->size;
+	}
+	fr_archive_progress_set_total_bytes (archive, total_size);
+
+	g_simple_async_result_set_op_res_gpointer (load_data->result, test_data, NULL);
+	g_simple_async_result_run_in_thread (load_data->result,
+					     test_archive_thread,
+					     G_PRIORITY_DEFAULT,
+					     cancellable);
+}
+
+
 /* --  AddFile -- */
 
 
 typedef struct {
-	GFile *file;
-	char  *pathname;
+	GFile     *file;
+	char      *pathname;
+	GFileInfo *info;
 } AddFile;
 
 
@@ -967,86 +1928,342 @@ add_file_new (GFile      *file,
 {
 	AddFile *add_file;
 
-	add_file = g_new (AddFile, 1);
-	add_file->file = g_object_ref (file);
-	add_file->pathname = g_strdup (archive_pathname);
+	add_file = g_new (AddFile, 1);
+	add_file->file = g_object_ref (file);
+	add_file->pathname = g_strdup (archive_pathname);
+	add_file->info = _g_object_ref (_g_file_get_cached_info (file));
+
+	return add_file;
+}
+
+
+static void
+add_file_free (AddFile *add_file)
+{
+	g_object_unref (add_file->file);
+	g_free (add_file->pathname);
+	_g_object_unref (add_file->info);
+	g_free (add_file);
+}
+
+
+/* -- _fr_archive_libarchive_save -- */
+
+
+#define SAVE_DATA(x) ((SaveData *)(x))
+
+
+typedef enum {
+	WRITE_ACTION_ABORT,
+	WRITE_ACTION_SKIP_ENTRY,
+	WRITE_ACTION_WRITE_ENTRY
+} WriteAction;
+
+
+typedef struct      _SaveData SaveData;
+typedef void        (*SaveDataFunc)    (SaveData *, gpointer user_data);
+typedef WriteAction (*EntryActionFunc) (SaveData *, struct archive_entry *, gpointer user_data);
+
+
+struct _SaveData {
+	LoadData         parent;
+	GFile           *tmp_file;
+	GOutputStream   *ostream;
+	GHashTable      *usernames;
+	GHashTable      *groupnames;
+	gboolean         update;
+	char            *source_password;
+	char            *password;
+	gboolean         encrypt_header;
+	FrCompression    compression;
+	guint            volume_size;
+	int              n_volume;          /* the volume being written */
+	goffset          volume_written;    /* bytes written in the current volume */
+	GThreadPool     *flush_pool;        /* closes the complete volumes */
+	GPtrArray       *volume_tmp_files;  /* temporary file of each volume */
+	GMutex           flush_mutex;
+	GError          *flush_error;
+	void            *buffer;
+	gsize            buffer_size;
+	SaveDataFunc     begin_operation;
+	SaveDataFunc     end_operation;
+	EntryActionFunc  entry_action;
+	gpointer         user_data;
+	GDestroyNotify   user_data_notify;
+	struct archive  *b;
+};
+
+
+static void
+save_data_init (SaveData *save_data)
+{
+	load_data_init (LOAD_DATA (save_data));
+	save_data->buffer_size = BUFFER_SIZE;
+	save_data->buffer = g_new (char, save_data->buffer_size);
+	save_data->usernames = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+	save_data->groupnames = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+	g_mutex_init (&save_data->flush_mutex);
+}
+
+
+static void
+save_data_free (SaveData *save_data)
+{
+	if (save_data->user_data_notify != NULL)
+		save_data->user_data_notify (save_data->user_data);
+	if (save_data->flush_pool != NULL)
+		g_thread_pool_free (save_data->flush_pool, FALSE, TRUE);
+	if (save_data->volume_tmp_files != NULL)
+		g_ptr_array_unref (save_data->volume_tmp_files);
+	_g_error_free (save_data->flush_error);
+	g_mutex_clear (&save_data->flush_mutex);
+	g_free (save_data->buffer);
+	g_free (save_data->source_password);
+	g_free (save_data->password);
+	g_hash_table_unref (save_data->groupnames);
+	g_hash_table_unref (save_data->usernames);
+	_g_object_unref (save_data->ostream);
+	_g_object_unref (save_data->tmp_file);
+	load_data_free (LOAD_DATA (save_data));
+}
+
+
+/* The new archive is written to a temporary file next to the old one, that
+ * can still be read while saving, and renamed when complete.  For remote
+ * archives the rename is done by the server, so the archive is uploaded
+ * once without a local copy. */
+static gboolean
+save_data_create_tmp_file (SaveData *save_data)
+{
+	LoadData *load_data = LOAD_DATA (save_data);
+	GFile    *parent;
+	char     *basename;
+	char     *tmpname;
+
+	parent = g_file_get_parent (fr_archive_get_file (load_data->archive));
+	basename = g_file_get_basename (fr_archive_get_file (load_data->archive));
+	tmpname = _g_filename_get_random (16, basename);
+	save_data->tmp_file = g_file_get_child (parent, tmpname);
+	save_data->ostream = (GOutputStream *) g_file_create (save_data->tmp_file, G_FILE_CREATE_NONE, load_data->cancellable, &load_data->error);
+
+	g_free (tmpname);
+	g_free (basename);
+	g_object_unref (parent);
+
+	return save_data->ostream != NULL;
+}
+
+
+/* Volumes */
+
+
+/* When a volume size is specified the archive is split in files named
+ * archive.001, archive.002, ... a complete volume is synced to disk and
+ * closed in a separate thread while the next one is being written.  The
+ * volumes are written to temporary files, renamed only when all of them
+ * have been closed, so the old archive is kept if an error occurs.
+ * fr_archive_open detects the type of the volumes from the name without
+ * the volume number and prefers this backend to read them, only the 7z
+ * volumes are read by the 7z command. */
+
+
+static GFile *
+save_data_get_volume_file (SaveData *save_data,
+			   int       n_volume)
+{
+	GFile *file;
+	GFile *parent;
+	char  *basename;
+	char  *name;
+	GFile *volume_file;
+
+	file = fr_archive_get_file (LOAD_DATA (save_data)->archive);
+	parent = g_file_get_parent (file);
+	basename = g_file_get_basename (file);
+	name = g_strdup_printf ("%s.%03d", basename, n_volume);
+	volume_file = g_file_get_child (parent, name);
+
+	g_free (name);
+	g_free (basename);
+	g_object_unref (parent);
+
+	return volume_file;
+}
+
+
+static void
+save_data_flush_volume (gpointer data,
+			gpointer user_data)
+{
+	GOutputStream *ostream = data;
+	SaveData      *save_data = user_data;
+	GError        *error = NULL;
+
+	if (G_IS_FILE_DESCRIPTOR_BASED (ostream)
+	    && (fsync (g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (ostream))) != 0))
+	{
+		int errsv = errno;
+		error = g_error_new_literal (G_IO_ERROR, g_io_error_from_errno (errsv), g_strerror (errsv));
+	}
+
+	if (error == NULL)
+		g_output_stream_close (ostream, NULL, &error);
+	else
+		g_output_stream_close (ostream, NULL, NULL);
+
+	if (error != NULL) {
+		g_mutex_lock (&save_data->flush_mutex);
+		if (save_data->flush_error == NULL)
+			save_data->flush_error = error;
+		else
+			g_error_free (error);
+		g_mutex_unlock (&save_data->flush_mutex);
+	}
+
+	g_object_unref (ostream);
+}
+
+
+static gboolean
+save_data_check_flush_error (SaveData *save_data)
+{
+	LoadData *load_data = LOAD_DATA (save_data);
+
+	g_mutex_lock (&save_data->flush_mutex);
+	if ((load_data->error == NULL) && (save_data->flush_error != NULL))
+		load_data->error = g_error_copy (save_data->flush_error);
+	g_mutex_unlock (&save_data->flush_mutex);
+
+	return load_data->error == NULL;
+}
+
+
+static void
+save_data_flush_current_volume (SaveData *save_data)
+{
+	g_ptr_array_add (save_data->volume_tmp_files, save_data->tmp_file);
+	g_thread_pool_push (save_data->flush_pool, save_data->ostream, NULL);
+
+	save_data->ostream = NULL;
+	save_data->tmp_file = NULL;
+}
+
+
+static gboolean
+save_data_next_volume (SaveData *save_data)
+{
+	save_data_flush_current_volume (save_data);
+	if (! save_data_check_flush_error (save_data))
+		return FALSE;
+
+	save_data->n_volume++;
+	save_data->volume_written = 0;
+
+	return save_data_create_tmp_file (save_data);
+}
+
+
+static ssize_t
+save_data_write_volumes (SaveData   *save_data,
+			 const void *buff,
+			 size_t      n)
+{
+	LoadData *load_data = LOAD_DATA (save_data);
+	gsize     written;
+
+	written = 0;
+	while (written < n) {
+		gsize size;
+		gsize bytes_written;
+
+		if ((save_data->volume_written >= save_data->volume_size) && ! save_data_next_volume (save_data))
+			return -1;
+
+		size = MIN (n - written, save_data->volume_size - save_data->volume_written);
+		if (! g_output_stream_write_all (save_data->ostream,
+						 (const char *) buff + written,
+						 size,
+						 &bytes_written,
+						 load_data->cancellable,
+						 &load_data->error))
+		{
+			return -1;
+		}
+
+		save_data->volume_written += bytes_written;
+		written += bytes_written;
+	}
 
-	return add_file;
+	return written;
 }
 
 
 static void
-add_file_free (AddFile *add_file)
+save_data_close_volumes (SaveData *save_data)
 {
-	g_object_unref (add_file->file);
-	g_free (add_file->pathname);
-	g_free (add_file);
-}
+	LoadData *load_data = LOAD_DATA (save_data);
+	int       i;
 
+	if (save_data->ostream != NULL) {
+		if (load_data->error == NULL) {
+			save_data_flush_current_volume (save_data);
+		}
+		else {
+			g_output_stream_close (save_data->ostream, NULL, NULL);
+			g_file_delete (save_data->tmp_file, NULL, NULL);
+		}
+	}
 
-/* -- _fr_archive_libarchive_save -- */
+	/* wait for the pending volumes */
 
+	g_thread_pool_free (save_data->flush_pool, FALSE, TRUE);
+	save_data->flush_pool = NULL;
+	save_data_check_flush_error (save_data);
 
-#define SAVE_DATA(x) ((SaveData *)(x))
+	/* all the volumes are complete, replace the old ones */
 
+	for (i = 0; (load_data->error == NULL) && (i < save_data->volume_tmp_files->len); i++) {
+		GFile *tmp_file = g_ptr_array_index (save_data->volume_tmp_files, i);
+		GFile *volume_file;
 
-typedef enum {
-	WRITE_ACTION_ABORT,
-	WRITE_ACTION_SKIP_ENTRY,
-	WRITE_ACTION_WRITE_ENTRY
-} WriteAction;
+		volume_file = save_data_get_volume_file (save_data, i + 1);
+		g_file_move (tmp_file,
+			     volume_file,
+			     G_FILE_COPY_OVERWRITE | G_FILE_COPY_TARGET_DEFAULT_PERMS,
+			     NULL,
+			     NULL,
+			     NULL,
+			     &load_data->error);
 
+		g_object_unref (volume_file);
+	}
 
-typedef struct      _SaveData SaveData;
-typedef void        (*SaveDataFunc)    (SaveData *, gpointer user_data);
-typedef WriteAction (*EntryActionFunc) (SaveData *, struct archive_entry *, gpointer user_data);
+	if (load_data->error == NULL) {
+		GFile *volume_file;
 
+		/* remove the volumes left over by a bigger archive */
 
-struct _SaveData {
-	LoadData         parent;
-	GFile           *tmp_file;
-	GOutputStream   *ostream;
-	GHashTable      *usernames;
-	GHashTable      *groupnames;
-	gboolean         update;
-	char            *password;
-	gboolean         encrypt_header;
-	FrCompression    compression;
-	guint            volume_size;
-	void            *buffer;
-	gsize            buffer_size;
-	SaveDataFunc     begin_operation;
-	SaveDataFunc     end_operation;
-	EntryActionFunc  entry_action;
-	gpointer         user_data;
-	GDestroyNotify   user_data_notify;
-	struct archive  *b;
-};
+		for (i = save_data->n_volume + 1; /* void */; i++) {
+			gboolean deleted;
 
+			volume_file = save_data_get_volume_file (save_data, i);
+			deleted = g_file_delete (volume_file, NULL, NULL);
+			g_object_unref (volume_file);
 
-static void
-save_data_init (SaveData *save_data)
-{
-	load_data_init (LOAD_DATA (save_data));
-	save_data->buffer_size = BUFFER_SIZE;
-	save_data->buffer = g_new (char, save_data->buffer_size);
-	save_data->usernames = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
-	save_data->groupnames = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
-}
+			if (! deleted)
+				break;
+		}
 
+		volume_file = save_data_get_volume_file (save_data, 1);
+		fr_archive_set_result_multi_volume (load_data->result, volume_file);
+		g_object_unref (volume_file);
+	}
+	else {
+		/* the files already renamed don't exist anymore */
 
-static void
-save_data_free (SaveData *save_data)
-{
-	if (save_data->user_data_notify != NULL)
-		save_data->user_data_notify (save_data->user_data);
-	g_free (save_data->buffer);
-	g_free (save_data->password);
-	g_hash_table_unref (save_data->groupnames);
-	g_hash_table_unref (save_data->usernames);
-	_g_object_unref (save_data->ostream);
-	_g_object_unref (save_data->tmp_file);
-	load_data_free (LOAD_DATA (save_data));
+		for (i = 0; i < save_data->volume_tmp_files->len; i++)
+			g_file_delete (g_ptr_array_index (save_data->volume_tmp_files, i), NULL, NULL);
+	}
 }
 
 
@@ -1056,24 +2273,18 @@ save_data_open (struct archive *a,
 {
 	SaveData *save_data = client_data;
 	LoadData *load_data = LOAD_DATA (save_data);
-	GFile    *parent;
-	char     *basename;
-	char     *tmpname;
 
 	if (load_data->error != NULL)
 		return ARCHIVE_FATAL;
 
-	parent = g_file_get_parent (fr_archive_get_file (load_data->archive));
-	basename = g_file_get_basename (fr_archive_get_file (load_data->archive));
-	tmpname = _g_filename_get_random (16, basename);
-	save_data->tmp_file = g_file_get_child (parent, tmpname);
-	save_data->ostream = (GOutputStream *) g_file_create (save_data->tmp_file, G_FILE_CREATE_NONE, load_data->cancellable, &load_data->error);
-
-	g_free (tmpname);
-	g_free (basename);
-	g_object_unref (parent);
+	if (save_data->volume_size > 0) {
+		save_data->n_volume = 1;
+		save_data->volume_written = 0;
+		save_data->flush_pool = g_thread_pool_new (save_data_flush_volume, save_data, 1, FALSE, NULL);
+		save_data->volume_tmp_files = g_ptr_array_new_with_free_func (g_object_unref);
+	}
 
-	return (save_data->ostream != NULL) ? ARCHIVE_OK : ARCHIVE_FATAL;
+	return save_data_create_tmp_file (save_data) ? ARCHIVE_OK : ARCHIVE_FATAL;
 }
 
 
@@ -1089,6 +2300,9 @@ save_data_write (struct archive *a,
 	if (load_data->error != NULL)
 		return -1;
 
+	if (save_data->flush_pool != NULL)
+		return save_data_write_volumes (save_data, buff, n);
+
 	return g_output_stream_write (save_data->ostream, buff, n, load_data->cancellable, &load_data->error);
 }
 
@@ -1100,6 +2314,11 @@ save_data_close (struct archive *a,
 	SaveData *save_data = client_data;
 	LoadData *load_data = LOAD_DATA (save_data);
 
+	if (save_data->flush_pool != NULL) {
+		save_data_close_volumes (save_data);
+		return ARCHIVE_OK;
+	}
+
 	if (save_data->ostream != NULL) {
 		GError *error = NULL;
 
@@ -1191,6 +2410,12 @@ _archive_write_set_format_from_context (struct archive *a,
 	else if (_g_str_equal (mime_type, "application/zip")
 	    || _g_str_equal (mime_type, "application/x-cbz")) {
 		archive_write_set_format_zip (a);
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+		if (save_data->password != NULL) {
+			archive_write_set_format_option (a, "zip", "encryption", "aes256");
+			archive_write_set_passphrase (a, save_data->password);
+		}
+#endif
 	}
 
 	/* set the filter */
@@ -1357,15 +2582,24 @@ _archive_write_file (struct archive       *b,
 	struct archive_entry *w_entry;
 	int                   rb;
 
-	/* write the file header */
+	/* write the file header, reusing the info collected while scanning
+	 * the files if available. */
 
-	info = g_file_query_info (add_file->file,
-				  FILE_ATTRIBUTES_NEEDED_BY_ARCHIVE_ENTRY,
-				  (! follow_link ? G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS : 0),
-				  cancellable,
-				  &load_data->error);
-	if (info == NULL)
-		return WRITE_ACTION_ABORT;
+	if ((add_file->info != NULL)
+	    && g_file_info_has_attribute (add_file->info, G_FILE_ATTRIBUTE_STANDARD_TYPE)
+	    && g_file_info_has_attribute (add_file->info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+	{
+		info = g_object_ref (add_file->info);
+	}
+	else {
+		info = g_file_query_info (add_file->file,
+					  FILE_ATTRIBUTES_NEEDED_BY_ARCHIVE_ENTRY,
+					  (! follow_link ? G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS : 0),
+					  cancellable,
+					  &load_data->error);
+		if (info == NULL)
+			return WRITE_ACTION_ABORT;
+	}
 
 	w_entry = archive_entry_new ();
 	if (! _archive_entry_copy_file_info (w_entry, info, save_data)) {
@@ -1392,11 +2626,37 @@ _archive_write_file (struct archive       *b,
 
 		istream = (GInputStream *) g_file_read (add_file->file, cancellable, &load_data->error);
 		if (istream != NULL) {
-			gssize bytes_read;
+			FrManifest *manifest;
+			GChecksum  *checksum;
+			goffset     size;
+			gssize      bytes_read;
+
+			manifest = fr_archive_get_manifest (load_data->archive);
+			checksum = (manifest != NULL) ? g_checksum_new (FR_MANIFEST_CHECKSUM) : NULL;
+			size = 0;
 
 			while ((bytes_read = g_input_stream_read (istream, save_data->buffer, save_data->buffer_size, cancellable, &load_data->error)) > 0) {
 				archive_write_data (b, save_data->buffer, bytes_read);
 				fr_archive_progress_inc_completed_bytes (load_data->archive, bytes_read);
+				if (checksum != NULL)
+					g_checksum_update (checksum, save_data->buffer, bytes_read);
+				size += bytes_read;
+			}
+
+			if (checksum != NULL) {
+				const char *path;
+
+				if (load_data->error == NULL) {
+					path = add_file->pathname;
+					while (*path == '/')
+						path++;
+					fr_manifest_add (manifest,
+							 path,
+							 size,
+							 archive_entry_mtime (w_entry),
+							 g_checksum_get_string (checksum));
+				}
+				g_checksum_free (checksum);
 			}
 
 			g_object_unref (istream);
@@ -1437,7 +2697,13 @@ save_archive_thread (GSimpleAsyncResult *result,
 	a = archive_read_new ();
 	archive_read_support_filter_all (a);
 	archive_read_support_format_all (a);
-	archive_read_open (a, load_data, load_data_open, load_data_read, load_data_close);
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+	if (save_data->source_password != NULL)
+		archive_read_add_passphrase (a, save_data->source_password);
+	else if (save_data->password != NULL)
+		archive_read_add_passphrase (a, save_data->password);
+#endif
+	load_data_archive_read_open (a, load_data);
 
 	if (save_data->begin_operation != NULL)
 		save_data->begin_operation (save_data, save_data->user_data);
@@ -1515,6 +2781,8 @@ save_archive_thread (GSimpleAsyncResult *result,
 
 static void
 _fr_archive_libarchive_save (FrArchive          *archive,
+			     GFile              *source_file,
+			     const char         *source_password,
 			     gboolean            update,
 			     const char         *password,
 			     gboolean            encrypt_header,
@@ -1536,10 +2804,12 @@ _fr_archive_libarchive_save (FrArchive          *archive,
 
 	load_data = LOAD_DATA (save_data);
 	load_data->archive = g_object_ref (archive);
+	load_data->file = _g_object_ref (source_file);
 	load_data->cancellable = _g_object_ref (cancellable);
 	load_data->result = result;
 
 	save_data->update = update;
+	save_data->source_password = g_strdup (source_password);
 	save_data->password = g_strdup (password);
 	save_data->encrypt_header = encrypt_header;
 	save_data->compression = compression;
@@ -1562,9 +2832,12 @@ _fr_archive_libarchive_save (FrArchive          *archive,
 
 
 typedef struct {
-	gboolean    follow_links;
-	GHashTable *files_to_add;
-	int         n_files_to_add;
+	gboolean     follow_links;
+	GHashTable  *files_to_add;
+	int          n_files_to_add;
+	FrFileQueue *queue;
+	GFile       *base_dir;
+	char        *dest_dir;
 } AddData;
 
 
@@ -1585,6 +2858,9 @@ add_data_new (void)
 static void
 add_data_free (AddData *add_data)
 {
+	fr_file_queue_unref (add_data->queue);
+	_g_object_unref (add_data->base_dir);
+	g_free (add_data->dest_dir);
 	g_hash_table_unref (add_data->files_to_add);
 	g_free (add_data);
 }
@@ -1736,6 +3012,8 @@ fr_archive_libarchive_add_files (FrArchive           *archive,
 	}
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     update,
 				     password,
 				     encrypt_header,
@@ -1754,6 +3032,137 @@ fr_archive_libarchive_add_files (FrArchive           *archive,
 }
 
 
+/* -- add_queued_files -- */
+
+
+static void
+_add_queued_files_begin (SaveData *save_data,
+			 gpointer  user_data)
+{
+	LoadData *load_data = LOAD_DATA (save_data);
+
+	/* the total number of files and bytes is updated while the files
+	 * are queued. */
+
+	fr_archive_progress_inc_total_bytes (load_data->archive,
+			FR_ARCHIVE_LIBARCHIVE (load_data->archive)->priv->uncompressed_size);
+}
+
+
+static void
+_add_queued_files_end (SaveData *save_data,
+		       gpointer  user_data)
+{
+	AddData    *add_data = user_data;
+	LoadData   *load_data = LOAD_DATA (save_data);
+	GHashTable *added_pathnames;
+	GFile      *file;
+
+	/* allow to add files to a new archive */
+
+	if (g_error_matches (load_data->error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+		g_clear_error (&load_data->error);
+
+	/* the same file can be queued more than once, for example when both a
+	 * folder and one of its files are added */
+
+	added_pathnames = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	while ((load_data->error == NULL)
+	       && ((file = fr_file_queue_pop (add_data->queue, load_data->cancellable, &load_data->error)) != NULL))
+	{
+		char        *relative_pathname;
+		char        *archive_pathname;
+		AddFile     *add_file;
+		WriteAction  action;
+
+		relative_pathname = g_file_get_relative_path (add_data->base_dir, file);
+		archive_pathname = g_build_filename (add_data->dest_dir, relative_pathname, NULL);
+		if (g_hash_table_contains (added_pathnames, archive_pathname)) {
+			g_free (archive_pathname);
+			g_free (relative_pathname);
+			g_object_unref (file);
+			fr_archive_progress_inc_completed_files (load_data->archive, 1);
+			continue;
+		}
+		g_hash_table_add (added_pathnames, g_strdup (archive_pathname));
+		add_file = add_file_new (file, archive_pathname);
+
+		action = _archive_write_file (save_data->b,
+					      save_data,
+					      add_file,
+					      add_data->follow_links,
+					      NULL,
+					      load_data->cancellable);
+
+		add_file_free (add_file);
+		g_free (archive_pathname);
+		g_free (relative_pathname);
+		g_object_unref (file);
+
+		if (action == WRITE_ACTION_ABORT)
+			break;
+
+		fr_archive_progress_inc_completed_files (load_data->archive, 1);
+	}
+
+	/* stop the folder scan if the files cannot be added */
+
+	if (load_data->error != NULL)
+		fr_file_queue_abort (add_data->queue);
+
+	g_hash_table_unref (added_pathnames);
+}
+
+
+static void
+fr_archive_libarchive_add_queued_files (FrArchive           *archive,
+					FrFileQueue         *queue,
+					GFile               *base_dir,
+					const char          *dest_dir,
+					gboolean             follow_links,
+					const char          *password,
+					gboolean             encrypt_header,
+					FrCompression        compression,
+					guint                volume_size,
+					GCancellable        *cancellable,
+					GAsyncReadyCallback  callback,
+					gpointer             user_data)
+{
+	AddData *add_data;
+
+	g_return_if_fail (base_dir != NULL);
+
+	add_data = add_data_new ();
+	add_data->follow_links = follow_links;
+	add_data->queue = fr_file_queue_ref (queue);
+	add_data->base_dir = g_object_ref (base_dir);
+	if (dest_dir != NULL)
+		add_data->dest_dir = g_strdup (dest_dir[0] == '/' ? dest_dir + 1 : dest_dir);
+	else
+		add_data->dest_dir = g_strdup ("");
+
+	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
+				     FALSE,
+				     password,
+				     encrypt_header,
+				     compression,
+				     volume_size,
+				     cancellable,
+				     g_simple_async_result_new (G_OBJECT (archive),
+				     				callback,
+				     				user_data,
+				     				fr_archive_add_files),
+				     _add_queued_files_begin,
+				     _add_queued_files_end,
+				     NULL,
+				     add_data,
+				     (GDestroyNotify) add_data_free);
+}
+
+
 /* -- remove -- */
 
 
@@ -1837,6 +3246,8 @@ fr_archive_libarchive_remove_files (FrArchive           *archive,
 		remove_data->n_files_to_remove = archive->files->len;
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     FALSE,
 				     archive->password,
 				     archive->encrypt_header,
@@ -1963,6 +3374,8 @@ fr_archive_libarchive_rename (FrArchive           *archive,
 	}
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     FALSE,
 				     archive->password,
 				     archive->encrypt_header,
@@ -2022,6 +3435,8 @@ fr_archive_libarchive_paste_clipboard (FrArchive           *archive,
 	}
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     FALSE,
 				     password,
 				     encrypt_header,
@@ -2079,6 +3494,8 @@ fr_archive_libarchive_add_dropped_files (FrArchive           *archive,
 	}
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     FALSE,
 				     password,
 				     encrypt_header,
@@ -2134,6 +3551,8 @@ fr_archive_libarchive_update_open_files (FrArchive           *archive,
 	}
 
 	_fr_archive_libarchive_save (archive,
+				     NULL,
+				     NULL,
 				     FALSE,
 				     password,
 				     encrypt_header,
@@ -2152,6 +3571,131 @@ fr_archive_libarchive_update_open_files (FrArchive           *archive,
 }
 
 
+/* -- fr_archive_libarchive_convert -- */
+
+
+typedef struct {
+	int     n_files;
+	goffset size;
+} ConvertData;
+
+
+static void
+_convert_begin (SaveData *save_data,
+		gpointer  user_data)
+{
+	ConvertData *convert_data = user_data;
+	LoadData    *load_data = LOAD_DATA (save_data);
+
+	fr_archive_progress_set_total_files (load_data->archive, convert_data->n_files);
+	fr_archive_progress_set_total_bytes (load_data->archive, convert_data->size);
+}
+
+
+static WriteAction
+_convert_entry_action (SaveData             *save_data,
+		       struct archive_entry *w_entry,
+		       gpointer              user_data)
+{
+	fr_archive_progress_inc_completed_files (LOAD_DATA (save_data)->archive, 1);
+	return WRITE_ACTION_WRITE_ENTRY;
+}
+
+
+static gboolean
+_g_mime_type_is_zip (const char *mime_type)
+{
+	return _g_str_equal (mime_type, "application/zip") || _g_str_equal (mime_type, "application/x-cbz");
+}
+
+
+static gboolean
+fr_archive_libarchive_can_convert (FrArchive  *archive,
+				   FrArchive  *source,
+				   const char *source_password,
+				   const char *password)
+{
+	int i;
+
+	if (source->mime_type == NULL)
+		return FALSE;
+
+	/* libarchive can decrypt and encrypt only zip entries. */
+
+	for (i = 0; i < source->files->len; i++) {
+		FileData *file_data = g_ptr_array_index (source->files, i);
+
+		if (! file_data->encrypted)
+			continue;
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+		if ((source_password != NULL) && _g_mime_type_is_zip (source->mime_type))
+			continue;
+#endif
+		return FALSE;
+	}
+
+	if (password != NULL) {
+#if ARCHIVE_VERSION_NUMBER >= 3002000
+		if (! _g_mime_type_is_zip (fr_archive_get_mime_type (archive)))
+			return FALSE;
+#else
+		return FALSE;
+#endif
+	}
+
+	for (i = 0; libarchiver_mime_types[i] != NULL; i++)
+		if (_g_str_equal (source->mime_type, libarchiver_mime_types[i]))
+			return (fr_archive_get_capabilities (archive, source->mime_type, TRUE) & FR_ARCHIVE_CAN_READ) != 0;
+
+	return FALSE;
+}
+
+
+/* Copies the entries of @source to the archive reading and writing them
+ * with libarchive, the data is not stored on disk. */
+static void
+fr_archive_libarchive_convert (FrArchive           *archive,
+			       FrArchive           *source,
+			       const char          *source_password,
+			       const char          *password,
+			       gboolean             encrypt_header,
+			       FrCompression        compression,
+			       guint                volume_size,
+			       GCancellable        *cancellable,
+			       GAsyncReadyCallback  callback,
+			       gpointer             user_data)
+{
+	ConvertData *convert_data;
+	int          i;
+
+	convert_data = g_new0 (ConvertData, 1);
+	convert_data->n_files = source->files->len;
+	for (i = 0; i < source->files->len; i++) {
+		FileData *file_data = g_ptr_array_index (source->files, i);
+		convert_data->size += file_data->size;
+	}
+
+	_fr_archive_libarchive_save (archive,
+				     fr_archive_get_file (source),
+				     source_password,
+				     FALSE,
+				     password,
+				     encrypt_header,
+				     compression,
+				     volume_size,
+				     cancellable,
+				     g_simple_async_result_new (G_OBJECT (archive),
+				     				callback,
+				     				user_data,
+				     				fr_archive_convert),
+				     _convert_begin,
+				     NULL,
+				     _convert_entry_action,
+				     convert_data,
+				     (GDestroyNotify) g_free);
+}
+
+
 static void
 fr_archive_libarchive_class_init (FrArchiveLibarchiveClass *klass)
 {
@@ -2170,12 +3714,16 @@ fr_archive_libarchive_class_init (FrArchiveLibarchiveClass *klass)
 	archive_class->get_packages = fr_archive_libarchive_get_packages;
 	archive_class->list = fr_archive_libarchive_list;
 	archive_class->extract_files = fr_archive_libarchive_extract_files;
+	archive_class->test_integrity = fr_archive_libarchive_test_integrity;
 	archive_class->add_files = fr_archive_libarchive_add_files;
+	archive_class->add_queued_files = fr_archive_libarchive_add_queued_files;
 	archive_class->remove_files = fr_archive_libarchive_remove_files;
 	archive_class->rename = fr_archive_libarchive_rename;
 	archive_class->paste_clipboard = fr_archive_libarchive_paste_clipboard;
 	archive_class->add_dropped_files = fr_archive_libarchive_add_dropped_files;
 	archive_class->update_open_files = fr_archive_libarchive_update_open_files;
+	archive_class->can_convert = fr_archive_libarchive_can_convert;
+	archive_class->convert = fr_archive_libarchive_convert;
 }
 
 
@@ -2196,4 +3744,6 @@ fr_archive_libarchive_init (FrArchiveLibarchive *self)
 	base->propCanExtractAll = TRUE;
 	base->propCanDeleteNonEmptyFolders = TRUE;
 	base->propCanExtractNonEmptyFolders = TRUE;
+	base->propTest = TRUE;
+	base->files_to_add_attributes = FILE_ATTRIBUTES_NEEDED_BY_ARCHIVE_ENTRY;
 }
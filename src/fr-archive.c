@@ -42,10 +42,12 @@
 #include "fr-marshal.h"
 #include "fr-process.h"
 #include "fr-init.h"
+#include "volume-set.h"
 
 
 #define FILE_ARRAY_INITIAL_SIZE	256
 #define PROGRESS_DELAY          50
+#define MULTI_VOLUME_FILE_KEY   "fr-archive-multi-volume-file"
 #define BYTES_FRACTION(self)    ((double) (self)->priv->completed_bytes / (self)->priv->total_bytes)
 #define FILES_FRACTION(self)    ((double) (self)->priv->completed_files + 0.5) / ((self)->priv->total_files + 1)
 
@@ -97,6 +99,8 @@ struct _FrArchivePrivate {
 						    * permissions to write the
 						    * file. */
 	DroppedItemsData *dropped_items_data;
+	GList         *test_failures;              /* FrTestFailure list */
+	FrManifest    *manifest;                   /* not owned */
 };
 
 
@@ -232,6 +236,23 @@ fr_archive_get_property (GObject    *object,
 static void dropped_items_data_free (DroppedItemsData *data);
 
 
+static void
+fr_test_failure_free (FrTestFailure *failure)
+{
+	g_free (failure->path);
+	g_free (failure->message);
+	g_free (failure);
+}
+
+
+static void
+_fr_archive_free_test_failures (FrArchive *archive)
+{
+	g_list_free_full (archive->priv->test_failures, (GDestroyNotify) fr_test_failure_free);
+	archive->priv->test_failures = NULL;
+}
+
+
 static void
 fr_archive_finalize (GObject *object)
 {
@@ -254,6 +275,7 @@ fr_archive_finalize (GObject *object)
 		dropped_items_data_free (archive->priv->dropped_items_data);
 		archive->priv->dropped_items_data = NULL;
 	}
+	_fr_archive_free_test_failures (archive);
 
 	/* Chain up */
 
@@ -323,6 +345,7 @@ fr_archive_class_init (FrArchiveClass *klass)
 	klass->open = NULL;
 	klass->list = NULL;
 	klass->add_files = NULL;
+	klass->add_queued_files = NULL;
 	klass->extract_files = NULL;
 	klass->remove_files = NULL;
 	klass->test_integrity = NULL;
@@ -330,6 +353,8 @@ fr_archive_class_init (FrArchiveClass *klass)
 	klass->paste_clipboard = NULL;
 	klass->add_dropped_files = NULL;
 	klass->update_open_files = NULL;
+	klass->can_convert = NULL;
+	klass->convert = NULL;
 
 	/* properties */
 
@@ -445,6 +470,7 @@ fr_archive_init (FrArchive *self)
         self->multi_volume = FALSE;
         self->volume_size = 0;
 	self->read_only = FALSE;
+	self->files_to_add_attributes = NULL;
 
         self->propAddCanUpdate = FALSE;
         self->propAddCanReplace = FALSE;
@@ -548,6 +574,24 @@ fr_archive_set_stoppable (FrArchive *archive,
 }
 
 
+/* The digest of the files extracted or added from now on is saved in
+ * @manifest, if the archive type supports it.  The manifest must be
+ * valid until it is unset or the archive is destroyed. */
+void
+fr_archive_set_manifest (FrArchive  *archive,
+			 FrManifest *manifest)
+{
+	archive->priv->manifest = manifest;
+}
+
+
+FrManifest *
+fr_archive_get_manifest (FrArchive *archive)
+{
+	return archive->priv->manifest;
+}
+
+
 /* -- fr_archive_new_for_creating -- */
 
 
@@ -593,19 +637,21 @@ fr_archive_create (GFile      *file,
 	 * that can only create a specific file format. */
 
 	requested_capabilities = FR_ARCHIVE_CAN_READ_WRITE;
-	archive_type = get_archive_type_from_mime_type (mime_type, requested_capabilities);
+	archive_type = get_archive_type_for_file (file, mime_type, requested_capabilities);
 
 	/* if no command was found, remove the read capability and try again */
 
 	if (archive_type == 0) {
 		requested_capabilities ^= FR_ARCHIVE_CAN_READ;
-		archive_type = get_archive_type_from_mime_type (mime_type, requested_capabilities);
+		archive_type = get_archive_type_for_file (file, mime_type, requested_capabilities);
 	}
 
 	archive = create_archive_for_mime_type (archive_type,
 						file,
 						mime_type,
 						FR_ARCHIVE_CAN_WRITE);
+	if (archive == NULL)
+		return NULL;
 
 	parent = g_file_get_parent (file);
 	archive->priv->have_write_permissions = _g_file_check_permissions (parent, W_OK);
@@ -674,13 +720,13 @@ create_archive_to_load_archive (GFile      *file,
 	 * that can only read a specific file format. */
 
 	requested_capabilities = FR_ARCHIVE_CAN_READ_WRITE;
-	archive_type = get_archive_type_from_mime_type (mime_type, requested_capabilities);
+	archive_type = get_archive_type_for_file (file, mime_type, requested_capabilities);
 
 	/* if no command was found, remove the write capability and try again */
 
 	if (archive_type == 0) {
 		requested_capabilities ^= FR_ARCHIVE_CAN_WRITE;
-		archive_type = get_archive_type_from_mime_type (mime_type, requested_capabilities);
+		archive_type = get_archive_type_for_file (file, mime_type, requested_capabilities);
 	}
 
 	return create_archive_for_mime_type (archive_type,
@@ -726,9 +772,24 @@ open_archive_buffer_ready_cb (GObject      *source_object,
 	}
 
 	archive = NULL;
+
+	/* the first volume of a split archive is a truncated archive, use the
+	 * type of the whole archive, name.tar.gz for name.tar.gz.001 */
+
+	if (g_file_is_native (open_data->file)) {
+		char *split_name;
+
+		split_name = volume_set_get_split_archive_name (open_data->file);
+		if (split_name != NULL) {
+			mime_type = _g_mime_type_get_from_extension (_g_filename_get_extension (split_name));
+			archive = create_archive_to_load_archive (open_data->file, mime_type);
+			g_free (split_name);
+		}
+	}
+
 	uri = g_file_get_uri (open_data->file);
 	local_mime_type = g_content_type_guess (uri, (guchar *) open_data->buffer, open_data->buffer_size, &result_uncertain);
-	if (! result_uncertain) {
+	if ((archive == NULL) && ! result_uncertain) {
 		const char const *mime_type_from_filename;
 
 		/* for example: "application/x-lrzip" --> "application/x-lrzip-compressed-tar" */
@@ -890,6 +951,21 @@ fr_archive_operation_finish (FrArchive     *archive,
 			FileData *file_data = g_ptr_array_index (archive->files, i);
 			g_hash_table_insert (archive->files_hash, file_data->original_path, file_data);
 		}
+
+		/* multi-volume archives are known to be read-only only after
+		 * reading the content. */
+		if (archive->multi_volume) {
+			archive->priv->capabilities = fr_archive_get_capabilities (archive, archive->mime_type, TRUE);
+			archive->read_only = ! fr_archive_is_capable_of (archive, FR_ARCHIVE_CAN_WRITE) || ! archive->priv->have_write_permissions;
+		}
+	}
+
+	if (success) {
+		GFile *volume_file;
+
+		volume_file = g_object_get_data (G_OBJECT (result), MULTI_VOLUME_FILE_KEY);
+		if (volume_file != NULL)
+			fr_archive_set_multi_volume (archive, volume_file);
 	}
 
 	archive->files_to_add_size = 0;
@@ -922,12 +998,21 @@ typedef struct {
 	FileFilter          *include_files_filter;
 	FileFilter          *exclude_files_filter;
 	FileFilter          *exclude_directories_filter;
+	FrFileQueue         *queue;
+	GCancellable        *scan_cancellable;
+	gulong               scan_cancelled_id;
+	gboolean             cache_info;
 } AddData;
 
 
 static void
 add_data_free (AddData *add_data)
 {
+	if (add_data->scan_cancelled_id != 0)
+		g_cancellable_disconnect (add_data->cancellable, add_data->scan_cancelled_id);
+	_g_object_unref (add_data->scan_cancellable);
+	if (add_data->queue != NULL)
+		fr_file_queue_unref (add_data->queue);
 	file_filter_unref (add_data->include_files_filter);
 	file_filter_unref (add_data->exclude_files_filter);
 	file_filter_unref (add_data->exclude_directories_filter);
@@ -939,6 +1024,26 @@ add_data_free (AddData *add_data)
 }
 
 
+static gboolean
+_fr_archive_can_add_file (FrArchive *archive,
+			  GFileInfo *info)
+{
+	switch (g_file_info_get_file_type (info)) {
+	case G_FILE_TYPE_REGULAR:
+	case G_FILE_TYPE_DIRECTORY:
+	case G_FILE_TYPE_SYMBOLIC_LINK:
+		break;
+	default: /* ignore any other type */
+		return FALSE;
+	}
+
+	if (! archive->propAddCanStoreFolders && (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY))
+		return FALSE;
+
+	return TRUE;
+}
+
+
 static void
 fr_archive_add_files_ready_cb (GList    *file_info_list, /* FileInfo list */
 		      	       GError   *error,
@@ -967,18 +1072,11 @@ fr_archive_add_files_ready_cb (GList    *file_info_list, /* FileInfo list */
 		for (scan = file_info_list; scan; scan = scan->next) {
 			FileInfo *data = scan->data;
 
-			switch (g_file_info_get_file_type (data->info)) {
-			case G_FILE_TYPE_REGULAR:
-			case G_FILE_TYPE_DIRECTORY:
-			case G_FILE_TYPE_SYMBOLIC_LINK:
-				break;
-			default: /* ignore any other type */
-				continue;
-			}
-
-			if (! archive->propAddCanStoreFolders && (g_file_info_get_file_type (data->info) == G_FILE_TYPE_DIRECTORY))
+			if (! _fr_archive_can_add_file (archive, data->info))
 				continue;
 
+			if (add_data->cache_info)
+				_g_file_set_cached_info (data->file, data->info);
 			file_list = g_list_prepend (file_list, g_object_ref (data->file));
 			archive->files_to_add_size += g_file_info_get_size (data->info);
 		}
@@ -1011,6 +1109,171 @@ fr_archive_add_files_ready_cb (GList    *file_info_list, /* FileInfo list */
 }
 
 
+/* When the archive is empty there is no entry to replace, so the files can
+ * be added while the folders are still being scanned. */
+static gboolean
+_fr_archive_can_add_queued_files (AddData *add_data)
+{
+	return (FR_ARCHIVE_GET_CLASS (add_data->archive)->add_queued_files != NULL)
+		&& (add_data->base_dir != NULL)
+		&& (add_data->archive->files->len == 0);
+}
+
+
+static void
+add_queued_files_for_each_file_cb (GFile     *file,
+				   GFileInfo *info,
+				   gpointer   user_data)
+{
+	AddData   *add_data = user_data;
+	FrArchive *archive = add_data->archive;
+
+	/* stop scanning if adding the files failed */
+
+	if ((add_data->queue != NULL) && fr_file_queue_is_aborted (add_data->queue)) {
+		g_cancellable_cancel (add_data->scan_cancellable);
+		return;
+	}
+
+	if (! _fr_archive_can_add_file (archive, info))
+		return;
+
+	if (add_data->queue == NULL) {
+
+		/* start adding as soon as the first file is available. */
+
+		add_data->queue = fr_file_queue_new ();
+
+		archive->files_to_add_size = 0;
+		fr_archive_progress_set_total_files (archive, 0);
+		fr_archive_progress_set_total_bytes (archive, 0);
+		fr_archive_action_started (archive, FR_ACTION_ADDING_FILES);
+		_fr_archive_activate_progress_update (archive);
+
+		FR_ARCHIVE_GET_CLASS (archive)->add_queued_files (archive,
+								  add_data->queue,
+								  add_data->base_dir,
+								  add_data->dest_dir,
+								  add_data->follow_links,
+								  add_data->password,
+								  add_data->encrypt_header,
+								  add_data->compression,
+								  add_data->volume_size,
+								  add_data->cancellable,
+								  add_data->callback,
+								  add_data->user_data);
+	}
+
+	fr_archive_progress_inc_total_files (archive, 1);
+	fr_archive_progress_inc_total_bytes (archive, g_file_info_get_size (info));
+	if (add_data->cache_info)
+		_g_file_set_cached_info (file, info);
+	fr_file_queue_push (add_data->queue, file);
+}
+
+
+static void
+add_queued_files_done_cb (GError   *error,
+			  gpointer  user_data)
+{
+	AddData *add_data = user_data;
+
+	if (add_data->queue != NULL) {
+		fr_file_queue_close (add_data->queue, error);
+	}
+	else {
+		GSimpleAsyncResult *result;
+
+		/* no file to add */
+
+		result = g_simple_async_result_new (G_OBJECT (add_data->archive),
+						    add_data->callback,
+						    add_data->user_data,
+						    fr_archive_add_files);
+		if (error != NULL)
+			g_simple_async_result_set_from_error (result, error);
+		g_simple_async_result_complete_in_idle (result);
+
+		g_object_unref (result);
+	}
+
+	add_data_free (add_data);
+}
+
+
+static void
+scan_cancelled_cb (GCancellable *cancellable,
+		   gpointer      user_data)
+{
+	g_cancellable_cancel (G_CANCELLABLE (user_data));
+}
+
+
+static void
+_fr_archive_add_files_scan (AddData             *add_data,
+			    GList               *file_list,
+			    FileListFlags        flags,
+			    FilterMatchCallback  directory_filter_func,
+			    FilterMatchCallback  file_filter_func)
+{
+	FrArchive *archive = add_data->archive;
+	char      *attributes;
+
+	/* collect the attributes needed to add the files as well, unless the
+	 * scan follows the symbolic links differently. */
+
+	add_data->cache_info = (archive->files_to_add_attributes != NULL)
+			       && (((flags & FILE_LIST_NO_FOLLOW_LINKS) == 0) == (add_data->follow_links != FALSE));
+
+	attributes = g_strconcat (G_FILE_ATTRIBUTE_STANDARD_NAME ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+				  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+				  G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP,
+				  NULL);
+	if (add_data->cache_info) {
+		char *tmp = attributes;
+		attributes = g_strconcat (tmp, ",", archive->files_to_add_attributes, NULL);
+		g_free (tmp);
+	}
+
+	fr_archive_action_started (add_data->archive, FR_ACTION_GETTING_FILE_LIST);
+
+	if (_fr_archive_can_add_queued_files (add_data)) {
+
+		/* the scan has its own cancellable to stop it when adding
+		 * the files fails. */
+
+		add_data->scan_cancellable = g_cancellable_new ();
+		if (add_data->cancellable != NULL)
+			add_data->scan_cancelled_id = g_cancellable_connect (add_data->cancellable,
+									     G_CALLBACK (scan_cancelled_cb),
+									     add_data->scan_cancellable,
+									     NULL);
+
+		_g_file_list_foreach_async (file_list,
+					    flags,
+					    attributes,
+					    add_data->scan_cancellable,
+					    directory_filter_func,
+					    file_filter_func,
+					    add_queued_files_for_each_file_cb,
+					    add_queued_files_done_cb,
+					    add_data);
+	}
+	else
+		_g_file_list_query_info_async (file_list,
+					       flags,
+					       attributes,
+					       add_data->cancellable,
+					       directory_filter_func,
+					       file_filter_func,
+					       fr_archive_add_files_ready_cb,
+					       add_data);
+
+	g_free (attributes);
+}
+
+
 void
 fr_archive_add_files (FrArchive           *archive,
 		      GList               *file_list,
@@ -1045,19 +1308,11 @@ fr_archive_add_files (FrArchive           *archive,
 	add_data->callback = callback;
 	add_data->user_data = user_data;
 
-	fr_archive_action_started (archive, FR_ACTION_GETTING_FILE_LIST);
-
-	_g_file_list_query_info_async (file_list,
-				       FILE_LIST_RECURSIVE | FILE_LIST_NO_BACKUP_FILES,
-				       (G_FILE_ATTRIBUTE_STANDARD_NAME ","
-					G_FILE_ATTRIBUTE_STANDARD_SIZE ","
-					G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
-					G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP),
-				       cancellable,
-				       NULL,
-				       NULL,
-				       fr_archive_add_files_ready_cb,
-				       add_data);
+	_fr_archive_add_files_scan (add_data,
+				    file_list,
+				    FILE_LIST_RECURSIVE | FILE_LIST_NO_BACKUP_FILES,
+				    NULL,
+				    NULL);
 }
 
 
@@ -1072,7 +1327,7 @@ directory_filter_cb (GFile     *file,
 	AddData *add_data = user_data;
 
 	return ! file_filter_empty (add_data->exclude_directories_filter)
-			&& file_filter_matches (add_data->exclude_directories_filter, file);
+			&& file_filter_matches_info (add_data->exclude_directories_filter, file, info);
 }
 
 
@@ -1083,11 +1338,11 @@ file_filter_cb (GFile     *file,
 {
 	AddData *add_data = user_data;
 
-	if (file_filter_matches (add_data->include_files_filter, file))
+	if (file_filter_matches_info (add_data->include_files_filter, file, info))
 		return FALSE;
 
 	return ! file_filter_empty (add_data->exclude_files_filter)
-			&& file_filter_matches (add_data->exclude_files_filter, file);
+			&& file_filter_matches_info (add_data->exclude_files_filter, file, info);
 }
 
 
@@ -1131,22 +1386,14 @@ fr_archive_add_files_with_filter (FrArchive           *archive,
 	add_data->exclude_files_filter = file_filter_new (exclude_files);
 	add_data->exclude_directories_filter = file_filter_new (exclude_directories);
 
-	fr_archive_action_started (archive, FR_ACTION_GETTING_FILE_LIST);
-
 	flags = FILE_LIST_RECURSIVE | FILE_LIST_NO_BACKUP_FILES;
 	if (! follow_links)
 		flags |= FILE_LIST_NO_FOLLOW_LINKS;
-	_g_file_list_query_info_async (file_list,
-				       flags,
-				       (G_FILE_ATTRIBUTE_STANDARD_NAME ","
-					G_FILE_ATTRIBUTE_STANDARD_SIZE ","
-					G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
-					G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP),
-				       cancellable,
-				       directory_filter_cb,
-				       file_filter_cb,
-				       fr_archive_add_files_ready_cb,
-				       add_data);
+	_fr_archive_add_files_scan (add_data,
+				    file_list,
+				    flags,
+				    directory_filter_cb,
+				    file_filter_cb);
 }
 
 
@@ -1491,6 +1738,7 @@ fr_archive_test (FrArchive           *archive,
 		 GAsyncReadyCallback  callback,
 		 gpointer             user_data)
 {
+	_fr_archive_free_test_failures (archive);
 	FR_ARCHIVE_GET_CLASS (archive)->test_integrity (archive,
 							password,
 							cancellable,
@@ -1499,6 +1747,29 @@ fr_archive_test (FrArchive           *archive,
 }
 
 
+/* Returns the FrTestFailure list of the last test, only filled by the
+ * archive types that can check the entries one by one. */
+GList *
+fr_archive_get_test_failures (FrArchive *archive)
+{
+	return archive->priv->test_failures;
+}
+
+
+void
+fr_archive_add_test_failure (FrArchive  *archive,
+			     const char *path,
+			     const char *message)
+{
+	FrTestFailure *failure;
+
+	failure = g_new0 (FrTestFailure, 1);
+	failure->path = g_strdup (path);
+	failure->message = g_strdup (message);
+	archive->priv->test_failures = g_list_append (archive->priv->test_failures, failure);
+}
+
+
 void
 fr_archive_rename (FrArchive           *archive,
 		   GList               *file_list,
@@ -1917,6 +2188,55 @@ fr_archive_update_open_files (FrArchive           *archive,
 }
 
 
+/* Returns whether the content of @source can be copied to @archive directly,
+ * without extracting it to a temporary folder first.  @source_password is
+ * used to read @source, @password to write @archive. */
+gboolean
+fr_archive_can_convert (FrArchive  *archive,
+			FrArchive  *source,
+			const char *source_password,
+			const char *password)
+{
+	if ((FR_ARCHIVE_GET_CLASS (archive)->can_convert == NULL)
+	    || (FR_ARCHIVE_GET_CLASS (archive)->convert == NULL))
+	{
+		return FALSE;
+	}
+
+	if (source->multi_volume)
+		return FALSE;
+
+	return FR_ARCHIVE_GET_CLASS (archive)->can_convert (archive, source, source_password, password);
+}
+
+
+void
+fr_archive_convert (FrArchive           *archive,
+		    FrArchive           *source,
+		    const char          *source_password,
+		    const char          *password,
+		    gboolean             encrypt_header,
+		    FrCompression        compression,
+		    guint                volume_size,
+		    GCancellable        *cancellable,
+		    GAsyncReadyCallback  callback,
+		    gpointer             user_data)
+{
+	fr_archive_action_started (archive, FR_ACTION_ADDING_FILES);
+	_fr_archive_activate_progress_update (archive);
+	FR_ARCHIVE_GET_CLASS (archive)->convert (archive,
+						 source,
+						 source_password,
+						 password,
+						 encrypt_header,
+						 compression,
+						 volume_size,
+						 cancellable,
+						 callback,
+						 user_data);
+}
+
+
 void
 fr_archive_set_multi_volume (FrArchive *self,
 			     GFile     *file)
@@ -1926,6 +2246,20 @@ fr_archive_set_multi_volume (FrArchive *self,
 }
 
 
+/* Used by the operations running in a thread to change the archive file
+ * to the first volume, the change is applied in the main thread by
+ * fr_archive_operation_finish. */
+void
+fr_archive_set_result_multi_volume (GSimpleAsyncResult *result,
+				    GFile              *file)
+{
+	g_object_set_data_full (G_OBJECT (result),
+				MULTI_VOLUME_FILE_KEY,
+				g_object_ref (file),
+				g_object_unref);
+}
+
+
 void
 fr_archive_change_name (FrArchive  *archive,
 		        const char *filename)
@@ -2006,6 +2340,16 @@ fr_archive_progress_set_total_files (FrArchive *self,
 }
 
 
+void
+fr_archive_progress_inc_total_files (FrArchive *self,
+				     int        new_total)
+{
+	g_mutex_lock (&self->priv->progress_mutex);
+	self->priv->total_files += new_total;
+	g_mutex_unlock (&self->priv->progress_mutex);
+}
+
+
 int
 fr_archive_progress_get_total_files (FrArchive *self)
 {
@@ -2063,6 +2407,16 @@ fr_archive_progress_set_total_bytes (FrArchive *self,
 }
 
 
+void
+fr_archive_progress_inc_total_bytes (FrArchive *self,
+				     gsize      new_total)
+{
+	g_mutex_lock (&self->priv->progress_mutex);
+	self->priv->total_bytes += new_total;
+	g_mutex_unlock (&self->priv->progress_mutex);
+}
+
+
 static double
 _set_completed_bytes (FrArchive *self,
 		      gsize      completed_bytes)
@@ -2140,6 +2494,152 @@ fr_archive_add_file (FrArchive *self,
 }
 
 
+/* -- FrFileQueue -- */
+
+
+#define QUEUE_POP_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+
+struct _FrFileQueue {
+	int       ref_count;
+	GMutex    mutex;
+	GCond     cond;
+	GQueue   *files;
+	gboolean  closed;
+	gboolean  aborted;
+	GError   *error;
+};
+
+
+FrFileQueue *
+fr_file_queue_new (void)
+{
+	FrFileQueue *queue;
+
+	queue = g_new0 (FrFileQueue, 1);
+	queue->ref_count = 1;
+	g_mutex_init (&queue->mutex);
+	g_cond_init (&queue->cond);
+	queue->files = g_queue_new ();
+	queue->closed = FALSE;
+	queue->error = NULL;
+
+	return queue;
+}
+
+
+FrFileQueue *
+fr_file_queue_ref (FrFileQueue *queue)
+{
+	g_atomic_int_inc (&queue->ref_count);
+	return queue;
+}
+
+
+void
+fr_file_queue_unref (FrFileQueue *queue)
+{
+	if (queue == NULL)
+		return;
+
+	if (! g_atomic_int_dec_and_test (&queue->ref_count))
+		return;
+
+	g_queue_free_full (queue->files, g_object_unref);
+	_g_error_free (queue->error);
+	g_cond_clear (&queue->cond);
+	g_mutex_clear (&queue->mutex);
+	g_free (queue);
+}
+
+
+void
+fr_file_queue_push (FrFileQueue *queue,
+		    GFile       *file)
+{
+	g_mutex_lock (&queue->mutex);
+	if (! queue->aborted) {
+		g_queue_push_tail (queue->files, g_object_ref (file));
+		g_cond_signal (&queue->cond);
+	}
+	g_mutex_unlock (&queue->mutex);
+}
+
+
+/* No more file will be added to the queue, @error is the error that stopped
+ * the producer, if any. */
+void
+fr_file_queue_close (FrFileQueue *queue,
+		     GError      *error)
+{
+	g_mutex_lock (&queue->mutex);
+	queue->closed = TRUE;
+	if ((error != NULL) && (queue->error == NULL))
+		queue->error = g_error_copy (error);
+	g_cond_broadcast (&queue->cond);
+	g_mutex_unlock (&queue->mutex);
+}
+
+
+/* Waits for the next file.  Returns NULL when the queue is closed and empty,
+ * or when an error occurred. */
+GFile *
+fr_file_queue_pop (FrFileQueue   *queue,
+		   GCancellable  *cancellable,
+		   GError       **error)
+{
+	GFile *file = NULL;
+
+	g_mutex_lock (&queue->mutex);
+
+	while (g_queue_is_empty (queue->files)
+	       && ! queue->closed
+	       && ! g_cancellable_is_cancelled (cancellable))
+	{
+		g_cond_wait_until (&queue->cond, &queue->mutex, g_get_monotonic_time () + QUEUE_POP_TIMEOUT);
+	}
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		file = NULL;
+	else if (queue->error != NULL) {
+		if (error != NULL)
+			*error = g_error_copy (queue->error);
+	}
+	else
+		file = g_queue_pop_head (queue->files);
+
+	g_mutex_unlock (&queue->mutex);
+
+	return file;
+}
+
+
+/* The consumer will not pop other files, the queued files are discarded
+ * and the producer should stop. */
+void
+fr_file_queue_abort (FrFileQueue *queue)
+{
+	g_mutex_lock (&queue->mutex);
+	queue->aborted = TRUE;
+	g_queue_foreach (queue->files, (GFunc) g_object_unref, NULL);
+	g_queue_clear (queue->files);
+	g_mutex_unlock (&queue->mutex);
+}
+
+
+gboolean
+fr_file_queue_is_aborted (FrFileQueue *queue)
+{
+	gboolean aborted;
+
+	g_mutex_lock (&queue->mutex);
+	aborted = queue->aborted;
+	g_mutex_unlock (&queue->mutex);
+
+	return aborted;
+}
+
+
 gboolean
 _g_file_is_archive (GFile *file)
 {
@@ -24,6 +24,7 @@
 
 #include <glib.h>
 #include "file-data.h"
+#include "fr-manifest.h"
 #include "typedefs.h"
 
 typedef enum {
@@ -65,8 +66,15 @@ typedef struct _FrArchive         FrArchive;
 typedef struct _FrArchiveClass    FrArchiveClass;
 typedef struct _FrArchivePrivate  FrArchivePrivate;
 
+typedef struct _FrFileQueue       FrFileQueue;
+
 typedef gboolean (*FakeLoadFunc) (FrArchive *archive, gpointer data);
 
+typedef struct {
+	char *path;                                /* NULL if the error is not about a single file */
+	char *message;
+} FrTestFailure;
+
 struct _FrArchive {
 	GObject  __parent;
 	FrArchivePrivate *priv;
@@ -92,6 +100,9 @@ struct _FrArchive {
 	/*<protected>*/
 
 	gssize         files_to_add_size;
+	const char    *files_to_add_attributes;    /* Extra attributes to
+						    * collect while scanning
+						    * the files to add. */
 
 	/* features. */
 
@@ -277,6 +288,18 @@ struct _FrArchiveClass {
 					    GCancellable        *cancellable,
 					    GAsyncReadyCallback  callback,
 					    gpointer             user_data);
+	void          (*add_queued_files)  (FrArchive           *archive,
+					    FrFileQueue         *queue,
+					    GFile               *base_dir,
+					    const char          *dest_dir,
+					    gboolean             follow_links,
+					    const char          *password,
+					    gboolean             encrypt_header,
+					    FrCompression        compression,
+					    guint                volume_size,
+					    GCancellable        *cancellable,
+					    GAsyncReadyCallback  callback,
+					    gpointer             user_data);
 	void          (*extract_files)     (FrArchive           *archive,
 	    				    GList               *file_list,
 	    				    GFile               *destination,
@@ -344,6 +367,20 @@ struct _FrArchiveClass {
 					    GCancellable        *cancellable,
 					    GAsyncReadyCallback  callback,
 					    gpointer             user_data);
+	gboolean      (*can_convert)       (FrArchive           *archive,
+					    FrArchive           *source,
+					    const char          *source_password,
+					    const char          *password);
+	void          (*convert)           (FrArchive           *archive,
+					    FrArchive           *source,
+					    const char          *source_password,
+					    const char          *password,
+					    gboolean             encrypt_header,
+					    FrCompression        compression,
+					    guint                volume_size,
+					    GCancellable        *cancellable,
+					    GAsyncReadyCallback  callback,
+					    gpointer             user_data);
 };
 
 GType         fr_archive_get_type                (void);
@@ -362,6 +399,9 @@ const char *  fr_archive_get_packages            (FrArchive           *archive,
 						  const char          *mime_type);
 void          fr_archive_set_stoppable           (FrArchive           *archive,
 						  gboolean             stoppable);
+void          fr_archive_set_manifest            (FrArchive           *archive,
+						  FrManifest          *manifest);
+FrManifest *  fr_archive_get_manifest            (FrArchive           *archive);
 FrArchive *   fr_archive_create                  (GFile               *file,
 						  const char          *mime_type);
 void          fr_archive_open                    (GFile               *file,
@@ -443,6 +483,7 @@ void          fr_archive_test                    (FrArchive           *archive,
 		       	       	       	          GCancellable        *cancellable,
 		       	       	       	          GAsyncReadyCallback  callback,
 		       	       	       	          gpointer             user_data);
+GList *       fr_archive_get_test_failures       (FrArchive           *archive);
 void          fr_archive_rename                  (FrArchive           *archive,
 						  GList               *file_list,
 						  const char          *old_name,
@@ -488,13 +529,32 @@ void          fr_archive_update_open_files       (FrArchive           *archive,
 						  GCancellable        *cancellable,
 						  GAsyncReadyCallback  callback,
 						  gpointer             user_data);
+gboolean      fr_archive_can_convert             (FrArchive           *archive,
+						  FrArchive           *source,
+						  const char          *source_password,
+						  const char          *password);
+void          fr_archive_convert                 (FrArchive           *archive,
+						  FrArchive           *source,
+						  const char          *source_password,
+						  const char          *password,
+						  gboolean             encrypt_header,
+						  FrCompression        compression,
+						  guint                volume_size,
+						  GCancellable        *cancellable,
+						  GAsyncReadyCallback  callback,
+						  gpointer             user_data);
 
 /* protected */
 
 void          fr_archive_set_multi_volume        (FrArchive           *archive,
 					          GFile               *file);
+void          fr_archive_set_result_multi_volume (GSimpleAsyncResult  *result,
+						  GFile               *file);
 void          fr_archive_change_name             (FrArchive           *archive,
 						  const char          *filename);
+void          fr_archive_add_test_failure        (FrArchive           *archive,
+						  const char          *path,
+						  const char          *message);
 void          fr_archive_action_started          (FrArchive           *archive,
                                                   FrAction             action);
 void          fr_archive_progress                (FrArchive           *archive,
@@ -506,6 +566,8 @@ void          fr_archive_working_archive         (FrArchive           *archive,
 void          fr_archive_progress_set_total_files(FrArchive           *archive,
 						  int                  total);
 int           fr_archive_progress_get_total_files(FrArchive           *archive);
+void          fr_archive_progress_inc_total_files(FrArchive           *archive,
+						  int                  new_total);
 int           fr_archive_progress_get_completed_files
 						 (FrArchive           *archive);
 double        fr_archive_progress_inc_completed_files
@@ -513,6 +575,8 @@ double        fr_archive_progress_inc_completed_files
 						  int                  new_completed);
 void          fr_archive_progress_set_total_bytes (FrArchive           *archive,
 						  gsize                total);
+void          fr_archive_progress_inc_total_bytes (FrArchive           *archive,
+						  gsize                new_total);
 double        fr_archive_progress_set_completed_bytes
 						 (FrArchive           *self,
 						  gsize                completed_bytes);
@@ -523,6 +587,22 @@ double        fr_archive_progress_get_fraction   (FrArchive           *archive);
 void          fr_archive_add_file                (FrArchive           *archive,
 						  FileData            *file_data);
 
+/* file queue, used to add the files while the source folders are being
+ * scanned. */
+
+FrFileQueue * fr_file_queue_new                  (void);
+FrFileQueue * fr_file_queue_ref                  (FrFileQueue         *queue);
+void          fr_file_queue_unref                (FrFileQueue         *queue);
+void          fr_file_queue_push                 (FrFileQueue         *queue,
+						  GFile               *file);
+void          fr_file_queue_close                (FrFileQueue         *queue,
+						  GError              *error);
+GFile *       fr_file_queue_pop                  (FrFileQueue         *queue,
+						  GCancellable        *cancellable,
+						  GError             **error);
+void          fr_file_queue_abort                (FrFileQueue         *queue);
+gboolean      fr_file_queue_is_aborted           (FrFileQueue         *queue);
+
 /* utilities */
 
 gboolean      _g_file_is_archive                 (GFile               *file);
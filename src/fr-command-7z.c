@@ -26,6 +26,7 @@
 #include <time.h>
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include "file-data.h"
 #include "file-utils.h"
 #include "glib-utils.h"
@@ -34,9 +35,76 @@
 #include "rar-utils.h"
 
 
+#define BLOCK_CACHE_MAX_SIZE (256 * 1024 * 1024)
+#define BLOCK_CACHE_MAX_TOTAL_SIZE (1024 * 1024 * 1024)
+
+
 G_DEFINE_TYPE (FrCommand7z, fr_command_7z, FR_TYPE_COMMAND)
 
 
+/* -- block cache -- */
+
+
+static void
+block_cache_clear (FrCommand7z *self)
+{
+	if (self->block_cache != NULL) {
+		GFile *directory;
+
+		directory = g_file_new_for_path (self->block_cache);
+		_g_file_remove_directory (directory, NULL, NULL);
+		g_object_unref (directory);
+
+		g_free (self->block_cache);
+		self->block_cache = NULL;
+	}
+
+	g_hash_table_remove_all (self->cached_blocks);
+	self->cached_size = 0;
+	g_list_free (self->pending_blocks);
+	self->pending_blocks = NULL;
+}
+
+
+static void
+block_index_clear (FrCommand7z *self)
+{
+	block_cache_clear (self);
+	g_hash_table_remove_all (self->file_block);
+	g_array_set_size (self->block_size, 0);
+	self->solid = FALSE;
+}
+
+
+static void
+block_index_add_file (FrCommand7z *self,
+		      FileData    *fdata,
+		      int          block)
+{
+	goffset *size;
+
+	if (block < 0)
+		return;
+
+	g_hash_table_insert (self->file_block,
+			     g_strdup (fdata->original_path),
+			     GINT_TO_POINTER (block + 1));
+
+	if (block >= self->block_size->len)
+		g_array_set_size (self->block_size, block + 1);
+	size = &g_array_index (self->block_size, goffset, block);
+	*size += fdata->size;
+}
+
+
+static int
+block_index_get_block (FrCommand7z *self,
+		       const char  *original_path)
+{
+	return GPOINTER_TO_INT (g_hash_table_lookup (self->file_block, original_path)) - 1;
+}
+
+
 /* -- list -- */
 
 
@@ -112,6 +180,8 @@ list__process_line (char     *line,
 			archive->multi_volume = (strcmp (fields[1], "+") == 0);
 			g_strfreev (fields);
 		}
+		else if (strncmp (line, "Solid = ", 8) == 0)
+			self->solid = (strcmp (line + 8, "+") == 0);
 		return;
 	}
 
@@ -128,6 +198,8 @@ list__process_line (char     *line,
 				else
 					fdata->name = g_strdup (_g_path_get_basename (fdata->full_path));
 				fdata->path = _g_path_remove_level (fdata->full_path);
+				if (! fdata->dir)
+					block_index_add_file (self, fdata, self->fdata_block);
 				fr_archive_add_file (archive, fdata);
 				self->fdata = NULL;
 			}
@@ -135,8 +207,10 @@ list__process_line (char     *line,
 		return;
 	}
 
-	if (self->fdata == NULL)
+	if (self->fdata == NULL) {
 		self->fdata = file_data_new ();
+		self->fdata_block = -1;
+	}
 
 	fields = g_strsplit (line, " = ", 2);
 
@@ -161,6 +235,10 @@ list__process_line (char     *line,
 	else if (strcmp (fields[0], "Size") == 0) {
 		fdata->size = g_ascii_strtoull (fields[1], NULL, 10);
 	}
+	else if (strcmp (fields[0], "Block") == 0) {
+		if (fields[1][0] != 0)
+			self->fdata_block = atoi (fields[1]);
+	}
 	else if (strcmp (fields[0], "Modified") == 0) {
 		char **modified_fields;
 
@@ -228,6 +306,7 @@ list__begin (gpointer data)
 static gboolean
 fr_command_7z_list (FrCommand *command)
 {
+	block_index_clear (FR_COMMAND_7Z (command));
 	rar_check_multi_volume (command);
 
 	fr_process_set_out_line_func (command->process, list__process_line, command);
@@ -309,6 +388,8 @@ fr_command_7z_add (FrCommand  *command,
 	FrArchive *archive = FR_ARCHIVE (command);
 	GList     *scan;
 
+	block_cache_clear (FR_COMMAND_7Z (command));
+
 	fr_process_use_standard_locale (command->process, TRUE);
 	fr_process_set_out_line_func (command->process,
 				      process_line__add,
@@ -402,6 +483,8 @@ fr_command_7z_delete (FrCommand  *command,
 	FrArchive *archive = FR_ARCHIVE (command);
 	GList     *scan;
 
+	block_cache_clear (FR_COMMAND_7Z (command));
+
 	fr_command_7z_begin_command (command);
 	fr_process_add_arg (command->process, "d");
 	fr_process_add_arg (command->process, "-bd");
@@ -450,6 +533,183 @@ process_line__extract (char     *line,
 }
 
 
+/* A block is marked as cached only when its command succeeds, after an
+ * error or when the operation is stopped the whole cache is dropped
+ * because the block may be incomplete. */
+static gboolean
+extract_block_continue_func (FrError  **error,
+			     gpointer   user_data)
+{
+	FrCommand7z *self = user_data;
+	gpointer     block;
+
+	if (self->pending_blocks == NULL)
+		return TRUE;
+
+	block = self->pending_blocks->data;
+	self->pending_blocks = g_list_delete_link (self->pending_blocks, self->pending_blocks);
+
+	if (*error != NULL) {
+		if (((*error)->type == FR_ERROR_COMMAND_ERROR) && ((*error)->status <= 1)) {
+			/* a warning: copy the files anyway, as done when
+			 * extracting directly, but don't reuse the block. */
+			fr_error_free (*error);
+			*error = NULL;
+		}
+		else
+			block_cache_clear (self);
+		return TRUE;
+	}
+
+	g_hash_table_add (self->cached_blocks, block);
+	self->cached_size += g_array_index (self->block_size, goffset, GPOINTER_TO_INT (block) - 1);
+
+	return TRUE;
+}
+
+
+/* The names of the block members are passed with a list file, a block
+ * can contain more files than a command line can hold. */
+static gboolean
+add_extract_block_command (FrCommand7z *self,
+			   int          block)
+{
+	FrCommand      *command = FR_COMMAND (self);
+	GHashTableIter  iter;
+	gpointer        key, value;
+	GString        *list;
+	char           *list_name;
+	char           *list_filename;
+	char           *data_dir;
+	gboolean        success;
+
+	list = g_string_new ("");
+	g_hash_table_iter_init (&iter, self->file_block);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (GPOINTER_TO_INT (value) - 1 == block) {
+			g_string_append (list, key);
+			g_string_append_c (list, '\n');
+		}
+	}
+
+	list_name = g_strdup_printf ("block-%d", block);
+	list_filename = g_build_filename (self->block_cache, "lists", list_name, NULL);
+	success = g_file_set_contents (list_filename, list->str, list->len, NULL);
+
+	if (success) {
+		data_dir = g_build_filename (self->block_cache, "data", NULL);
+
+		fr_command_7z_begin_command (command);
+		fr_process_set_continue_func (command->process, extract_block_continue_func, self);
+		fr_process_add_arg (command->process, "x");
+		fr_process_add_arg (command->process, "-bd");
+		fr_process_add_arg (command->process, "-y");
+		add_password_arg (command, FR_ARCHIVE (self)->password, FALSE);
+		fr_process_add_arg_concat (command->process, "-o", data_dir, NULL);
+		fr_process_add_arg_concat (command->process, "-i@", list_filename, NULL);
+		fr_process_add_arg (command->process, "--");
+		fr_process_add_arg (command->process, command->filename);
+		fr_process_end_command (command->process);
+
+		self->pending_blocks = g_list_append (self->pending_blocks, GINT_TO_POINTER (block + 1));
+
+		g_free (data_dir);
+	}
+
+	g_free (list_filename);
+	g_free (list_name);
+	g_string_free (list, TRUE);
+
+	return success;
+}
+
+
+/* In a solid archive the whole block must be decompressed to reach a single
+ * file, so extract the complete block once in a cache directory and copy the
+ * requested files from there.  Returns FALSE if the files cannot be
+ * extracted this way. */
+static gboolean
+extract_from_block_cache (FrCommand7z *self,
+			  GList       *file_list,
+			  const char  *dest_dir,
+			  gboolean     junk_paths)
+{
+	FrCommand *command = FR_COMMAND (self);
+	GList     *blocks = NULL;
+	GList     *scan;
+	goffset    new_size;
+	char      *data_dir;
+
+	if (! self->solid || (file_list == NULL) || (dest_dir == NULL))
+		return FALSE;
+
+	for (scan = file_list; scan; scan = scan->next) {
+		int block;
+
+		block = block_index_get_block (self, scan->data);
+		if ((block < 0) || (g_array_index (self->block_size, goffset, block) > BLOCK_CACHE_MAX_SIZE)) {
+			g_list_free (blocks);
+			return FALSE;
+		}
+
+		if (! g_list_find (blocks, GINT_TO_POINTER (block + 1)))
+			blocks = g_list_prepend (blocks, GINT_TO_POINTER (block + 1));
+	}
+
+	/* keep the cache size limited, drop the cached blocks if the new
+	 * ones don't fit. */
+
+	new_size = 0;
+	for (scan = blocks; scan; scan = scan->next)
+		if (! g_hash_table_contains (self->cached_blocks, scan->data))
+			new_size += g_array_index (self->block_size, goffset, GPOINTER_TO_INT (scan->data) - 1);
+	if (self->cached_size + new_size > BLOCK_CACHE_MAX_TOTAL_SIZE)
+		block_cache_clear (self);
+
+	if (self->block_cache == NULL) {
+		char *lists_dir;
+
+		self->block_cache = _g_path_get_temp_work_dir (NULL);
+		lists_dir = g_build_filename (self->block_cache, "lists", NULL);
+		g_mkdir (lists_dir, 0700);
+		g_free (lists_dir);
+	}
+
+	g_list_free (self->pending_blocks);
+	self->pending_blocks = NULL;
+
+	for (scan = blocks; scan; scan = scan->next) {
+		if (g_hash_table_contains (self->cached_blocks, scan->data))
+			continue;
+
+		if (! add_extract_block_command (self, GPOINTER_TO_INT (scan->data) - 1)) {
+			g_list_free (blocks);
+			return FALSE;
+		}
+	}
+
+	g_list_free (blocks);
+
+	data_dir = g_build_filename (self->block_cache, "data", NULL);
+
+	fr_process_begin_command (command->process, "cp");
+	fr_process_set_working_dir (command->process, data_dir);
+	fr_process_add_arg (command->process, "-f");
+	fr_process_add_arg (command->process, "-p");
+	if (! junk_paths)
+		fr_process_add_arg (command->process, "--parents");
+	fr_process_add_arg (command->process, "--");
+	for (scan = file_list; scan; scan = scan->next)
+		fr_process_add_arg (command->process, scan->data);
+	fr_process_add_arg (command->process, dest_dir);
+	fr_process_end_command (command->process);
+
+	g_free (data_dir);
+
+	return TRUE;
+}
+
+
 static void
 fr_command_7z_extract (FrCommand  *command,
 		       const char *from_file,
@@ -466,6 +726,13 @@ fr_command_7z_extract (FrCommand  *command,
 	fr_process_set_out_line_func (command->process,
 				      process_line__extract,
 				      command);
+
+	if ((from_file == NULL)
+	    && extract_from_block_cache (FR_COMMAND_7Z (command), file_list, dest_dir, junk_paths))
+	{
+		return;
+	}
+
 	fr_command_7z_begin_command (command);
 
 	if (junk_paths)
@@ -558,6 +825,9 @@ fr_command_7z_handle_error (FrCommand *command,
 	else {
 		GList *scan;
 
+		/* the cached blocks may be incomplete. */
+		block_cache_clear (FR_COMMAND_7Z (command));
+
 		for (scan = g_list_last (command->process->out.raw); scan; scan = scan->prev) {
 			char *line = scan->data;
 
@@ -668,9 +938,17 @@ fr_command_7z_get_packages (FrArchive  *archive,
 static void
 fr_command_7z_finalize (GObject *object)
 {
+	FrCommand7z *self;
+
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (FR_IS_COMMAND_7Z (object));
 
+	self = FR_COMMAND_7Z (object);
+	block_cache_clear (self);
+	g_hash_table_destroy (self->cached_blocks);
+	g_hash_table_destroy (self->file_block);
+	g_array_free (self->block_size, TRUE);
+
 	/* Chain up */
 	if (G_OBJECT_CLASS (fr_command_7z_parent_class)->finalize)
 		G_OBJECT_CLASS (fr_command_7z_parent_class)->finalize (object);
@@ -720,4 +998,10 @@ fr_command_7z_init (FrCommand7z *self)
 	base->propPassword                 = TRUE;
 	base->propTest                     = TRUE;
 	base->propListFromFile             = TRUE;
+
+	self->solid = FALSE;
+	self->file_block = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->block_size = g_array_new (FALSE, TRUE, sizeof (goffset));
+	self->block_cache = NULL;
+	self->cached_blocks = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
@@ -42,6 +42,20 @@ struct _FrCommand7z
 	gboolean   list_started;
 	gboolean   old_style;
 	FileData  *fdata;
+	int        fdata_block;
+
+	/*<private>*/
+
+	gboolean    solid;
+	GHashTable *file_block;     /* original path -> solid block + 1 */
+	GArray     *block_size;     /* uncompressed size of each block */
+	char       *block_cache;    /* directory where whole blocks are
+				     * extracted. */
+	GHashTable *cached_blocks;  /* solid blocks + 1 extracted in
+				     * block_cache. */
+	goffset     cached_size;    /* size of the cached blocks */
+	GList      *pending_blocks; /* blocks + 1 being extracted, in
+				     * command order. */
 };
 
 struct _FrCommand7zClass
@@ -89,104 +89,272 @@ get_uncompressed_name_from_archive (FrCommand  *comm,
 }
 
 
-static void
-list__process_line (char     *line,
-		    gpointer  data)
+/* -- get_uncompressed_size -- */
+
+
+static gboolean
+read_at (GInputStream *stream,
+	 goffset       offset,
+	 guchar       *buffer,
+	 gsize         size)
 {
-	FrCommand  *comm = FR_COMMAND (data);
-	FileData   *fdata;
-	char      **fields;
-	GFile      *file;
-	char       *filename;
+	gsize bytes_read;
 
-	fdata = file_data_new ();
+	if (offset < 0)
+		return FALSE;
+	if (! g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL, NULL))
+		return FALSE;
+	if (! g_input_stream_read_all (stream, buffer, size, &bytes_read, NULL, NULL))
+		return FALSE;
 
-	fields = _g_str_split_line (line, 2);
-	if (strcmp (fields[1], "-1") != 0)
-		fdata->size = g_ascii_strtoull (fields[1], NULL, 10);
-	g_strfreev (fields);
+	return bytes_read == size;
+}
 
-	file = g_file_new_for_path (comm->filename);
 
-	if (fdata->size == 0)
-		fdata->size = _g_file_get_file_size (file);
+static guint32
+get_uint32_le (const guchar *buffer)
+{
+	return ((guint32) buffer[0]
+		| ((guint32) buffer[1] << 8)
+		| ((guint32) buffer[2] << 16)
+		| ((guint32) buffer[3] << 24));
+}
 
-	filename = get_uncompressed_name_from_archive (comm, comm->filename);
-	if (filename == NULL)
-		filename = _g_path_remove_first_extension (comm->filename);
 
-	fdata->full_path = g_strconcat ("/", _g_path_get_basename (filename), NULL);
-	g_free (filename);
+/* Returns the size of the gzip header, the optional fields included. */
+static goffset
+get_gzip_header_size (GInputStream *stream,
+		      goffset       file_size)
+{
+	guchar  buffer[10];
+	guchar  flags;
+	goffset offset;
+
+	if (! read_at (stream, 0, buffer, 10))
+		return -1;
+	if ((buffer[0] != 0x1f) || (buffer[1] != 0x8b))
+		return -1;
+
+	flags = buffer[3];
+	offset = 10;
+
+	if (flags & 0x04) { /* FEXTRA */
+		if (! read_at (stream, offset, buffer, 2))
+			return -1;
+		offset += 2 + (buffer[0] | (buffer[1] << 8));
+	}
 
-	fdata->original_path = fdata->full_path + 1;
-	fdata->link = NULL;
-	fdata->modified = _g_file_get_file_mtime (file);
+	if (flags & 0x08) { /* FNAME */
+		do {
+			if (! read_at (stream, offset++, buffer, 1))
+				return -1;
+		}
+		while (buffer[0] != '\0');
+	}
 
-	fdata->name = g_strdup (_g_path_get_basename (fdata->full_path));
-	fdata->path = _g_path_remove_level (fdata->full_path);
+	if (flags & 0x10) { /* FCOMMENT */
+		do {
+			if (! read_at (stream, offset++, buffer, 1))
+				return -1;
+		}
+		while (buffer[0] != '\0');
+	}
 
-	if (*fdata->name == 0)
-		file_data_free (fdata);
-	else
-		fr_archive_add_file (FR_ARCHIVE (comm), fdata);
+	if (flags & 0x02) /* FHCRC */
+		offset += 2;
 
-	g_object_unref (file);
+	return (offset <= file_size) ? offset : -1;
+}
+
+
+/* The gzip trailer stores the size of the uncompressed data modulo 2^32
+ * (ISIZE), which is all 'gzip -l' reports.  When the compressed data alone
+ * is 4 GiB or more the uncompressed size is 4 GiB or more as well, and the
+ * high bits cannot be recovered, so the size is unknown. */
+static goffset
+get_gzip_uncompressed_size (GInputStream *stream,
+			    goffset       file_size)
+{
+	guchar  buffer[4];
+	goffset header_size;
+
+	header_size = get_gzip_header_size (stream, file_size);
+	if ((header_size < 0) || (file_size < header_size + 8))
+		return -1;
+	if (file_size - header_size - 8 >= G_MAXUINT32)
+		return -1;
+	if (! read_at (stream, file_size - 4, buffer, 4))
+		return -1;
+
+	return get_uint32_le (buffer);
 }
 
 
 static gboolean
-fr_command_cfile_list (FrCommand *comm)
+read_xz_varint (const guchar **p,
+		const guchar  *end,
+		guint64       *value)
 {
-	if (_g_mime_type_matches (FR_ARCHIVE (comm)->mime_type, "application/x-gzip")) {
-		/* gzip let us known the uncompressed size */
+	int i;
 
-		fr_process_set_out_line_func (comm->process,
-					      list__process_line,
-					      comm);
+	*value = 0;
+	for (i = 0; (i < 9) && (*p < end); i++) {
+		guchar byte = *(*p)++;
 
-		fr_process_begin_command (comm->process, "gzip");
-		fr_process_add_arg (comm->process, "-l");
-		fr_process_add_arg (comm->process, "-q");
-		fr_process_add_arg (comm->process, comm->filename);
-		fr_process_end_command (comm->process);
+		*value |= (guint64) (byte & 0x7F) << (i * 7);
+		if ((byte & 0x80) == 0)
+			return TRUE;
 	}
-	else {
-		/* ... other compressors do not support this feature so
-		 * simply use the archive size, suboptimal but there is no
-		 * alternative. */
 
-		FileData *fdata;
-		char     *filename;
-		GFile    *file;
+	return FALSE;
+}
 
-		fdata = file_data_new ();
 
-		filename = _g_path_remove_first_extension (comm->filename);
-		fdata->full_path = g_strconcat ("/",
-						_g_path_get_basename (filename),
-						NULL);
-		g_free (filename);
+#define XZ_HEADER_SIZE 12
+#define XZ_MAX_INDEX_SIZE (16 * 1024 * 1024)
 
-		file = g_file_new_for_path (comm->filename);
 
-		fdata->original_path = fdata->full_path + 1;
-		fdata->link = NULL;
-		fdata->size = _g_file_get_file_size (file);
-		fdata->modified = _g_file_get_file_mtime (file);
-		fdata->name = g_strdup (_g_path_get_basename (fdata->full_path));
-		fdata->path = _g_path_remove_level (fdata->full_path);
+/* Sum the uncompressed sizes stored in the index of every stream,
+ * walking the file backwards from the last stream footer. */
+static goffset
+get_xz_uncompressed_size (GInputStream *stream,
+			  goffset       file_size)
+{
+	goffset total = 0;
+	goffset end = file_size;
+
+	while (end > 0) {
+		guchar        footer[XZ_HEADER_SIZE];
+		goffset       index_size;
+		goffset       index_offset;
+		guchar       *index;
+		const guchar *p;
+		const guchar *index_end;
+		guint64       n_records;
+		guint64       i;
+		goffset       blocks_size = 0;
+		gboolean      valid;
+
+		/* skip the stream padding */
+
+		for (;;) {
+			if (end < 2 * XZ_HEADER_SIZE)
+				return -1;
+			if (! read_at (stream, end - 4, footer, 4))
+				return -1;
+			if (get_uint32_le (footer) != 0)
+				break;
+			end -= 4;
+		}
 
-		if (*fdata->name == 0)
-			file_data_free (fdata);
-		else
-			fr_archive_add_file (FR_ARCHIVE (comm), fdata);
+		if (! read_at (stream, end - XZ_HEADER_SIZE, footer, XZ_HEADER_SIZE))
+			return -1;
+		if ((footer[10] != 'Y') || (footer[11] != 'Z'))
+			return -1;
+
+		index_size = ((goffset) get_uint32_le (footer + 4) + 1) * 4;
+		index_offset = end - XZ_HEADER_SIZE - index_size;
+		if ((index_size > XZ_MAX_INDEX_SIZE) || (index_offset < XZ_HEADER_SIZE))
+			return -1;
+
+		index = g_malloc (index_size);
+		valid = read_at (stream, index_offset, index, index_size) && (index[0] == 0x00);
+		p = index + 1;
+		index_end = index + index_size;
+		if (valid)
+			valid = read_xz_varint (&p, index_end, &n_records);
+		for (i = 0; valid && (i < n_records); i++) {
+			guint64 unpadded_size;
+			guint64 uncompressed_size;
+
+			valid = read_xz_varint (&p, index_end, &unpadded_size)
+				&& read_xz_varint (&p, index_end, &uncompressed_size);
+			if (valid) {
+				blocks_size += (unpadded_size + 3) & ~G_GUINT64_CONSTANT (3);
+				total += uncompressed_size;
+			}
+		}
+		g_free (index);
 
-		g_object_unref (file);
+		if (! valid)
+			return -1;
 
-		return FALSE;
+		/* go to the end of the previous stream */
+
+		end = index_offset - blocks_size - XZ_HEADER_SIZE;
+		if (end < 0)
+			return -1;
 	}
 
-	return TRUE;
+	return total;
+}
+
+
+static goffset
+get_uncompressed_size (FrCommand *comm,
+		       GFile     *file)
+{
+	GInputStream *stream;
+	goffset       file_size;
+	goffset       size = -1;
+
+	stream = (GInputStream *) g_file_read (file, NULL, NULL);
+	if (stream == NULL)
+		return -1;
+
+	file_size = _g_file_get_file_size (file);
+	if (_g_mime_type_matches (FR_ARCHIVE (comm)->mime_type, "application/x-gzip"))
+		size = get_gzip_uncompressed_size (stream, file_size);
+	else if (_g_mime_type_matches (FR_ARCHIVE (comm)->mime_type, "application/x-xz"))
+		size = get_xz_uncompressed_size (stream, file_size);
+
+	g_object_unref (stream);
+
+	return size;
+}
+
+
+static gboolean
+fr_command_cfile_list (FrCommand *comm)
+{
+	FileData *fdata;
+	char     *filename;
+	GFile    *file;
+
+	file = g_file_new_for_path (comm->filename);
+
+	fdata = file_data_new ();
+
+	filename = get_uncompressed_name_from_archive (comm, comm->filename);
+	if (filename == NULL)
+		filename = _g_path_remove_first_extension (comm->filename);
+	fdata->full_path = g_strconcat ("/",
+					_g_path_get_basename (filename),
+					NULL);
+	g_free (filename);
+
+	fdata->original_path = fdata->full_path + 1;
+	fdata->link = NULL;
+
+	/* gzip and xz let us know the uncompressed size, other compressors
+	 * do not support this feature so simply use the archive size,
+	 * suboptimal but there is no alternative. */
+
+	fdata->size = get_uncompressed_size (comm, file);
+	if (fdata->size < 0)
+		fdata->size = _g_file_get_file_size (file);
+	fdata->modified = _g_file_get_file_mtime (file);
+	fdata->name = g_strdup (_g_path_get_basename (fdata->full_path));
+	fdata->path = _g_path_remove_level (fdata->full_path);
+
+	if (*fdata->name == 0)
+		file_data_free (fdata);
+	else
+		fr_archive_add_file (FR_ARCHIVE (comm), fdata);
+
+	g_object_unref (file);
+
+	return FALSE;
 }
 
 
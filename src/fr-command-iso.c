@@ -146,6 +146,8 @@ fr_command_iso_list (FrCommand *comm)
 }
 
 
+/* All the files are extracted by a single isoinfo.sh command, this way the
+ * image is probed with 'isoinfo -d' only once. */
 static void
 fr_command_iso_extract (FrCommand  *comm,
 			const char *from_file,
@@ -157,40 +159,18 @@ fr_command_iso_extract (FrCommand  *comm,
 {
 	GList *scan;
 
-	for (scan = file_list; scan; scan = scan->next) {
-		char       *path = scan->data;
-		const char *filename;
-		char       *file_dir;
-		char       *temp_dest_dir = NULL;
-		GFile      *directory;
-
-		filename = _g_path_get_basename (path);
-		file_dir = _g_path_remove_level (path);
-		if ((file_dir != NULL) && (strcmp (file_dir, "/") != 0))
-			temp_dest_dir = g_build_filename (dest_dir, file_dir, NULL);
-		 else
-			temp_dest_dir = g_strdup (dest_dir);
-		g_free (file_dir);
-
-		if (temp_dest_dir == NULL)
-			continue;
-
-		directory = g_file_new_for_path (temp_dest_dir);
-		_g_file_make_directory_tree (directory, 0700, NULL);
-
-		fr_process_begin_command (comm->process, "sh");
-		fr_process_set_working_dir (comm->process, temp_dest_dir);
-		fr_process_add_arg (comm->process, SHDIR "isoinfo.sh");
-		fr_process_add_arg (comm->process, "-i");
-		fr_process_add_arg (comm->process, comm->filename);
-		fr_process_add_arg (comm->process, "-x");
-		fr_process_add_arg (comm->process, path);
-		fr_process_add_arg (comm->process, filename);
-		fr_process_end_command (comm->process);
-
-		g_object_unref (directory);
-		g_free (temp_dest_dir);
-	}
+	if (file_list == NULL)
+		return;
+
+	fr_process_begin_command (comm->process, "sh");
+	fr_process_set_working_dir (comm->process, dest_dir);
+	fr_process_add_arg (comm->process, SHDIR "isoinfo.sh");
+	fr_process_add_arg (comm->process, "-i");
+	fr_process_add_arg (comm->process, comm->filename);
+	fr_process_add_arg (comm->process, "-X");
+	for (scan = file_list; scan; scan = scan->next)
+		fr_process_add_arg (comm->process, (char *) scan->data);
+	fr_process_end_command (comm->process);
 }
 
 
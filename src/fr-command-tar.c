@@ -33,6 +33,7 @@
 #include "glib-utils.h"
 #include "fr-command.h"
 #include "fr-command-tar.h"
+#include "preferences.h"
 
 #define ACTIVITY_DELAY 20
 
@@ -182,16 +183,145 @@ process_line (char     *line,
 }
 
 
+/* -- parallel compressors -- */
+
+
+typedef struct {
+	const char *program;
+	const char *parallel_program;
+	const char *threads_option;   /* option used to limit the threads. */
+	gboolean    attached;         /* whether the number of threads must
+				       * be attached to the option. */
+	const char *all_threads;      /* option used to enable all the
+				       * processors, NULL if it's the
+				       * default. */
+} ParallelCompressor;
+
+
+static ParallelCompressor parallel_compressors[] = {
+	{ "gzip", "pigz", "-p", FALSE, NULL },
+	{ "bzip2", "pbzip2", "-p", TRUE, NULL },
+	{ "bzip2", "lbzip2", "-n", FALSE, NULL },
+	{ "lzip", "plzip", "-n", FALSE, NULL },
+	{ "xz", "xz", "-T", FALSE, "-T0" },
+	{ NULL, NULL, NULL, FALSE, NULL }
+};
+
+
+static int
+get_max_compression_threads (void)
+{
+	GSettings *settings;
+	int        n_threads;
+
+	settings = g_settings_new (FILE_ROLLER_SCHEMA_GENERAL);
+	n_threads = g_settings_get_int (settings, PREF_GENERAL_COMPRESSION_THREADS);
+	g_object_unref (settings);
+
+	return MAX (0, n_threads);
+}
+
+
+/* Returns the command line to use in place of @program, a parallel drop-in
+ * replacement is used if available.  The result is a NULL terminated array
+ * of arguments, free it with g_strfreev(). */
+static char **
+get_compressor_argv (const char *program)
+{
+	GPtrArray *argv;
+	int        i;
+
+	argv = g_ptr_array_new ();
+
+	for (i = 0; parallel_compressors[i].program != NULL; i++) {
+		ParallelCompressor *compressor = &parallel_compressors[i];
+		int                 n_threads;
+
+		if (strcmp (compressor->program, program) != 0)
+			continue;
+		if (! _g_program_is_in_path (compressor->parallel_program))
+			continue;
+
+		g_ptr_array_add (argv, g_strdup (compressor->parallel_program));
+
+		n_threads = get_max_compression_threads ();
+		if (n_threads > 0) {
+			if (compressor->attached)
+				g_ptr_array_add (argv, g_strdup_printf ("%s%d", compressor->threads_option, n_threads));
+			else {
+				g_ptr_array_add (argv, g_strdup (compressor->threads_option));
+				g_ptr_array_add (argv, g_strdup_printf ("%d", n_threads));
+			}
+		}
+		else if (compressor->all_threads != NULL)
+			g_ptr_array_add (argv, g_strdup (compressor->all_threads));
+
+		break;
+	}
+
+	if (argv->len == 0)
+		g_ptr_array_add (argv, g_strdup (program));
+	g_ptr_array_add (argv, NULL);
+
+	return (char **) g_ptr_array_free (argv, FALSE);
+}
+
+
+static char *
+get_compressor_command_line (const char *program)
+{
+	char **argv;
+	char  *command_line;
+
+	argv = get_compressor_argv (program);
+	command_line = g_strjoinv (" ", argv);
+	g_strfreev (argv);
+
+	return command_line;
+}
+
+
+static void
+begin_compressor_command (FrCommand  *comm,
+			  const char *program)
+{
+	char **argv;
+	int    i;
+
+	argv = get_compressor_argv (program);
+	fr_process_begin_command (comm->process, argv[0]);
+	for (i = 1; argv[i] != NULL; i++)
+		fr_process_add_arg (comm->process, argv[i]);
+	g_strfreev (argv);
+}
+
+
+static void
+add_compress_program_arg (FrCommand  *comm,
+			  const char *program)
+{
+	char *command_line;
+
+	command_line = get_compressor_command_line (program);
+	fr_process_add_arg_concat (comm->process, "--use-compress-program=", command_line, NULL);
+	g_free (command_line);
+}
+
+
 static void
 add_compress_arg (FrCommand *comm)
 {
 	FrArchive *archive = FR_ARCHIVE (comm);
 
-	if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar"))
-		fr_process_add_arg (comm->process, "-z");
+	if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar")) {
+		if (_g_program_is_in_path ("pigz"))
+			add_compress_program_arg (comm, "gzip");
+		else
+			fr_process_add_arg (comm->process, "-z");
+	}
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-bzip-compressed-tar"))
-		fr_process_add_arg (comm->process, "--use-compress-program=bzip2");
+		add_compress_program_arg (comm, "bzip2");
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-tarz")) {
 		if (_g_program_is_in_path ("gzip"))
@@ -206,13 +336,13 @@ add_compress_arg (FrCommand *comm)
 		fr_process_add_arg (comm->process, "--use-compress-program=lz4");
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzip-compressed-tar"))
-		fr_process_add_arg (comm->process, "--use-compress-program=lzip");
+		add_compress_program_arg (comm, "lzip");
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzma-compressed-tar"))
 		fr_process_add_arg (comm->process, "--use-compress-program=lzma");
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-xz-compressed-tar"))
-		fr_process_add_arg (comm->process, "--use-compress-program=xz");
+		add_compress_program_arg (comm, "xz");
 
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzop-compressed-tar"))
 		fr_process_add_arg (comm->process, "--use-compress-program=lzop");
@@ -228,22 +358,34 @@ add_compress_arg (FrCommand *comm)
 }
 
 
-static void
-begin_tar_command (FrCommand *comm)
+static char *
+get_tar_command (void)
 {
 	char *command = NULL;
 
 	/* In solaris gtar is present under /usr/sfw/bin */
 
-	command = g_find_program_in_path ("gtar");
+	command = g_strdup (_g_program_get_path ("gtar"));
 #if defined (__SVR4) && defined (__sun)
-	if (g_file_test ("/usr/sfw/bin/gtar", G_FILE_TEST_IS_EXECUTABLE))
+	if (g_file_test ("/usr/sfw/bin/gtar", G_FILE_TEST_IS_EXECUTABLE)) {
+		g_free (command);
 		command = g_strdup ("/usr/sfw/bin/gtar");
+	}
 #endif
-	if (command != NULL)
-		fr_process_begin_command (comm->process, command);
-	else
-		fr_process_begin_command (comm->process, "tar");
+	if (command == NULL)
+		command = g_strdup ("tar");
+
+	return command;
+}
+
+
+static void
+begin_tar_command (FrCommand *comm)
+{
+	char *command;
+
+	command = get_tar_command ();
+	fr_process_begin_command (comm->process, command);
 	g_free (command);
 }
 
@@ -308,6 +450,9 @@ process_line__add (char     *line,
 }
 
 
+static void uncompress_postponed_archive (FrCommandTar *c_tar);
+
+
 static void
 fr_command_tar_add (FrCommand  *comm,
 		    const char *from_file,
@@ -319,6 +464,12 @@ fr_command_tar_add (FrCommand  *comm,
 	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
 	GList        *scan;
 
+	/* GNU tar cannot append to a stream, files are appended to the
+	 * uncompressed archive on disk, written by the last filter if
+	 * any. */
+
+	uncompress_postponed_archive (c_tar);
+
 	fr_process_set_out_line_func (FR_COMMAND (comm)->process,
 				      process_line__add,
 				      comm);
@@ -384,6 +535,305 @@ begin_func__delete (gpointer data)
 }
 
 
+/* -- filter -- */
+
+
+/* When the archive is modified without appending files, the compressed
+ * archive is filtered with a single pipe: decompress | tar | compress,
+ * instead of being decompressed to disk, modified and recompressed. */
+
+
+static void
+filter_data_clear (FrCommandTar *c_tar)
+{
+	g_free (c_tar->compressed_filename);
+	c_tar->compressed_filename = NULL;
+	g_free (c_tar->decompress_filter);
+	c_tar->decompress_filter = NULL;
+	g_free (c_tar->compress_filter);
+	c_tar->compress_filter = NULL;
+	g_free (c_tar->tar_filter);
+	c_tar->tar_filter = NULL;
+	g_free (c_tar->delete_list);
+	c_tar->delete_list = NULL;
+	if (c_tar->delete_names != NULL) {
+		g_string_free (c_tar->delete_names, TRUE);
+		c_tar->delete_names = NULL;
+	}
+	c_tar->filter_command = -1;
+}
+
+
+static const char *
+get_compression_level_option (FrArchive *archive)
+{
+	switch (archive->compression) {
+	case FR_COMPRESSION_VERY_FAST:
+		return "-1";
+	case FR_COMPRESSION_FAST:
+		return "-3";
+	case FR_COMPRESSION_NORMAL:
+		return "-6";
+	case FR_COMPRESSION_MAXIMUM:
+		return "-9";
+	}
+
+	return "-6";
+}
+
+
+/* gzip exits with status 2 after a warning, ignore it as gzip_continue_func
+ * does, the other stages of the pipe still fail the command. */
+static char *
+get_gzip_filter (const char *command)
+{
+	return g_strdup_printf ("(%s; s=$?; test $s -eq 2 && s=0; exit $s)", command);
+}
+
+
+static gboolean
+get_filter_commands (FrCommandTar  *c_tar,
+		     char         **decompress_filter,
+		     char         **compress_filter)
+{
+	FrArchive  *archive = FR_ARCHIVE (c_tar);
+	const char *program = NULL;
+	char       *command_line;
+
+	/* the exit status of every command in the pipe is required. */
+
+	if (! _g_program_is_in_path ("bash"))
+		return FALSE;
+
+	if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar"))
+		program = "gzip";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-bzip-compressed-tar"))
+		program = "bzip2";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lz4-compressed-tar"))
+		program = "lz4";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzip-compressed-tar"))
+		program = "lzip";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzma-compressed-tar"))
+		program = "lzma";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-xz-compressed-tar"))
+		program = "xz";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzop-compressed-tar"))
+		program = "lzop";
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-tarz")) {
+		if (! _g_program_is_in_path ("compress"))
+			return FALSE;
+		if (_g_program_is_in_path ("gzip"))
+			*decompress_filter = get_gzip_filter ("gzip -dc");
+		else
+			*decompress_filter = g_strdup ("uncompress -c");
+		*compress_filter = g_strdup ("compress -c");
+		return TRUE;
+	}
+
+	/* lrzip, rzip and 7z cannot be used in a pipe. */
+
+	if (program == NULL)
+		return FALSE;
+
+	command_line = get_compressor_command_line (program);
+	*decompress_filter = g_strdup_printf ("%s -dc", command_line);
+	*compress_filter = g_strdup_printf ("%s %s -c", command_line, get_compression_level_option (archive));
+	g_free (command_line);
+
+	if (strcmp (program, "gzip") == 0) {
+		char *filter;
+
+		filter = *decompress_filter;
+		*decompress_filter = get_gzip_filter (filter);
+		g_free (filter);
+
+		filter = *compress_filter;
+		*compress_filter = get_gzip_filter (filter);
+		g_free (filter);
+	}
+
+	return TRUE;
+}
+
+
+static char *
+get_filter_script (FrCommandTar *c_tar,
+		   gboolean      recompress)
+{
+	char *e_compressed_filename;
+	char *script;
+
+	e_compressed_filename = g_shell_quote (c_tar->compressed_filename);
+
+	if (recompress) {
+		char *new_filename;
+		char *e_new_filename;
+
+		new_filename = g_strconcat (c_tar->compressed_filename, ".new", NULL);
+		e_new_filename = g_shell_quote (new_filename);
+		script = g_strdup_printf ("%s < %s | %s | %s > %s && mv -f %s %s",
+					  c_tar->decompress_filter,
+					  e_compressed_filename,
+					  c_tar->tar_filter,
+					  c_tar->compress_filter,
+					  e_new_filename,
+					  e_new_filename,
+					  e_compressed_filename);
+
+		g_free (e_new_filename);
+		g_free (new_filename);
+	}
+	else {
+		char *e_uncomp_filename;
+
+		e_uncomp_filename = g_shell_quote (c_tar->uncomp_filename);
+		script = g_strdup_printf ("%s < %s | %s > %s && rm -f %s",
+					  c_tar->decompress_filter,
+					  e_compressed_filename,
+					  c_tar->tar_filter,
+					  e_uncomp_filename,
+					  e_compressed_filename);
+
+		g_free (e_uncomp_filename);
+	}
+
+	g_free (e_compressed_filename);
+
+	return script;
+}
+
+
+/* Adds @file_list to the names deleted by the last filter and saves them
+ * in its list file. */
+static gboolean
+delete_list_append (FrCommandTar *c_tar,
+		    GList        *file_list)
+{
+	gsize  len;
+	GList *scan;
+
+	len = c_tar->delete_names->len;
+	for (scan = file_list; scan; scan = scan->next)
+		g_string_append_len (c_tar->delete_names, scan->data, strlen (scan->data) + 1);
+
+	if (g_file_set_contents (c_tar->delete_list,
+				 c_tar->delete_names->str,
+				 c_tar->delete_names->len,
+				 NULL))
+	{
+		return TRUE;
+	}
+
+	g_string_truncate (c_tar->delete_names, len);
+
+	return FALSE;
+}
+
+
+static void
+fr_command_tar_delete_with_filter (FrCommand  *comm,
+				   const char *from_file,
+				   GList      *file_list)
+{
+	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
+	gboolean      append;
+	GString      *tar_filter;
+	char         *tar_command;
+	char         *e_arg;
+	char         *script;
+	GList        *scan;
+
+	/* a long list of files is deleted in chunks: the names of the
+	 * following chunks are added to the list file of the first one,
+	 * so the archive is filtered once. */
+
+	append = (from_file == NULL)
+		 && (c_tar->delete_list != NULL)
+		 && (c_tar->filter_command >= 0)
+		 && (c_tar->filter_command == fr_process_get_last_command (comm->process))
+		 && delete_list_append (c_tar, file_list);
+
+	if (! append) {
+		fr_process_begin_command (comm->process, "bash");
+		fr_process_set_begin_func (comm->process, begin_func__delete, comm);
+		fr_process_add_arg (comm->process, "-o");
+		fr_process_add_arg (comm->process, "pipefail");
+		fr_process_add_arg (comm->process, "-c");
+		fr_process_add_arg (comm->process, "");
+		fr_process_end_command (comm->process);
+
+		/* remember the command, if files are appended later the
+		 * filter will write the uncompressed archive. */
+		c_tar->filter_command = fr_process_get_last_command (comm->process);
+
+		g_free (c_tar->delete_list);
+		c_tar->delete_list = NULL;
+		if (c_tar->delete_names != NULL) {
+			g_string_free (c_tar->delete_names, TRUE);
+			c_tar->delete_names = NULL;
+		}
+
+		if (from_file == NULL) {
+			char *tmp_dir;
+			char *name;
+
+			tmp_dir = _g_path_remove_level (c_tar->compressed_filename);
+			name = g_strdup_printf ("delete-list-%d", c_tar->filter_command);
+			c_tar->delete_list = g_build_filename (tmp_dir, name, NULL);
+			c_tar->delete_names = g_string_new (NULL);
+			if (! delete_list_append (c_tar, file_list)) {
+				g_free (c_tar->delete_list);
+				c_tar->delete_list = NULL;
+				g_string_free (c_tar->delete_names, TRUE);
+				c_tar->delete_names = NULL;
+			}
+
+			g_free (name);
+			g_free (tmp_dir);
+		}
+	}
+
+	tar_command = get_tar_command ();
+	e_arg = g_shell_quote (tar_command);
+	tar_filter = g_string_new (e_arg);
+	g_free (e_arg);
+	g_free (tar_command);
+
+	g_string_append (tar_filter, " --force-local --no-wildcards --delete -f -");
+
+	if (from_file != NULL) {
+		e_arg = g_shell_quote (from_file);
+		g_string_append (tar_filter, " -T ");
+		g_string_append (tar_filter, e_arg);
+		g_free (e_arg);
+	}
+	else if (c_tar->delete_list != NULL) {
+		e_arg = g_shell_quote (c_tar->delete_list);
+		g_string_append (tar_filter, " --null -T ");
+		g_string_append (tar_filter, e_arg);
+		g_free (e_arg);
+	}
+
+	g_string_append (tar_filter, " --");
+
+	if ((from_file == NULL) && (c_tar->delete_list == NULL))
+		for (scan = file_list; scan; scan = scan->next) {
+			e_arg = g_shell_quote (scan->data);
+			g_string_append_c (tar_filter, ' ');
+			g_string_append (tar_filter, e_arg);
+			g_free (e_arg);
+		}
+
+	g_free (c_tar->tar_filter);
+	c_tar->tar_filter = g_string_free (tar_filter, FALSE);
+
+	script = get_filter_script (c_tar, TRUE);
+	fr_process_set_arg_at (comm->process, c_tar->filter_command, 4, script);
+
+	g_free (script);
+}
+
+
 static void
 fr_command_tar_delete (FrCommand  *comm,
 		       const char *from_file,
@@ -392,6 +842,11 @@ fr_command_tar_delete (FrCommand  *comm,
 	FrCommandTar *c_tar = FR_COMMAND_TAR (comm);
 	GList        *scan;
 
+	if (c_tar->compressed_filename != NULL) {
+		fr_command_tar_delete_with_filter (comm, from_file, file_list);
+		return;
+	}
+
 	fr_process_set_out_line_func (comm->process,
 				      process_line__delete,
 				      comm);
@@ -512,8 +967,14 @@ fr_command_tar_recompress (FrCommand *comm)
 	if (can_create_a_compressed_archive (comm))
 		return;
 
-	if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar")) {
-		fr_process_begin_command (comm->process, "gzip");
+	if (c_tar->compressed_filename != NULL) {
+		/* the archive was only filtered, it's still compressed. */
+
+		new_name = g_strdup (c_tar->compressed_filename);
+		filter_data_clear (c_tar);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar")) {
+		begin_compressor_command (comm, "gzip");
 		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
 		fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
 		switch (archive->compression) {
@@ -533,7 +994,7 @@ fr_command_tar_recompress (FrCommand *comm)
 		new_name = g_strconcat (c_tar->uncomp_filename, ".gz", NULL);
 	}
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-bzip-compressed-tar")) {
-		fr_process_begin_command (comm->process, "bzip2");
+		begin_compressor_command (comm, "bzip2");
 		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
 		switch (archive->compression) {
 		case FR_COMPRESSION_VERY_FAST:
@@ -600,7 +1061,7 @@ fr_command_tar_recompress (FrCommand *comm)
 		fr_process_end_command (comm->process);
 	}
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzip-compressed-tar")) {
-		fr_process_begin_command (comm->process, "lzip");
+		begin_compressor_command (comm, "lzip");
 		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
 		switch (archive->compression) {
 		case FR_COMPRESSION_VERY_FAST:
@@ -638,7 +1099,7 @@ fr_command_tar_recompress (FrCommand *comm)
 		new_name = g_strconcat (c_tar->uncomp_filename, ".lzma", NULL);
 	}
 	else if (_g_mime_type_matches (archive->mime_type, "application/x-xz-compressed-tar")) {
-		fr_process_begin_command (comm->process, "xz");
+		begin_compressor_command (comm, "xz");
 		fr_process_set_begin_func (comm->process, begin_func__recompress, comm);
 		switch (archive->compression) {
 		case FR_COMPRESSION_VERY_FAST:
@@ -896,6 +1357,160 @@ get_temp_name (FrCommandTar *c_tar,
 }
 
 
+static void
+add_uncompress_command (FrCommandTar *c_tar,
+			const char   *tmp_name,
+			const char   *tmp_dir)
+{
+	FrCommand *comm = FR_COMMAND (c_tar);
+	FrArchive *archive = FR_ARCHIVE (comm);
+
+	if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar")) {
+		begin_compressor_command (comm, "gzip");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-bzip-compressed-tar")) {
+		begin_compressor_command (comm, "bzip2");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-tarz")) {
+		if (_g_program_is_in_path ("gzip")) {
+			fr_process_begin_command (comm->process, "gzip");
+			fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
+		}
+		else
+			fr_process_begin_command (comm->process, "uncompress");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lrzip-compressed-tar")) {
+		fr_process_begin_command (comm->process, "lrzip");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lz4-compressed-tar")) {
+		fr_process_begin_command (comm->process, "lz4");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_add_arg (comm->process, c_tar->uncomp_filename);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzip-compressed-tar")) {
+		begin_compressor_command (comm, "lzip");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzma-compressed-tar")) {
+		fr_process_begin_command (comm->process, "lzma");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-xz-compressed-tar")) {
+		begin_compressor_command (comm, "xz");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, "-d");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-lzop-compressed-tar")) {
+		fr_process_begin_command (comm->process, "lzop");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-dfU");
+		fr_process_add_arg (comm->process, "--no-stdin");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-7z-compressed-tar")) {
+		FrCommandTar *comm_tar = (FrCommandTar*) comm;
+
+		fr_process_begin_command (comm->process, comm_tar->compress_command);
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "e");
+		fr_process_add_arg (comm->process, "-bd");
+		fr_process_add_arg (comm->process, "-y");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+
+		/* remove the compressed tar */
+
+		fr_process_begin_command (comm->process, "rm");
+		fr_process_add_arg (comm->process, "-f");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+	else if (_g_mime_type_matches (archive->mime_type, "application/x-rzip-compressed-tar")) {
+		fr_process_begin_command (comm->process, "rzip");
+		fr_process_set_working_dir (comm->process, tmp_dir);
+		fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
+		fr_process_add_arg (comm->process, "-df");
+		fr_process_add_arg (comm->process, tmp_name);
+		fr_process_end_command (comm->process);
+	}
+}
+
+
+static void
+uncompress_postponed_archive (FrCommandTar *c_tar)
+{
+	FrCommand *comm = FR_COMMAND (c_tar);
+
+	if (c_tar->compressed_filename == NULL)
+		return;
+
+	if (c_tar->filter_command >= 0) {
+		char *script;
+
+		/* let the last filter write the uncompressed archive */
+
+		script = get_filter_script (c_tar, FALSE);
+		fr_process_set_arg_at (comm->process, c_tar->filter_command, 4, script);
+		g_free (script);
+	}
+	else {
+		char *tmp_dir;
+
+		tmp_dir = _g_path_remove_level (c_tar->compressed_filename);
+		add_uncompress_command (c_tar, c_tar->compressed_filename, tmp_dir);
+		g_free (tmp_dir);
+	}
+
+	filter_data_clear (c_tar);
+}
+
+
 static void
 fr_command_tar_uncompress (FrCommand *comm)
 {
@@ -912,6 +1527,7 @@ fr_command_tar_uncompress (FrCommand *comm)
 		g_free (c_tar->uncomp_filename);
 		c_tar->uncomp_filename = NULL;
 	}
+	filter_data_clear (c_tar);
 
 	archive_exists = ! comm->creating_archive;
 
@@ -934,120 +1550,23 @@ fr_command_tar_uncompress (FrCommand *comm)
 	c_tar->uncomp_filename = get_uncompressed_name (c_tar, tmp_name);
 
 	if (archive_exists) {
-		if (_g_mime_type_matches (archive->mime_type, "application/x-compressed-tar")) {
-			fr_process_begin_command (comm->process, "gzip");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-bzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "bzip2");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-tarz")) {
-			if (_g_program_is_in_path ("gzip")) {
-				fr_process_begin_command (comm->process, "gzip");
-				fr_process_set_continue_func (comm->process, gzip_continue_func, comm);
-			}
-			else
-				fr_process_begin_command (comm->process, "uncompress");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-lrzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lrzip");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-lz4-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lz4");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_add_arg (comm->process, c_tar->uncomp_filename);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-lzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzip");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-lzma-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzma");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-xz-compressed-tar")) {
-			fr_process_begin_command (comm->process, "xz");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, "-d");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-lzop-compressed-tar")) {
-			fr_process_begin_command (comm->process, "lzop");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-dfU");
-			fr_process_add_arg (comm->process, "--no-stdin");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-7z-compressed-tar")) {
-			FrCommandTar *comm_tar = (FrCommandTar*) comm;
-
-			fr_process_begin_command (comm->process, comm_tar->compress_command);
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "e");
-			fr_process_add_arg (comm->process, "-bd");
-			fr_process_add_arg (comm->process, "-y");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-
-			/* remove the compressed tar */
-
-			fr_process_begin_command (comm->process, "rm");
-			fr_process_add_arg (comm->process, "-f");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
-		}
-		else if (_g_mime_type_matches (archive->mime_type, "application/x-rzip-compressed-tar")) {
-			fr_process_begin_command (comm->process, "rzip");
-			fr_process_set_working_dir (comm->process, tmp_dir);
-			fr_process_set_begin_func (comm->process, begin_func__uncompress, comm);
-			fr_process_add_arg (comm->process, "-df");
-			fr_process_add_arg (comm->process, tmp_name);
-			fr_process_end_command (comm->process);
+		char *decompress_filter = NULL;
+		char *compress_filter = NULL;
+
+		/* postpone the decompression: if no file is appended the
+		 * compressed archive can be filtered in a single pass. */
+
+		if (c_tar->name_modified
+		    && (strcmp (c_tar->uncomp_filename, tmp_name) != 0)
+		    && get_filter_commands (c_tar, &decompress_filter, &compress_filter))
+		{
+			c_tar->compressed_filename = g_strdup (tmp_name);
+			c_tar->decompress_filter = decompress_filter;
+			c_tar->compress_filter = compress_filter;
+			c_tar->filter_command = -1;
 		}
+		else
+			add_uncompress_command (c_tar, tmp_name, tmp_dir);
 	}
 
 	g_free (tmp_dir);
@@ -1242,6 +1761,8 @@ fr_command_tar_finalize (GObject *object)
 		self->compress_command = NULL;
 	}
 
+	filter_data_clear (self);
+
 	/* Chain up */
         if (G_OBJECT_CLASS (fr_command_tar_parent_class)->finalize)
 		G_OBJECT_CLASS (fr_command_tar_parent_class)->finalize (object);
@@ -1297,4 +1818,11 @@ fr_command_tar_init (FrCommandTar *self)
 
 	self->msg = NULL;
 	self->uncomp_filename = NULL;
+	self->compressed_filename = NULL;
+	self->decompress_filter = NULL;
+	self->compress_filter = NULL;
+	self->tar_filter = NULL;
+	self->delete_list = NULL;
+	self->delete_names = NULL;
+	self->filter_command = -1;
 }
@@ -46,7 +46,18 @@ struct _FrCommandTar
 	char      *uncomp_filename;
 	gboolean   name_modified;
 	char      *compress_command;
-	
+
+	char      *compressed_filename;  /* the compressed archive when the
+					  * decompression is postponed. */
+	char      *decompress_filter;
+	char      *compress_filter;
+	char      *tar_filter;
+	char      *delete_list;          /* the files deleted by the last
+					  * filter. */
+	GString   *delete_names;
+	int        filter_command;       /* the last command that filtered
+					  * the compressed archive. */
+
 	char      *msg;
 };
 
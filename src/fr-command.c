@@ -40,6 +40,7 @@
 
 #define MAX_CHUNK_LEN		 (NCARGS * 2 / 3) /* Max command line length */
 #define LIST_LENGTH_TO_USE_FILE	 10
+#define MAX_RUNNING_REMOTE_COPIES 8
 #ifndef NCARGS
   #define NCARGS		 _POSIX_ARG_MAX
 #endif
@@ -919,6 +920,8 @@ _fr_command_add (FrCommand      *self,
 	gboolean   error_occurred = FALSE;
 	int        new_file_list_length;
 	gboolean   use_tmp_subdirectory;
+	char      *list_dir = NULL;
+	int        last_add_command;
 
 	if (file_list == NULL)
 		return FALSE;
@@ -1058,8 +1061,7 @@ _fr_command_add (FrCommand      *self,
 	fr_archive_progress_set_total_files (archive, new_file_list_length);
 
 	if (archive->propListFromFile && (new_file_list_length > LIST_LENGTH_TO_USE_FILE)) {
-		char   *list_dir;
-		char   *list_filename;
+		char *list_filename;
 
 		if (! save_list_to_temp_file (new_file_list, &list_dir, &list_filename, error)) {
 			error_occurred = TRUE;
@@ -1071,19 +1073,9 @@ _fr_command_add (FrCommand      *self,
 					tmp_base_dir,
 					update,
 					follow_links);
-
-			/* remove the temp dir */
-
-			fr_process_begin_command (self->process, "rm");
-			fr_process_set_working_dir (self->process, g_get_tmp_dir());
-			fr_process_set_sticky (self->process, TRUE);
-			fr_process_add_arg (self->process, "-rf");
-			fr_process_add_arg (self->process, list_dir);
-			fr_process_end_command (self->process);
 		}
 
 		g_free (list_filename);
-		g_free (list_dir);
 	}
 	else {
 		GList *chunks = NULL;
@@ -1109,6 +1101,7 @@ _fr_command_add (FrCommand      *self,
 	}
 
 	_g_string_list_free (new_file_list);
+	last_add_command = fr_process_get_last_command (self->process);
 
 	if (! error_occurred) {
 		fr_command_recompress (self);
@@ -1133,18 +1126,35 @@ _fr_command_add (FrCommand      *self,
 			fr_process_end_command (self->process);
 		}
 
-		/* remove the archive dir */
+		/* the file list and the archive dir are not used after the
+		 * last add command, remove them while the archive is
+		 * recompressed and moved. */
+
+		if (list_dir != NULL) {
+			fr_process_begin_command (self->process, "rm");
+			fr_process_set_working_dir (self->process, g_get_tmp_dir ());
+			fr_process_set_sticky (self->process, TRUE);
+			fr_process_add_dependency (self->process, last_add_command);
+			fr_process_add_arg (self->process, "-rf");
+			fr_process_add_arg (self->process, list_dir);
+			fr_process_end_command (self->process);
+		}
 
 		if (base_dir_created) {
 			fr_process_begin_command (self->process, "rm");
 			fr_process_set_working_dir (self->process, g_get_tmp_dir ());
 			fr_process_set_sticky (self->process, TRUE);
+			if (list_dir != NULL)
+				fr_process_set_parallel (self->process, TRUE);
+			else
+				fr_process_add_dependency (self->process, last_add_command);
 			fr_process_add_arg (self->process, "-rf");
 			fr_process_add_arg_file (self->process, tmp_base_dir);
 			fr_process_end_command (self->process);
 		}
 	}
 
+	g_free (list_dir);
 	g_free (tmp_archive_filename);
 	g_free (archive_filename);
 	g_free (tmp_archive_dir);
@@ -1406,15 +1416,17 @@ copy_remote_files (FrCommand           *self,
 
 	fr_archive_action_started (FR_ARCHIVE (self), FR_ACTION_COPYING_FILES_FROM_REMOTE);
 
-	g_copy_files_async (sources,
-			    destinations,
-			    G_FILE_COPY_OVERWRITE,
-			    G_PRIORITY_DEFAULT,
-			    cancellable,
-			    copy_remote_files_progress,
-			    xfer_data,
-			    copy_remote_files_done,
-			    xfer_data);
+	g_copy_files_async_full (sources,
+				 destinations,
+				 G_FILE_COPY_OVERWRITE,
+				 G_PRIORITY_DEFAULT,
+				 MAX_RUNNING_REMOTE_COPIES,
+				 TRUE,
+				 cancellable,
+				 copy_remote_files_progress,
+				 xfer_data,
+				 copy_remote_files_done,
+				 xfer_data);
 
 	_g_file_list_free (sources);
 	_g_file_list_free (destinations);
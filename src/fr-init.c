@@ -22,6 +22,7 @@
 #include <config.h>
 #include <stdlib.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include "file-data.h"
 #include "file-utils.h"
 #include "glib-utils.h"
@@ -53,8 +54,10 @@
 #include "fr-init.h"
 #include "fr-process.h"
 #include "fr-window.h"
+#include "open-file-cache.h"
 #include "typedefs.h"
 #include "preferences.h"
+#include "volume-set.h"
 
 
 /* The capabilities are computed automatically in
@@ -214,6 +217,146 @@ migrate_options_directory (void)
 }
 
 
+/* -- ProgramsCache -- */
+
+
+/* The programs found in the path are saved in the user cache folder and
+ * reused while the PATH and the modification time of its folders don't
+ * change, that is until a program is installed or removed. */
+
+
+#define PROGRAMS_CACHE_GROUP "Programs"
+
+
+static char  *programs_cache_stamp = NULL;
+static guint  programs_cache_saved_size = 0;
+
+
+static char *
+get_programs_cache_stamp (void)
+{
+	GString     *stamp;
+	const char  *path;
+	char       **dirs;
+	int          i;
+
+	path = g_getenv ("PATH");
+	if (path == NULL)
+		path = "";
+
+	stamp = g_string_new (path);
+	dirs = g_strsplit (path, G_SEARCHPATH_SEPARATOR_S, -1);
+	for (i = 0; dirs[i] != NULL; i++) {
+		GStatBuf buf;
+
+		if ((dirs[i][0] == '\0') || (g_stat (dirs[i], &buf) != 0))
+			g_string_append (stamp, ";-");
+		else
+			g_string_append_printf (stamp, ";%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+	}
+
+	g_strfreev (dirs);
+
+	return g_string_free (stamp, FALSE);
+}
+
+
+static char *
+get_programs_cache_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "file-roller", "programs", NULL);
+}
+
+
+static void
+programs_cache_load (void)
+{
+	char      *filename;
+	GKeyFile  *key_file;
+	char      *stamp;
+	char     **programs;
+	int        i;
+
+	g_hash_table_remove_all (ProgramsCache);
+
+	g_free (programs_cache_stamp);
+	programs_cache_stamp = get_programs_cache_stamp ();
+	programs_cache_saved_size = 0;
+
+	filename = get_programs_cache_filename ();
+	key_file = g_key_file_new ();
+	if (! g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL)) {
+		g_key_file_free (key_file);
+		g_free (filename);
+		return;
+	}
+
+	stamp = g_key_file_get_string (key_file, "Cache", "Stamp", NULL);
+	if (g_strcmp0 (stamp, programs_cache_stamp) == 0) {
+		programs = g_key_file_get_keys (key_file, PROGRAMS_CACHE_GROUP, NULL, NULL);
+		for (i = 0; (programs != NULL) && (programs[i] != NULL); i++) {
+			char *path;
+
+			path = g_key_file_get_string (key_file, PROGRAMS_CACHE_GROUP, programs[i], NULL);
+			if ((path != NULL) && (path[0] == '\0')) {
+				g_free (path);
+				path = NULL;
+			}
+			g_hash_table_insert (ProgramsCache, g_strdup (programs[i]), path);
+		}
+		programs_cache_saved_size = g_hash_table_size (ProgramsCache);
+
+		g_strfreev (programs);
+	}
+
+	g_free (stamp);
+	g_key_file_free (key_file);
+	g_free (filename);
+}
+
+
+static void
+programs_cache_save (void)
+{
+	char           *filename;
+	char           *dirname;
+	GKeyFile       *key_file;
+	GHashTableIter  iter;
+	gpointer        key;
+	gpointer        value;
+	GFile          *file;
+
+	/* programs are only added to the cache, so the size tells whether
+	 * something changed. */
+
+	if ((programs_cache_stamp == NULL) || (g_hash_table_size (ProgramsCache) == programs_cache_saved_size))
+		return;
+
+	filename = get_programs_cache_filename ();
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0700) != 0) {
+		g_free (dirname);
+		g_free (filename);
+		return;
+	}
+
+	key_file = g_key_file_new ();
+	g_key_file_set_string (key_file, "Cache", "Stamp", programs_cache_stamp);
+	g_hash_table_iter_init (&iter, ProgramsCache);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_key_file_set_string (key_file, PROGRAMS_CACHE_GROUP, key, (value != NULL) ? value : "");
+
+	file = g_file_new_for_path (filename);
+	_g_key_file_save (key_file, file);
+	programs_cache_saved_size = g_hash_table_size (ProgramsCache);
+
+	g_object_unref (file);
+	g_key_file_free (key_file);
+	g_free (dirname);
+	g_free (filename);
+}
+
+
 /* -- FrRegisteredArchive -- */
 
 
@@ -242,7 +385,6 @@ fr_registered_archive_new (GType command_type)
 
 		cap = g_new0 (FrMimeTypeCap, 1);
 		cap->mime_type = mime_type;
-		cap->current_capabilities = fr_archive_get_capabilities (archive, mime_type, TRUE);
 		cap->potential_capabilities = fr_archive_get_capabilities (archive, mime_type, FALSE);
 		g_ptr_array_add (reg_com->caps, cap);
 
@@ -277,6 +419,27 @@ fr_registered_archive_unref (FrRegisteredArchive *reg_com)
 }
 
 
+/* The current capabilities require to search the programs in the path, so
+ * they are computed only when asked for a mime type. */
+static FrArchiveCaps
+fr_registered_archive_probe (FrRegisteredArchive *reg_com,
+			     FrMimeTypeCap       *cap)
+{
+	FrArchive *archive;
+
+	if (cap->probed)
+		return cap->current_capabilities;
+
+	archive = (FrArchive*) g_object_new (reg_com->type, NULL);
+	cap->current_capabilities = fr_archive_get_capabilities (archive, cap->mime_type, TRUE);
+	cap->probed = TRUE;
+
+	g_object_unref (archive);
+
+	return cap->current_capabilities;
+}
+
+
 static FrArchiveCaps
 fr_registered_archive_get_capabilities (FrRegisteredArchive *reg_com,
 				        const char          *mime_type)
@@ -288,7 +451,7 @@ fr_registered_archive_get_capabilities (FrRegisteredArchive *reg_com,
 
 		cap = g_ptr_array_index (reg_com->caps, i);
 		if (strcmp (mime_type, cap->mime_type) == 0)
-			return cap->current_capabilities;
+			return fr_registered_archive_probe (reg_com, cap);
 	}
 
 	return FR_ARCHIVE_CAN_DO_NOTHING;
@@ -407,6 +570,47 @@ get_archive_type_from_mime_type (const char    *mime_type,
 }
 
 
+/* Remote files are read and written as streams by the archives that don't
+ * use an external command, the commands need a local copy of the whole
+ * file instead.  The volumes of a split archive are joined by the stream
+ * reader as well.  The capabilities are asked to an archive for @file
+ * because they can depend on the file location and name. */
+GType
+get_archive_type_for_file (GFile         *file,
+			   const char    *mime_type,
+			   FrArchiveCaps  requested_capabilities)
+{
+	int i;
+
+	if (mime_type == NULL)
+		return 0;
+
+	if ((file != NULL) && (! g_file_is_native (file) || volume_set_is_split_volume (file))) {
+		for (i = 0; i < Registered_Archives->len; i++) {
+			FrRegisteredArchive *reg_archive;
+			FrArchive           *archive;
+			FrArchiveCaps        capabilities;
+
+			reg_archive = g_ptr_array_index (Registered_Archives, i);
+			if (g_type_is_a (reg_archive->type, FR_TYPE_COMMAND))
+				continue;
+
+			archive = g_object_new (reg_archive->type,
+						"file", file,
+						"mime-type", mime_type,
+						NULL);
+			capabilities = fr_archive_get_capabilities (archive, mime_type, TRUE);
+			g_object_unref (archive);
+
+			if (((capabilities ^ requested_capabilities) & requested_capabilities) == 0)
+				return reg_archive->type;
+		}
+	}
+
+	return get_archive_type_from_mime_type (mime_type, requested_capabilities);
+}
+
+
 GType
 get_preferred_archive_for_mime_type (const char    *mime_type,
 				     FrArchiveCaps  requested_capabilities)
@@ -429,29 +633,29 @@ get_preferred_archive_for_mime_type (const char    *mime_type,
 }
 
 
+static gboolean supported_archive_types_computed = FALSE;
+
+
 void
 update_registered_archives_capabilities (void)
 {
 	int i;
 
-	g_hash_table_remove_all (ProgramsCache);
+	programs_cache_save ();
+	programs_cache_load ();
 
 	for (i = 0; i < Registered_Archives->len; i++) {
 		FrRegisteredArchive *reg_com;
-		FrArchive           *archive;
 		int                  j;
 
 		reg_com = g_ptr_array_index (Registered_Archives, i);
-		archive = g_object_new (reg_com->type, NULL);
 		for (j = 0; j < reg_com->caps->len; j++) {
 			FrMimeTypeCap *cap = g_ptr_array_index (reg_com->caps, j);
-
-			cap->current_capabilities = fr_archive_get_capabilities (archive, cap->mime_type, TRUE);
-			cap->potential_capabilities = fr_archive_get_capabilities (archive, cap->mime_type, FALSE);
+			cap->probed = FALSE;
 		}
-
-		g_object_unref (archive);
 	}
+
+	supported_archive_types_computed = FALSE;
 }
 
 
@@ -574,12 +778,22 @@ sort_mime_types_by_extension (int *a)
 }
 
 
-static void
+/* Computes the capabilities of mime_type_desc and the open_type, save_type,
+ * single_file_save_type and create_type arrays.  This probes all the
+ * registered archives, so it's done only when they are needed. */
+void
 compute_supported_archive_types (void)
 {
 	int sf_i = 0, s_i = 0, o_i = 0, c_i = 0;
 	int i;
 
+	if (supported_archive_types_computed)
+		return;
+	supported_archive_types_computed = TRUE;
+
+	for (i = 0; mime_type_desc[i].mime_type != NULL; i++)
+		mime_type_desc[i].capabilities = 0;
+
 	for (i = 0; i < Registered_Archives->len; i++) {
 		FrRegisteredArchive *reg_com;
 		int                  j;
@@ -590,6 +804,7 @@ compute_supported_archive_types (void)
 			int            idx;
 
 			cap = g_ptr_array_index (reg_com->caps, j);
+			fr_registered_archive_probe (reg_com, cap);
 			idx = get_mime_type_index (cap->mime_type);
 			if (idx < 0) {
 				g_warning ("mime type not recognized: %s", cap->mime_type);
@@ -629,14 +844,14 @@ initialize_data (void)
 	ProgramsCache = g_hash_table_new_full (g_str_hash,
 					       g_str_equal,
 					       g_free,
-					       NULL);
+					       g_free);
 
 	gtk_icon_theme_append_search_path (gtk_icon_theme_get_default (),
 					   PKG_DATA_DIR G_DIR_SEPARATOR_S "icons");
 
 	migrate_options_directory ();
+	programs_cache_load ();
 	register_archives ();
-	compute_supported_archive_types ();
 }
 
 
@@ -665,6 +880,9 @@ release_data (void)
 	if (! initialized)
 		return;
 
+	programs_cache_save ();
+	open_file_cache_clear ();
+
 	while (CommandList != NULL) {
 		CommandData *cdata = CommandList->data;
 		command_done (cdata);
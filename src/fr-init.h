@@ -59,9 +59,13 @@ extern int                    create_type[];           /* File types that can be
 
 GType        get_archive_type_from_mime_type         (const char    *mime_type,
 						      FrArchiveCaps  requested_capabilities);
+GType        get_archive_type_for_file               (GFile         *file,
+						      const char    *mime_type,
+						      FrArchiveCaps  requested_capabilities);
 GType        get_preferred_archive_for_mime_type     (const char    *mime_type,
 						      FrArchiveCaps  requested_capabilities);
 void         update_registered_archives_capabilities (void);
+void         compute_supported_archive_types         (void);
 const char * _g_mime_type_get_from_extension         (const char    *ext);
 const char * _g_mime_type_get_from_filename          (GFile         *file);
 const char * get_archive_filename_extension          (const char    *uri);
@@ -0,0 +1,645 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib/gi18n.h>
+#include "file-utils.h"
+#include "fr-archive.h"
+#include "fr-command.h"
+#include "fr-error.h"
+#include "fr-job.h"
+#include "fr-marshal.h"
+#include "fr-window.h"
+#include "gio-utils.h"
+#include "glib-utils.h"
+#include "preferences.h"
+
+
+typedef enum {
+	FR_JOB_TYPE_EXTRACT,
+	FR_JOB_TYPE_ADD
+} FrJobType;
+
+
+enum {
+	PROGRESS,
+	READY,
+	LAST_SIGNAL
+};
+
+
+static guint fr_job_signals[LAST_SIGNAL] = { 0 };
+
+
+G_DEFINE_TYPE (FrJob, fr_job, G_TYPE_OBJECT)
+
+
+struct _FrJobPrivate {
+	FrJobType     type;
+	GFile        *file;
+	GFile        *destination;
+	GList        *file_list;
+	FrArchive    *archive;
+	GCancellable *cancellable;
+	char         *details;
+	FrAction      action;
+	FrManifest   *manifest;
+	GtkWidget    *window;
+};
+
+
+static void
+fr_job_finalize (GObject *object)
+{
+	FrJob *job = FR_JOB (object);
+
+	if (job->priv->archive != NULL) {
+		g_signal_handlers_disconnect_by_data (job->priv->archive, job);
+		fr_archive_set_manifest (job->priv->archive, NULL);
+		g_object_unref (job->priv->archive);
+	}
+	if (job->priv->window != NULL)
+		g_signal_handlers_disconnect_by_data (job->priv->window, job);
+	_g_object_unref (job->priv->file);
+	_g_object_unref (job->priv->destination);
+	_g_object_list_unref (job->priv->file_list);
+	g_object_unref (job->priv->cancellable);
+	g_free (job->priv->details);
+
+	G_OBJECT_CLASS (fr_job_parent_class)->finalize (object);
+}
+
+
+static void
+fr_job_class_init (FrJobClass *klass)
+{
+	GObjectClass *gobject_class;
+
+	g_type_class_add_private (klass, sizeof (FrJobPrivate));
+
+	fr_job_signals[PROGRESS] =
+		g_signal_new ("progress",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (FrJobClass, progress),
+			      NULL, NULL,
+			      fr_marshal_VOID__DOUBLE_STRING,
+			      G_TYPE_NONE, 2,
+			      G_TYPE_DOUBLE,
+			      G_TYPE_STRING);
+	fr_job_signals[READY] =
+		g_signal_new ("ready",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (FrJobClass, ready),
+			      NULL, NULL,
+			      fr_marshal_VOID__POINTER,
+			      G_TYPE_NONE, 1,
+			      G_TYPE_POINTER);
+
+	gobject_class = G_OBJECT_CLASS (klass);
+	gobject_class->finalize = fr_job_finalize;
+}
+
+
+static void
+fr_job_init (FrJob *job)
+{
+	job->priv = G_TYPE_INSTANCE_GET_PRIVATE (job, FR_TYPE_JOB, FrJobPrivate);
+	job->priv->cancellable = g_cancellable_new ();
+	job->priv->action = FR_ACTION_NONE;
+}
+
+
+FrJob *
+fr_job_new (void)
+{
+	return (FrJob *) g_object_new (FR_TYPE_JOB, NULL);
+}
+
+
+static char *
+get_action_description (FrAction  action,
+			GFile    *file)
+{
+	char *basename;
+	char *message;
+
+	basename = _g_file_get_display_basename (file);
+
+	message = NULL;
+	switch (action) {
+	case FR_ACTION_LOADING_ARCHIVE:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Loading \"%s\""), basename);
+		break;
+	case FR_ACTION_LISTING_CONTENT:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Reading \"%s\""), basename);
+		break;
+	case FR_ACTION_GETTING_FILE_LIST:
+		message = g_strdup (_("Getting the file list"));
+		break;
+	case FR_ACTION_COPYING_FILES_FROM_REMOTE:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Copying the files to add to \"%s\""), basename);
+		break;
+	case FR_ACTION_ADDING_FILES:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Adding the files to \"%s\""), basename);
+		break;
+	case FR_ACTION_EXTRACTING_FILES:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Extracting the files from \"%s\""), basename);
+		break;
+	case FR_ACTION_COPYING_FILES_TO_REMOTE:
+		message = g_strdup (_("Copying the extracted files to the destination"));
+		break;
+	case FR_ACTION_CREATING_NEW_ARCHIVE:
+	case FR_ACTION_CREATING_ARCHIVE:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Creating \"%s\""), basename);
+		break;
+	case FR_ACTION_SAVING_REMOTE_ARCHIVE:
+		/* Translators: %s is a filename */
+		message = g_strdup_printf (_("Saving \"%s\""), basename);
+		break;
+	default:
+		break;
+	}
+
+	g_free (basename);
+
+	return message;
+}
+
+
+static void
+fr_job_set_action (FrJob    *job,
+		   FrAction  action)
+{
+	char *details;
+
+	job->priv->action = action;
+
+	details = get_action_description (action, job->priv->file);
+	if (details == NULL)
+		return;
+
+	g_free (job->priv->details);
+	job->priv->details = details;
+
+	g_signal_emit (job, fr_job_signals[PROGRESS], 0, -1.0, job->priv->details);
+}
+
+
+static void
+archive_start_cb (FrArchive *archive,
+		  FrAction   action,
+		  FrJob     *job)
+{
+	fr_job_set_action (job, action);
+}
+
+
+static void
+archive_progress_cb (FrArchive *archive,
+		     double     fraction,
+		     FrJob     *job)
+{
+	g_signal_emit (job, fr_job_signals[PROGRESS], 0, fraction, job->priv->details);
+}
+
+
+static void
+fr_job_complete (FrJob  *job,
+		 GError *error)
+{
+	if ((error != NULL) && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		GError *stopped_error;
+
+		stopped_error = g_error_new_literal (FR_ERROR, FR_ERROR_STOPPED, "");
+		g_signal_emit (job, fr_job_signals[READY], 0, stopped_error);
+		g_error_free (stopped_error);
+	}
+	else
+		g_signal_emit (job, fr_job_signals[READY], 0, error);
+
+	g_object_unref (job);
+}
+
+
+static void
+fr_job_set_archive (FrJob     *job,
+		    FrArchive *archive)
+{
+	job->priv->archive = archive;
+	fr_archive_set_manifest (archive, job->priv->manifest);
+	g_signal_connect (archive, "start", G_CALLBACK (archive_start_cb), job);
+	g_signal_connect (archive, "progress", G_CALLBACK (archive_progress_cb), job);
+}
+
+
+/* -- window -- */
+
+
+/* A window is used when the user must be asked for the password or
+ * whether to overwrite the existing files, as done for the other
+ * archives.  The manifest cannot be filled by the window, in that case
+ * the job fails. */
+
+
+static void
+window_progress_cb (FrWindow   *window,
+		    double      fraction,
+		    const char *details,
+		    FrJob      *job)
+{
+	g_signal_emit (job, fr_job_signals[PROGRESS], 0, fraction, details);
+}
+
+
+static void
+window_ready_cb (FrWindow *window,
+		 GError   *error,
+		 FrJob    *job)
+{
+	g_signal_handlers_disconnect_by_data (window, job);
+	job->priv->window = NULL;
+	fr_job_complete (job, error);
+}
+
+
+static void
+fr_job_continue_in_window (FrJob  *job,
+			   GError *error)
+{
+	FrWindow *window;
+
+	if (job->priv->manifest != NULL) {
+		fr_job_complete (job, error);
+		return;
+	}
+
+	if (job->priv->archive != NULL) {
+		g_signal_handlers_disconnect_by_data (job->priv->archive, job);
+		fr_archive_set_manifest (job->priv->archive, NULL);
+		g_object_unref (job->priv->archive);
+		job->priv->archive = NULL;
+	}
+
+	job->priv->window = fr_window_new ();
+	window = FR_WINDOW (job->priv->window);
+	fr_window_use_progress_dialog (window, FALSE);
+	g_signal_connect (window, "progress", G_CALLBACK (window_progress_cb), job);
+	g_signal_connect (window, "ready", G_CALLBACK (window_ready_cb), job);
+
+	if (job->priv->type == FR_JOB_TYPE_ADD) {
+		fr_window_batch_new (window, _("Compress"));
+		fr_window_batch__add_files (window, job->priv->file, job->priv->file_list);
+	}
+	else {
+		fr_window_batch_new (window, C_("Window title", "Extract archive"));
+		if (job->priv->destination != NULL) {
+			fr_window_set_default_dir (window, job->priv->destination, TRUE);
+			fr_window_batch__extract (window, job->priv->file, job->priv->destination, FALSE);
+		}
+		else
+			fr_window_batch__extract_here (window, job->priv->file, FALSE);
+	}
+	fr_window_batch_append_action (window, FR_BATCH_ACTION_QUIT, NULL, NULL);
+	fr_window_batch_start (window);
+}
+
+
+static void
+fr_job_operation_failed (FrJob  *job,
+			 GError *error)
+{
+	if (g_error_matches (error, FR_ERROR, FR_ERROR_ASK_PASSWORD))
+		fr_job_continue_in_window (job, error);
+	else
+		fr_job_complete (job, error);
+}
+
+
+/* -- operation -- */
+
+
+static void
+operation_ready_cb (GObject      *source_object,
+		    GAsyncResult *result,
+		    gpointer      user_data)
+{
+	FrJob  *job = user_data;
+	GError *error = NULL;
+
+	if (! fr_archive_operation_finish (FR_ARCHIVE (source_object), result, &error)) {
+		fr_job_operation_failed (job, error);
+		g_error_free (error);
+		return;
+	}
+
+	fr_job_complete (job, NULL);
+}
+
+
+static void
+fr_job_start_operation (FrJob *job)
+{
+	FrArchive *archive = job->priv->archive;
+
+	/* the files are hashed while they are read or written, which the
+	 * external commands don't allow. */
+
+	if ((job->priv->manifest != NULL) && FR_IS_COMMAND (archive)) {
+		GError *error;
+
+		error = g_error_new_literal (FR_ERROR, FR_ERROR_GENERIC, _("A manifest cannot be created for this archive type."));
+		fr_job_complete (job, error);
+		g_error_free (error);
+		return;
+	}
+
+	if (job->priv->type == FR_JOB_TYPE_ADD) {
+		GSettings     *settings;
+		FrCompression  compression;
+
+		settings = g_settings_new (FILE_ROLLER_SCHEMA_GENERAL);
+		compression = g_settings_get_enum (settings, PREF_GENERAL_COMPRESSION_LEVEL);
+		g_object_unref (settings);
+
+		fr_archive_add_dropped_items (archive,
+					      job->priv->file_list,
+					      "/",
+					      NULL,
+					      FALSE,
+					      compression,
+					      0,
+					      job->priv->cancellable,
+					      operation_ready_cb,
+					      job);
+	}
+	else if (job->priv->destination == NULL)
+		fr_archive_extract_here (archive,
+					 FALSE,
+					 FALSE,
+					 FALSE,
+					 NULL,
+					 job->priv->cancellable,
+					 operation_ready_cb,
+					 job);
+	else
+		fr_archive_extract (archive,
+				    NULL,
+				    job->priv->destination,
+				    NULL,
+				    FALSE,
+				    FALSE,
+				    FALSE,
+				    NULL,
+				    job->priv->cancellable,
+				    operation_ready_cb,
+				    job);
+}
+
+
+static void
+existing_files_ready_cb (GList    *files,
+			 GError   *error,
+			 gpointer  user_data)
+{
+	FrJob *job = user_data;
+
+	if (g_cancellable_is_cancelled (job->priv->cancellable)) {
+		GError *cancelled_error;
+
+		cancelled_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED, "");
+		fr_job_complete (job, cancelled_error);
+		g_error_free (cancelled_error);
+		return;
+	}
+
+	if (files != NULL) {
+		GError *exists_error;
+
+		exists_error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_EXISTS, _("Some files already exist in the destination folder."));
+		fr_job_continue_in_window (job, exists_error);
+		g_error_free (exists_error);
+		return;
+	}
+
+	fr_job_start_operation (job);
+}
+
+
+/* Continues in a window if the archive is encrypted or if some files would
+ * be overwritten. */
+static void
+fr_job_check_archive (FrJob *job)
+{
+	FrArchive *archive = job->priv->archive;
+	GList     *file_list;
+	int        i;
+
+	for (i = 0; i < archive->files->len; i++) {
+		FileData *fdata = g_ptr_array_index (archive->files, i);
+
+		if (fdata->encrypted) {
+			GError *error;
+
+			error = g_error_new_literal (FR_ERROR, FR_ERROR_ASK_PASSWORD, _("The archive is encrypted, a password is required."));
+			fr_job_continue_in_window (job, error);
+			g_error_free (error);
+			return;
+		}
+	}
+
+	if ((job->priv->type != FR_JOB_TYPE_EXTRACT)
+	    || (job->priv->destination == NULL)
+	    || ! _g_file_query_is_dir (job->priv->destination))
+	{
+		fr_job_start_operation (job);
+		return;
+	}
+
+	file_list = NULL;
+	for (i = 0; i < archive->files->len; i++) {
+		FileData   *fdata = g_ptr_array_index (archive->files, i);
+		const char *base_name;
+
+		if (fdata->dir)
+			continue;
+
+		base_name = _g_path_get_relative_basename_safe (fdata->original_path, NULL, FALSE);
+		if (base_name != NULL)
+			file_list = g_list_prepend (file_list, g_file_get_child (job->priv->destination, base_name));
+	}
+
+	_g_file_list_query_info_async (file_list,
+				       FILE_LIST_NO_FOLLOW_LINKS,
+				       "",
+				       job->priv->cancellable,
+				       NULL,
+				       NULL,
+				       existing_files_ready_cb,
+				       job);
+
+	_g_object_list_unref (file_list);
+}
+
+
+static void
+list_ready_cb (GObject      *source_object,
+	       GAsyncResult *result,
+	       gpointer      user_data)
+{
+	FrJob  *job = user_data;
+	GError *error = NULL;
+
+	if (! fr_archive_operation_finish (FR_ARCHIVE (source_object), result, &error)) {
+		fr_job_operation_failed (job, error);
+		g_error_free (error);
+		return;
+	}
+
+	fr_job_check_archive (job);
+}
+
+
+static void
+open_ready_cb (GObject      *source_object,
+	       GAsyncResult *result,
+	       gpointer      user_data)
+{
+	FrJob     *job = user_data;
+	FrArchive *archive;
+	GError    *error = NULL;
+
+	archive = fr_archive_open_finish (G_FILE (source_object), result, &error);
+	if (archive == NULL) {
+		fr_job_complete (job, error);
+		g_error_free (error);
+		return;
+	}
+
+	fr_job_set_archive (job, archive);
+	fr_archive_list (archive,
+			 NULL,
+			 job->priv->cancellable,
+			 list_ready_cb,
+			 job);
+}
+
+
+static void
+fr_job_start (FrJob *job)
+{
+	g_object_ref (job);
+
+	if ((job->priv->type == FR_JOB_TYPE_ADD) && ! g_file_query_exists (job->priv->file, job->priv->cancellable)) {
+		FrArchive *archive;
+
+		archive = fr_archive_create (job->priv->file, NULL);
+		if (archive == NULL) {
+			GError *error;
+
+			error = g_error_new_literal (FR_ERROR, FR_ERROR_GENERIC, _("Archive type not supported."));
+			fr_job_complete (job, error);
+			g_error_free (error);
+			return;
+		}
+
+		fr_job_set_archive (job, archive);
+		fr_job_start_operation (job);
+		return;
+	}
+
+	fr_job_set_action (job, FR_ACTION_LOADING_ARCHIVE);
+	fr_archive_open (job->priv->file,
+			 job->priv->cancellable,
+			 open_ready_cb,
+			 job);
+}
+
+
+/* Saves the size, time and digest of the extracted or added files in
+ * @manifest, which must be valid until "ready" is emitted.  The job fails
+ * for the archive types handled by an external command. */
+void
+fr_job_set_manifest (FrJob      *job,
+		     FrManifest *manifest)
+{
+	job->priv->manifest = manifest;
+}
+
+
+/* Extracts all the files of @archive in @destination, or in a new folder
+ * next to the archive if @destination is NULL.  If the archive is
+ * encrypted or some files already exist in @destination the extraction
+ * continues in a window, unless a manifest is set. */
+void
+fr_job_extract (FrJob *job,
+		GFile *archive,
+		GFile *destination)
+{
+	g_return_if_fail (job->priv->file == NULL);
+
+	job->priv->type = FR_JOB_TYPE_EXTRACT;
+	job->priv->file = g_object_ref (archive);
+	job->priv->destination = _g_object_ref (destination);
+	fr_job_start (job);
+}
+
+
+/* Adds @file_list to @archive, creating the archive if it doesn't exist. */
+void
+fr_job_add_files (FrJob *job,
+		  GFile *archive,
+		  GList *file_list)
+{
+	g_return_if_fail (job->priv->file == NULL);
+
+	job->priv->type = FR_JOB_TYPE_ADD;
+	job->priv->file = g_object_ref (archive);
+	job->priv->file_list = _g_object_list_ref (file_list);
+	fr_job_start (job);
+}
+
+
+/* Returns the operation the archive is performing, in the window if the
+ * job continued there. */
+FrAction
+fr_job_get_action (FrJob *job)
+{
+	if (job->priv->window != NULL)
+		return fr_window_get_archive_action (FR_WINDOW (job->priv->window));
+	return job->priv->action;
+}
+
+
+void
+fr_job_cancel (FrJob *job)
+{
+	g_cancellable_cancel (job->priv->cancellable);
+	if (job->priv->window != NULL)
+		fr_window_stop (FR_WINDOW (job->priv->window));
+}
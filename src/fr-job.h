@@ -0,0 +1,76 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FR_JOB_H
+#define FR_JOB_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "fr-manifest.h"
+
+/* FrJob extracts or adds files without a window, unless a password is
+ * required or some files would be overwritten, the progress is reported
+ * with the "progress" signal and the result with the "ready" signal, as
+ * done by FrWindow in batch mode.  The job keeps a reference to itself
+ * until "ready" is emitted. */
+
+#define FR_TYPE_JOB            (fr_job_get_type ())
+#define FR_JOB(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), FR_TYPE_JOB, FrJob))
+#define FR_JOB_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), FR_TYPE_JOB, FrJobClass))
+#define FR_IS_JOB(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), FR_TYPE_JOB))
+#define FR_IS_JOB_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), FR_TYPE_JOB))
+#define FR_JOB_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), FR_TYPE_JOB, FrJobClass))
+
+typedef struct _FrJob        FrJob;
+typedef struct _FrJobClass   FrJobClass;
+typedef struct _FrJobPrivate FrJobPrivate;
+
+struct _FrJob {
+	GObject       __parent;
+	FrJobPrivate *priv;
+};
+
+struct _FrJobClass {
+	GObjectClass __parent_class;
+
+	/* -- Signals -- */
+
+	void (* progress) (FrJob      *job,
+			   double      fraction,
+			   const char *details);
+	void (* ready)    (FrJob      *job,
+			   GError     *error);
+};
+
+GType       fr_job_get_type     (void);
+FrJob *     fr_job_new          (void);
+void        fr_job_set_manifest (FrJob        *job,
+				 FrManifest   *manifest);
+void        fr_job_extract      (FrJob        *job,
+				 GFile        *archive,
+				 GFile        *destination);
+void        fr_job_add_files    (FrJob        *job,
+				 GFile        *archive,
+				 GList        *file_list);
+FrAction    fr_job_get_action   (FrJob        *job);
+void        fr_job_cancel       (FrJob        *job);
+
+#endif /* FR_JOB_H */
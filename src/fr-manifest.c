@@ -0,0 +1,525 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include "fr-error.h"
+#include "fr-manifest.h"
+#include "glib-utils.h"
+
+
+#define MANIFEST_HEADER "# file-roller manifest: sha256, size, mtime, path\n"
+#define MAX_VERIFY_THREADS 8
+#define VERIFY_BUFFER_SIZE (64 * 1024)
+
+
+typedef struct {
+	char    *path;
+	goffset  size;
+	gint64   mtime;
+	char    *digest;
+} ManifestEntry;
+
+
+struct _FrManifest {
+	GFile     *root;
+	GPtrArray *entries;            /* ManifestEntry array */
+	GMutex     mutex;
+};
+
+
+static void
+manifest_entry_free (ManifestEntry *entry)
+{
+	g_free (entry->path);
+	g_free (entry->digest);
+	g_free (entry);
+}
+
+
+static int
+manifest_entry_compare (gconstpointer a,
+			gconstpointer b)
+{
+	const ManifestEntry *entry_a = * (ManifestEntry **) a;
+	const ManifestEntry *entry_b = * (ManifestEntry **) b;
+
+	return strcmp (entry_a->path, entry_b->path);
+}
+
+
+/* @root is used to make relative the paths of the files added with
+ * fr_manifest_add_file, can be NULL. */
+FrManifest *
+fr_manifest_new (GFile *root)
+{
+	FrManifest *manifest;
+
+	manifest = g_new0 (FrManifest, 1);
+	manifest->root = _g_object_ref (root);
+	manifest->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) manifest_entry_free);
+	g_mutex_init (&manifest->mutex);
+
+	return manifest;
+}
+
+
+void
+fr_manifest_free (FrManifest *manifest)
+{
+	if (manifest == NULL)
+		return;
+
+	g_mutex_clear (&manifest->mutex);
+	g_ptr_array_unref (manifest->entries);
+	_g_object_unref (manifest->root);
+	g_free (manifest);
+}
+
+
+void
+fr_manifest_add (FrManifest *manifest,
+		 const char *path,
+		 goffset     size,
+		 gint64      mtime,
+		 const char *digest)
+{
+	ManifestEntry *entry;
+
+	g_return_if_fail (path != NULL);
+	g_return_if_fail (digest != NULL);
+
+	entry = g_new0 (ManifestEntry, 1);
+	entry->path = g_strdup (path);
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->digest = g_strdup (digest);
+
+	g_mutex_lock (&manifest->mutex);
+	g_ptr_array_add (manifest->entries, entry);
+	g_mutex_unlock (&manifest->mutex);
+}
+
+
+/* Files outside the manifest root are saved with the absolute path. */
+void
+fr_manifest_add_file (FrManifest *manifest,
+		      GFile      *file,
+		      goffset     size,
+		      gint64      mtime,
+		      const char *digest)
+{
+	char *path;
+
+	path = NULL;
+	if (manifest->root != NULL)
+		path = g_file_get_relative_path (manifest->root, file);
+
+	if (path == NULL)
+		path = g_file_get_path (file);
+	if (path == NULL)
+		path = g_file_get_uri (file);
+	fr_manifest_add (manifest, path, size, mtime, digest);
+
+	g_free (path);
+}
+
+
+/* -- save / load -- */
+
+
+/* the path is the last field, only the characters that would break the
+ * line format are escaped. */
+static void
+_g_string_append_escaped_path (GString    *buffer,
+			       const char *path)
+{
+	const char *p;
+
+	for (p = path; *p != '\0'; p++) {
+		switch (*p) {
+		case '\\':
+			g_string_append (buffer, "\\\\");
+			break;
+		case '\n':
+			g_string_append (buffer, "\\n");
+			break;
+		case '\r':
+			g_string_append (buffer, "\\r");
+			break;
+		case '\t':
+			g_string_append (buffer, "\\t");
+			break;
+		default:
+			g_string_append_c (buffer, *p);
+			break;
+		}
+	}
+}
+
+
+gboolean
+fr_manifest_save (FrManifest    *manifest,
+		  GFile         *file,
+		  GCancellable  *cancellable,
+		  GError       **error)
+{
+	GString  *buffer;
+	int       i;
+	gboolean  success;
+
+	/* an empty manifest would verify any folder. */
+
+	if (manifest->entries->len == 0) {
+		g_set_error_literal (error,
+				     FR_ERROR,
+				     FR_ERROR_GENERIC,
+				     _("No file was added to the manifest"));
+		return FALSE;
+	}
+
+	buffer = g_string_new (MANIFEST_HEADER);
+
+	g_mutex_lock (&manifest->mutex);
+	g_ptr_array_sort (manifest->entries, manifest_entry_compare);
+	for (i = 0; i < manifest->entries->len; i++) {
+		ManifestEntry *entry = g_ptr_array_index (manifest->entries, i);
+
+		g_string_append_printf (buffer,
+					"%s\t%" G_GOFFSET_FORMAT "\t%" G_GINT64_FORMAT "\t",
+					entry->digest,
+					entry->size,
+					entry->mtime);
+		_g_string_append_escaped_path (buffer, entry->path);
+		g_string_append_c (buffer, '\n');
+	}
+	g_mutex_unlock (&manifest->mutex);
+
+	success = g_file_replace_contents (file,
+					   buffer->str,
+					   buffer->len,
+					   NULL,
+					   FALSE,
+					   G_FILE_CREATE_REPLACE_DESTINATION,
+					   NULL,
+					   cancellable,
+					   error);
+
+	g_string_free (buffer, TRUE);
+
+	return success;
+}
+
+
+FrManifest *
+fr_manifest_load (GFile         *file,
+		  GCancellable  *cancellable,
+		  GError       **error)
+{
+	char        *buffer;
+	gsize        buffer_size;
+	FrManifest  *manifest;
+	char       **lines;
+	int          i;
+
+	if (! g_file_load_contents (file, cancellable, &buffer, &buffer_size, NULL, error))
+		return NULL;
+
+	manifest = fr_manifest_new (NULL);
+	lines = g_strsplit (buffer, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		char  *line = lines[i];
+		char **fields;
+
+		if ((*line == '\0') || (*line == '#'))
+			continue;
+
+		fields = g_strsplit (line, "\t", 4);
+		if ((g_strv_length (fields) != 4)
+		    || (strlen (fields[0]) != g_checksum_type_get_length (FR_MANIFEST_CHECKSUM) * 2))
+		{
+			char *name;
+
+			name = g_file_get_parse_name (file);
+			g_set_error (error,
+				     FR_ERROR,
+				     FR_ERROR_GENERIC,
+				     _("Invalid manifest \"%s\" at line %d"),
+				     name,
+				     i + 1);
+
+			g_free (name);
+			g_strfreev (fields);
+			fr_manifest_free (manifest);
+			manifest = NULL;
+			break;
+		}
+		else {
+			char *path;
+
+			path = g_strcompress (fields[3]);
+			fr_manifest_add (manifest,
+					 path,
+					 g_ascii_strtoll (fields[1], NULL, 10),
+					 g_ascii_strtoll (fields[2], NULL, 10),
+					 fields[0]);
+
+			g_free (path);
+		}
+
+		g_strfreev (fields);
+	}
+
+	g_strfreev (lines);
+	g_free (buffer);
+
+	if ((manifest != NULL) && (manifest->entries->len == 0)) {
+		char *name;
+
+		name = g_file_get_parse_name (file);
+		g_set_error (error,
+			     FR_ERROR,
+			     FR_ERROR_GENERIC,
+			     _("The manifest \"%s\" is empty"),
+			     name);
+
+		g_free (name);
+		fr_manifest_free (manifest);
+		manifest = NULL;
+	}
+
+	return manifest;
+}
+
+
+/* -- fr_manifest_verify -- */
+
+
+/* The files are read and hashed by a pool of threads, this way hashing
+ * uses all the processors and the disk always has several reads queued. */
+
+
+typedef struct {
+	FrManifest   *manifest;
+	GFile        *folder;
+	GCancellable *cancellable;
+	GMutex        mutex;
+	GList        *failures;          /* char * list */
+} VerifyData;
+
+
+static void
+verify_data_free (VerifyData *verify_data)
+{
+	_g_string_list_free (verify_data->failures);
+	g_mutex_clear (&verify_data->mutex);
+	_g_object_unref (verify_data->cancellable);
+	g_object_unref (verify_data->folder);
+	g_free (verify_data);
+}
+
+
+static void
+verify_data_add_failure (VerifyData    *verify_data,
+			 ManifestEntry *entry,
+			 const char    *message)
+{
+	char *failure;
+
+	failure = g_strdup_printf ("%s: %s", entry->path, message);
+
+	g_mutex_lock (&verify_data->mutex);
+	verify_data->failures = g_list_prepend (verify_data->failures, failure);
+	g_mutex_unlock (&verify_data->mutex);
+}
+
+
+static void
+verify_entry_func (gpointer data,
+		   gpointer user_data)
+{
+	ManifestEntry *entry = data;
+	VerifyData    *verify_data = user_data;
+	GFile         *file;
+	GFileInfo     *info;
+	GInputStream  *istream;
+	GError        *error = NULL;
+
+	if (g_cancellable_is_cancelled (verify_data->cancellable))
+		return;
+
+	file = g_file_resolve_relative_path (verify_data->folder, entry->path);
+
+	/* compare the size first, to avoid reading a file that can't match */
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE,
+				  verify_data->cancellable,
+				  &error);
+	if (info == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+			verify_data_add_failure (verify_data, entry, _("missing"));
+		else if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			verify_data_add_failure (verify_data, entry, error->message);
+		g_clear_error (&error);
+		g_object_unref (file);
+		return;
+	}
+
+	if (g_file_info_get_size (info) != entry->size) {
+		verify_data_add_failure (verify_data, entry, _("size differs"));
+		g_object_unref (info);
+		g_object_unref (file);
+		return;
+	}
+	g_object_unref (info);
+
+	istream = (GInputStream *) g_file_read (file, verify_data->cancellable, &error);
+	if (istream != NULL) {
+		GChecksum *checksum;
+		guchar    *buffer;
+		gssize     bytes_read;
+
+		checksum = g_checksum_new (FR_MANIFEST_CHECKSUM);
+		buffer = g_new (guchar, VERIFY_BUFFER_SIZE);
+		while ((bytes_read = g_input_stream_read (istream, buffer, VERIFY_BUFFER_SIZE, verify_data->cancellable, &error)) > 0)
+			g_checksum_update (checksum, buffer, bytes_read);
+
+		if ((error == NULL) && (g_ascii_strcasecmp (g_checksum_get_string (checksum), entry->digest) != 0))
+			verify_data_add_failure (verify_data, entry, _("checksum differs"));
+
+		g_free (buffer);
+		g_checksum_free (checksum);
+		g_object_unref (istream);
+	}
+
+	if ((error != NULL) && ! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		verify_data_add_failure (verify_data, entry, error->message);
+
+	_g_error_free (error);
+	g_object_unref (file);
+}
+
+
+static void
+verify_manifest_thread (GSimpleAsyncResult *result,
+			GObject            *object,
+			GCancellable       *cancellable)
+{
+	VerifyData  *verify_data;
+	FrManifest  *manifest;
+	GThreadPool *pool;
+	int          n_threads;
+	int          i;
+	GError      *error = NULL;
+
+	verify_data = g_simple_async_result_get_op_res_gpointer (result);
+	manifest = verify_data->manifest;
+
+	n_threads = CLAMP (g_get_num_processors (), 1, MAX_VERIFY_THREADS);
+	pool = g_thread_pool_new (verify_entry_func, verify_data, n_threads, TRUE, NULL);
+
+	g_mutex_lock (&manifest->mutex);
+	for (i = 0; i < manifest->entries->len; i++)
+		g_thread_pool_push (pool, g_ptr_array_index (manifest->entries, i), NULL);
+	g_mutex_unlock (&manifest->mutex);
+
+	/* wait for all the files to be checked */
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	verify_data->failures = g_list_sort (verify_data->failures, (GCompareFunc) strcmp);
+
+	if (! g_cancellable_set_error_if_cancelled (cancellable, &error) && (verify_data->failures != NULL)) {
+		int n_failures = g_list_length (verify_data->failures);
+
+		error = g_error_new (FR_ERROR,
+				     FR_ERROR_GENERIC,
+				     ngettext ("%d file does not match the manifest",
+					       "%d files do not match the manifest",
+					       n_failures),
+				     n_failures);
+	}
+
+	if (error != NULL) {
+		g_simple_async_result_set_from_error (result, error);
+		g_error_free (error);
+	}
+}
+
+
+/* Checks the files of the manifest in @folder, the relative paths are
+ * resolved against @folder. */
+void
+fr_manifest_verify (FrManifest          *manifest,
+		    GFile               *folder,
+		    GCancellable        *cancellable,
+		    GAsyncReadyCallback  callback,
+		    gpointer             user_data)
+{
+	GSimpleAsyncResult *result;
+	VerifyData         *verify_data;
+
+	verify_data = g_new0 (VerifyData, 1);
+	verify_data->manifest = manifest;
+	verify_data->folder = g_object_ref (folder);
+	verify_data->cancellable = _g_object_ref (cancellable);
+	g_mutex_init (&verify_data->mutex);
+
+	result = g_simple_async_result_new (NULL,
+					    callback,
+					    user_data,
+					    fr_manifest_verify);
+	g_simple_async_result_set_op_res_gpointer (result,
+						   verify_data,
+						   (GDestroyNotify) verify_data_free);
+	g_simple_async_result_run_in_thread (result,
+					     verify_manifest_thread,
+					     G_PRIORITY_DEFAULT,
+					     cancellable);
+
+	g_object_unref (result);
+}
+
+
+/* @failures, if not NULL, is set to a list of "path: reason" strings, to
+ * be freed with _g_string_list_free. */
+gboolean
+fr_manifest_verify_finish (FrManifest    *manifest,
+			   GAsyncResult  *result,
+			   GList        **failures,
+			   GError       **error)
+{
+	VerifyData *verify_data;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL, fr_manifest_verify), FALSE);
+
+	verify_data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+	if (failures != NULL) {
+		*failures = verify_data->failures;
+		verify_data->failures = NULL;
+	}
+
+	return ! g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result), error);
+}
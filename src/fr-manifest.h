@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FR_MANIFEST_H
+#define FR_MANIFEST_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* A manifest lists the path, size, modification time and SHA-256 digest
+ * of the files extracted from or added to an archive, one file per line.
+ * The paths are relative to the manifest root.  Files can be added from
+ * any thread. */
+
+#define FR_MANIFEST_CHECKSUM G_CHECKSUM_SHA256
+
+typedef struct _FrManifest FrManifest;
+
+FrManifest * fr_manifest_new           (GFile                *root);
+FrManifest * fr_manifest_load          (GFile                *file,
+					GCancellable         *cancellable,
+					GError              **error);
+void         fr_manifest_free          (FrManifest           *manifest);
+void         fr_manifest_add           (FrManifest           *manifest,
+					const char           *path,
+					goffset               size,
+					gint64                mtime,
+					const char           *digest);
+void         fr_manifest_add_file      (FrManifest           *manifest,
+					GFile                *file,
+					goffset               size,
+					gint64                mtime,
+					const char           *digest);
+gboolean     fr_manifest_save          (FrManifest           *manifest,
+					GFile                *file,
+					GCancellable         *cancellable,
+					GError              **error);
+void         fr_manifest_verify        (FrManifest           *manifest,
+					GFile                *folder,
+					GCancellable         *cancellable,
+					GAsyncReadyCallback   callback,
+					gpointer              user_data);
+gboolean     fr_manifest_verify_finish (FrManifest           *manifest,
+					GAsyncResult         *result,
+					GList               **failures,
+					GError              **error);
+
+#endif /* FR_MANIFEST_H */
@@ -41,6 +41,13 @@
 /* -- FrCommandInfo --  */
 
 
+typedef enum {
+	FR_COMMAND_STATE_WAITING,
+	FR_COMMAND_STATE_RUNNING,
+	FR_COMMAND_STATE_FINISHED
+} FrCommandState;
+
+
 typedef struct {
 	GList        *args;              /* command to execute */
 	char         *dir;               /* working directory */
@@ -50,6 +57,15 @@ typedef struct {
 	guint         ignore_error : 1;  /* whether to continue to execute
 					  * other commands if this command
 					  * fails. */
+	guint         parallel : 1;      /* whether the command can be
+					  * executed together with the
+					  * previous command. */
+	GList        *dependencies;      /* indexes of the commands that must
+					  * be terminated before executing
+					  * this command, if NULL the command
+					  * waits for all the previous
+					  * commands. */
+	FrCommandState state;
 	ContinueFunc  continue_func;
 	gpointer      continue_data;
 	ProcFunc      begin_func;
@@ -69,6 +85,9 @@ fr_command_info_new (void)
 	info->dir = NULL;
 	info->sticky = FALSE;
 	info->ignore_error = FALSE;
+	info->parallel = FALSE;
+	info->dependencies = NULL;
+	info->state = FR_COMMAND_STATE_WAITING;
 
 	return info;
 }
@@ -91,6 +110,7 @@ fr_command_info_free (FrCommandInfo *info)
 		info->dir = NULL;
 	}
 
+	g_list_free (info->dependencies);
 	g_free (info);
 }
 
@@ -206,6 +226,9 @@ typedef struct {
 	FrError            *first_error;
 	GList              *first_error_stdout;
 	GList              *first_error_stderr;
+	gboolean            stop_scheduling;     /* do not start other commands. */
+	gboolean            restart_pending;     /* restart when the running
+						  * commands terminate. */
 } ExecuteData;
 
 
@@ -229,6 +252,54 @@ execute_data_free (ExecuteData *exec_data)
 }
 
 
+/* -- FrProcessJob -- */
+
+
+typedef struct {
+	ExecuteData   *exec_data;
+	int            n_comm;           /* index of the executed command. */
+	GPid           pid;
+	guint          check_timeout;
+	FrChannelData  out;
+	FrChannelData  err;
+	FrError       *error;
+} FrProcessJob;
+
+
+static FrProcessJob *
+fr_process_job_new (ExecuteData *exec_data,
+		    int          n_comm)
+{
+	FrProcessJob *job;
+
+	job = g_new0 (FrProcessJob, 1);
+	job->exec_data = exec_data;
+	job->n_comm = n_comm;
+	job->pid = 0;
+	job->check_timeout = 0;
+	fr_channel_data_init (&job->out);
+	fr_channel_data_init (&job->err);
+	job->error = NULL;
+
+	return job;
+}
+
+
+static void
+fr_process_job_free (FrProcessJob *job)
+{
+	if (job == NULL)
+		return;
+
+	if (job->check_timeout != 0)
+		g_source_remove (job->check_timeout);
+	fr_channel_data_free (&job->out);
+	fr_channel_data_free (&job->err);
+	fr_error_free (job->error);
+	g_free (job);
+}
+
+
 /* -- FrProcess  -- */
 
 
@@ -251,12 +322,15 @@ struct _FrProcessPrivate {
 	gint         n_comm;              /* total number of commands */
 	gint         current_comm;        /* currently editing command. */
 
-	GPid         command_pid;
-	guint        check_timeout;
+	GList       *jobs;                /* FrProcessJob elements, the
+					   * running commands. */
+	int          max_jobs;            /* max number of commands to
+					   * execute at the same time. */
+	int          first_unfinished;    /* all the commands before this one
+					   * are terminated. */
 
 	gboolean     running;
 	gboolean     stopping;
-	gint         current_command;
 
 	gboolean     use_standard_locale;
 	gboolean     sticky_only;         /* whether to execute only sticky
@@ -319,11 +393,12 @@ fr_process_init (FrProcess *process)
 	process->priv->n_comm = -1;
 	process->priv->current_comm = -1;
 
-	process->priv->command_pid = 0;
+	process->priv->jobs = NULL;
+	process->priv->max_jobs = MAX (1, g_get_num_processors ());
+	process->priv->first_unfinished = 0;
 	fr_channel_data_init (&process->out);
 	fr_channel_data_init (&process->err);
 
-	process->priv->check_timeout = 0;
 	process->priv->running = FALSE;
 	process->priv->stopping = FALSE;
 	process->restart = FALSE;
@@ -462,6 +537,46 @@ fr_process_set_ignore_error (FrProcess *process,
 }
 
 
+/* Returns the index of the last command added, to be used as a dependency
+ * of the commands added later. */
+int
+fr_process_get_last_command (FrProcess *process)
+{
+	g_return_val_if_fail (process != NULL, -1);
+
+	return process->priv->current_comm;
+}
+
+
+void
+fr_process_set_parallel (FrProcess *process,
+			 gboolean   parallel)
+{
+	FrCommandInfo *info;
+
+	g_return_if_fail (process != NULL);
+	g_return_if_fail (process->priv->current_comm >= 0);
+
+	info = g_ptr_array_index (process->priv->comm, process->priv->current_comm);
+	info->parallel = parallel;
+}
+
+
+void
+fr_process_add_dependency (FrProcess *process,
+			   int        n_comm)
+{
+	FrCommandInfo *info;
+
+	g_return_if_fail (process != NULL);
+	g_return_if_fail (process->priv->current_comm >= 0);
+	g_return_if_fail ((n_comm >= 0) && (n_comm < process->priv->current_comm));
+
+	info = g_ptr_array_index (process->priv->comm, process->priv->current_comm);
+	info->dependencies = g_list_prepend (info->dependencies, GINT_TO_POINTER (n_comm));
+}
+
+
 void
 fr_process_add_arg (FrProcess  *process,
 		    const char *arg)
@@ -655,15 +770,70 @@ command_is_sticky (FrProcess *process,
 }
 
 
+static gboolean
+command_is_finished (FrProcess *process,
+		     int        i)
+{
+	FrCommandInfo *info;
+
+	info = g_ptr_array_index (process->priv->comm, i);
+	return info->state == FR_COMMAND_STATE_FINISHED;
+}
+
+
+static void
+command_set_finished (FrProcess *process,
+		      int        i)
+{
+	FrCommandInfo *info;
+
+	info = g_ptr_array_index (process->priv->comm, i);
+	info->state = FR_COMMAND_STATE_FINISHED;
+
+	while ((process->priv->first_unfinished <= process->priv->n_comm)
+	       && command_is_finished (process, process->priv->first_unfinished))
+	{
+		process->priv->first_unfinished++;
+	}
+}
+
+
+static gboolean
+command_dependencies_satisfied (FrProcess *process,
+				int        i)
+{
+	FrCommandInfo *info;
+	GList         *scan;
+
+	info = g_ptr_array_index (process->priv->comm, i);
+
+	if (info->dependencies != NULL) {
+		for (scan = info->dependencies; scan; scan = scan->next)
+			if (! command_is_finished (process, GPOINTER_TO_INT (scan->data)))
+				return FALSE;
+		return TRUE;
+	}
+
+	/* a parallel command has the same dependencies of the previous
+	 * command. */
+
+	if (info->parallel && (i > 0))
+		return command_dependencies_satisfied (process, i - 1);
+
+	return process->priv->first_unfinished >= i;
+}
+
+
 static void
-allow_sticky_processes_only (ExecuteData *exec_data)
+allow_sticky_processes_only (ExecuteData *exec_data,
+			     int          n_comm)
 {
 	FrProcess *process = exec_data->process;
 
 	if (! process->priv->sticky_only) {
 		/* Remember the first error. */
 
-		exec_data->error_command = process->priv->current_command;
+		exec_data->error_command = n_comm;
 		exec_data->first_error = fr_error_copy (exec_data->error);
 		exec_data->first_error_stdout = g_list_reverse (_g_string_list_dup (process->out.raw));
 		exec_data->first_error_stderr = g_list_reverse (_g_string_list_dup (process->err.raw));
@@ -684,6 +854,7 @@ execute_cancelled_cb (GCancellable *cancellable,
 {
 	ExecuteData *exec_data = user_data;
 	FrProcess   *process = exec_data->process;
+	GList       *scan;
 
 	if (! process->priv->running)
 		return;
@@ -692,24 +863,11 @@ execute_cancelled_cb (GCancellable *cancellable,
 		return;
 
 	process->priv->stopping = TRUE;
+	exec_data->restart_pending = FALSE;
+	fr_error_free (exec_data->error);
 	exec_data->error = fr_error_new (FR_ERROR_STOPPED, 0, NULL);
 
-	if (command_is_sticky (process, process->priv->current_command))
-		allow_sticky_processes_only (exec_data);
-
-	else if (process->priv->command_pid > 0)
-		killpg (process->priv->command_pid, SIGTERM);
-
-	else {
-		if (process->priv->check_timeout != 0) {
-			g_source_remove (process->priv->check_timeout);
-			process->priv->check_timeout = 0;
-		}
-
-		process->priv->command_pid = 0;
-		fr_channel_data_close_source (&process->out);
-		fr_channel_data_close_source (&process->err);
-
+	if (process->priv->jobs == NULL) {
 		process->priv->running = FALSE;
 
 		if (exec_data->cancel_id != 0) {
@@ -717,7 +875,20 @@ execute_cancelled_cb (GCancellable *cancellable,
 			exec_data->cancel_id = 0;
 		}
 		g_simple_async_result_complete_in_idle (exec_data->result);
+
+		return;
 	}
+
+	/* let the sticky commands terminate, kill the other ones. */
+
+	for (scan = process->priv->jobs; scan; scan = scan->next) {
+		FrProcessJob *job = scan->data;
+
+		if (! command_is_sticky (process, job->n_comm) && (job->pid > 0))
+			killpg (job->pid, SIGTERM);
+	}
+
+	allow_sticky_processes_only (exec_data, ((FrProcessJob *) process->priv->jobs->data)->n_comm);
 }
 
 
@@ -732,17 +903,32 @@ _fr_process_restart (ExecuteData *exec_data)
 }
 
 
-static void  execute_current_command (ExecuteData *exec_data);
+static void  _fr_process_schedule (ExecuteData *exec_data);
 
 
-static void
-child_setup (gpointer user_data)
+static char **
+get_spawn_environment (gboolean use_standard_locale)
 {
-	FrProcess *process = user_data;
+	static char **environment[2] = { NULL, NULL };
+	int           i;
+
+	/* the environment is computed once and shared by all the
+	 * processes. */
 
-	if (process->priv->use_standard_locale)
-		putenv ("LC_MESSAGES=C");
+	i = use_standard_locale ? 1 : 0;
+	if (environment[i] == NULL) {
+		environment[i] = g_get_environ ();
+		if (use_standard_locale)
+			environment[i] = g_environ_setenv (environment[i], "LC_MESSAGES", "C", TRUE);
+	}
 
+	return environment[i];
+}
+
+
+static void
+child_setup (gpointer user_data)
+{
 	/* detach from the tty */
 
 	setsid ();
@@ -779,94 +965,166 @@ _fr_process_execute_complete_in_idle (ExecuteData *exec_data)
 }
 
 
+static void
+_fr_process_execute_done (ExecuteData *exec_data)
+{
+	FrProcess *process = exec_data->process;
+
+	process->priv->use_standard_locale = FALSE;
+
+	if (process->out.raw != NULL)
+		process->out.raw = g_list_reverse (process->out.raw);
+	if (process->err.raw != NULL)
+		process->err.raw = g_list_reverse (process->err.raw);
+
+	process->priv->running = FALSE;
+	process->priv->stopping = FALSE;
+
+	if (process->priv->sticky_only) {
+		/* Restore the first error. */
+
+		fr_error_free (exec_data->error);
+		exec_data->error = fr_error_copy (exec_data->first_error);
+
+		/* Restore the first error output as well. */
+
+		_g_string_list_free (process->out.raw);
+		process->out.raw = exec_data->first_error_stdout;
+		exec_data->first_error_stdout = NULL;
+
+		_g_string_list_free (process->err.raw);
+		process->err.raw = exec_data->first_error_stderr;
+		exec_data->first_error_stderr = NULL;
+	}
+
+	_fr_process_execute_complete_in_idle (exec_data);
+}
+
+
 static gint
-check_child (gpointer data)
+check_job (gpointer data)
 {
-	ExecuteData   *exec_data = data;
+	FrProcessJob  *job = data;
+	ExecuteData   *exec_data = job->exec_data;
 	FrProcess     *process = exec_data->process;
 	FrCommandInfo *info;
 	pid_t          pid;
 	int            status;
 	gboolean       continue_process;
 
-	info = g_ptr_array_index (process->priv->comm, process->priv->current_command);
+	info = g_ptr_array_index (process->priv->comm, job->n_comm);
 
 	/* Remove check. */
 
-	g_source_remove (process->priv->check_timeout);
-	process->priv->check_timeout = 0;
+	g_source_remove (job->check_timeout);
+	job->check_timeout = 0;
 
-	if (fr_channel_data_read (&process->out) == G_IO_STATUS_ERROR) {
-		exec_data->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, process->out.error);
+	if (fr_channel_data_read (&job->out) == G_IO_STATUS_ERROR) {
+		job->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, job->out.error);
 	}
-	else if (fr_channel_data_read (&process->err) == G_IO_STATUS_ERROR) {
-		exec_data->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, process->err.error);
+	else if (fr_channel_data_read (&job->err) == G_IO_STATUS_ERROR) {
+		job->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, job->err.error);
 	}
 	else {
-		pid = waitpid (process->priv->command_pid, &status, WNOHANG);
-		if (pid != process->priv->command_pid) {
+		pid = waitpid (job->pid, &status, WNOHANG);
+		if (pid != job->pid) {
 			/* Add check again. */
-			process->priv->check_timeout = g_timeout_add (REFRESH_RATE,
-							              check_child,
-							              exec_data);
+			job->check_timeout = g_timeout_add (REFRESH_RATE,
+							    check_job,
+							    job);
 			return FALSE;
 		}
 	}
 
-	if (info->ignore_error && (exec_data->error != NULL)) {
+	if (info->ignore_error && (job->error != NULL)) {
 #ifdef DEBUG
 			{
 				GList *scan;
 
 				g_print ("** ERROR **\n");
-				g_print ("%s\n", exec_data->error->gerror->message);
-				for (scan = process->err.raw; scan; scan = scan->next)
+				if (job->error->gerror != NULL)
+					g_print ("%s\n", job->error->gerror->message);
+				for (scan = job->err.raw; scan; scan = scan->next)
 					g_print ("%s\n", (char *)scan->data);
 			}
 #endif
-		fr_clear_error (&exec_data->error);
+		fr_clear_error (&job->error);
 		debug (DEBUG_INFO, "[error ignored]\n");
 	}
-	else if (exec_data->error == NULL) {
+	else if (job->error == NULL) {
 		if (WIFEXITED (status)) {
 			if (WEXITSTATUS (status) == 255) {
-				exec_data->error = fr_error_new (FR_ERROR_COMMAND_NOT_FOUND, 0, NULL);
+				job->error = fr_error_new (FR_ERROR_COMMAND_NOT_FOUND, 0, NULL);
 			}
 			else if (WEXITSTATUS (status) != 0) {
-				exec_data->error = fr_error_new (FR_ERROR_COMMAND_ERROR, WEXITSTATUS (status), NULL);
+				job->error = fr_error_new (FR_ERROR_COMMAND_ERROR, WEXITSTATUS (status), NULL);
 			}
 		}
 		else {
-			exec_data->error = fr_error_new (FR_ERROR_EXITED_ABNORMALLY, 255, NULL);
+			job->error = fr_error_new (FR_ERROR_EXITED_ABNORMALLY, 255, NULL);
 		}
 	}
 
-	process->priv->command_pid = 0;
+	job->pid = 0;
 
-	if (exec_data->error == NULL) {
-		if (fr_channel_data_flush (&process->out) == G_IO_STATUS_ERROR)
-			exec_data->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, process->out.error);
-		else if (fr_channel_data_flush (&process->err) == G_IO_STATUS_ERROR)
-			exec_data->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, process->err.error);
+	if (job->error == NULL) {
+		if (fr_channel_data_flush (&job->out) == G_IO_STATUS_ERROR)
+			job->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, job->out.error);
+		else if (fr_channel_data_flush (&job->err) == G_IO_STATUS_ERROR)
+			job->error = fr_error_new (FR_ERROR_IO_CHANNEL, 0, job->err.error);
 	}
 
 	if (info->end_func != NULL)
 		(*info->end_func) (info->end_data);
 
+	/* the output of the last terminated command is kept in the process
+	 * channels. */
+
+	_g_string_list_free (process->out.raw);
+	process->out.raw = job->out.raw;
+	job->out.raw = NULL;
+
+	_g_string_list_free (process->err.raw);
+	process->err.raw = job->err.raw;
+	job->err.raw = NULL;
+
+	process->priv->jobs = g_list_remove (process->priv->jobs, job);
+	command_set_finished (process, job->n_comm);
+
+	/* after an error the result of the other commands is ignored. */
+
+	if (exec_data->error == NULL) {
+		exec_data->error = job->error;
+		job->error = NULL;
+	}
+
 	/**/
 
-	if ((exec_data->error != NULL)
+	if (! exec_data->restart_pending
+	    && (exec_data->error != NULL)
 	    && (exec_data->error->type == FR_ERROR_IO_CHANNEL)
 	    && g_error_matches (exec_data->error->gerror, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE))
 	{
 		if (process->priv->current_charset < n_charsets - 1) {
-			/* try with another charset */
+			/* try with another charset, after the running
+			 * commands have terminated. */
 			process->priv->current_charset++;
-			_fr_process_restart (exec_data);
-			return FALSE;
+			exec_data->restart_pending = TRUE;
 		}
-		fr_error_free (exec_data->error);
-		exec_data->error = fr_error_new (FR_ERROR_BAD_CHARSET, 0, exec_data->error->gerror);
+		else {
+			FrError *charset_error;
+
+			charset_error = fr_error_new (FR_ERROR_BAD_CHARSET, 0, exec_data->error->gerror);
+			fr_error_free (exec_data->error);
+			exec_data->error = charset_error;
+		}
+	}
+
+	if (exec_data->restart_pending) {
+		fr_process_job_free (job);
+		if (process->priv->jobs == NULL)
+			_fr_process_restart (exec_data);
+		return FALSE;
 	}
 
 	/* Check whether to continue or stop the process */
@@ -875,10 +1133,9 @@ check_child (gpointer data)
 	if (info->continue_func != NULL)
 		continue_process = (*info->continue_func) (&exec_data->error, info->continue_data);
 
-	/* Execute the next command. */
 	if (continue_process) {
 		if (exec_data->error != NULL) {
-			allow_sticky_processes_only (exec_data);
+			allow_sticky_processes_only (exec_data, job->n_comm);
 #ifdef DEBUG
 			{
 				GList *scan;
@@ -889,79 +1146,57 @@ check_child (gpointer data)
 			}
 #endif
 		}
-
-		if (process->priv->sticky_only) {
-			do {
-				process->priv->current_command++;
-			}
-			while ((process->priv->current_command <= process->priv->n_comm)
-				&& ! command_is_sticky (process, process->priv->current_command));
-		}
-		else
-			process->priv->current_command++;
-
-		if (process->priv->current_command <= process->priv->n_comm) {
-			execute_current_command (exec_data);
-			return FALSE;
-		}
 	}
+	else
+		exec_data->stop_scheduling = TRUE;
 
-	/* Done */
+	fr_process_job_free (job);
 
-	process->priv->current_command = -1;
-	process->priv->use_standard_locale = FALSE;
+	/* Execute the next commands. */
 
-	if (process->out.raw != NULL)
-		process->out.raw = g_list_reverse (process->out.raw);
-	if (process->err.raw != NULL)
-		process->err.raw = g_list_reverse (process->err.raw);
-
-	process->priv->running = FALSE;
-	process->priv->stopping = FALSE;
-
-	if (process->priv->sticky_only) {
-		/* Restore the first error. */
-
-		fr_error_free (exec_data->error);
-		exec_data->error = fr_error_copy (exec_data->first_error);
-
-		/* Restore the first error output as well. */
-
-		_g_string_list_free (process->out.raw);
-		process->out.raw = exec_data->first_error_stdout;
-		exec_data->first_error_stdout = NULL;
-
-		_g_string_list_free (process->err.raw);
-		process->err.raw = exec_data->first_error_stderr;
-		exec_data->first_error_stderr = NULL;
-	}
-
-	_fr_process_execute_complete_in_idle (exec_data);
+	_fr_process_schedule (exec_data);
 
 	return FALSE;
 }
 
 
 static void
-execute_current_command (ExecuteData *exec_data)
+execute_command (ExecuteData *exec_data,
+		 int          n_comm)
 {
 	FrProcess      *process = exec_data->process;
 	FrCommandInfo  *info;
+	FrProcessJob   *job;
 	GList          *scan;
 	char          **argv;
+	GSpawnFlags     flags;
 	int             out_fd, err_fd;
 	int             i = 0;
 	GError         *error = NULL;
 
-	debug (DEBUG_INFO, "%d/%d) ", process->priv->current_command, process->priv->n_comm);
+	debug (DEBUG_INFO, "%d/%d) ", n_comm, process->priv->n_comm);
 
-	info = g_ptr_array_index (process->priv->comm, process->priv->current_command);
+	info = g_ptr_array_index (process->priv->comm, n_comm);
 
 	argv = g_new (char *, g_list_length (info->args) + 1);
 	for (scan = info->args; scan; scan = scan->next)
 		argv[i++] = scan->data;
 	argv[i] = NULL;
 
+	/* use the cached absolute path to avoid searching the program in
+	 * the path every time. */
+
+	flags = G_SPAWN_LEAVE_DESCRIPTORS_OPEN | G_SPAWN_DO_NOT_REAP_CHILD;
+	if (strchr (argv[0], '/') == NULL) {
+		const char *path;
+
+		path = _g_program_get_path (argv[0]);
+		if (path != NULL)
+			argv[0] = (char *) path;
+		else
+			flags |= G_SPAWN_SEARCH_PATH;
+	}
+
 #ifdef DEBUG
 	{
 		int j;
@@ -975,6 +1210,9 @@ execute_current_command (ExecuteData *exec_data)
 		if (info->ignore_error)
 			g_print ("\t[ignore error]\n");
 
+		if (process->priv->jobs != NULL)
+			g_print ("\t[%d running]\n", g_list_length (process->priv->jobs));
+
 		g_print ("\t");
 		for (j = 0; j < i; j++)
 			g_print ("%s ", argv[j]);
@@ -985,23 +1223,28 @@ execute_current_command (ExecuteData *exec_data)
 	if (info->begin_func != NULL)
 		(*info->begin_func) (info->begin_data);
 
+	job = fr_process_job_new (exec_data, n_comm);
+
 	if (! g_spawn_async_with_pipes (info->dir,
 					argv,
-					NULL,
-					(G_SPAWN_LEAVE_DESCRIPTORS_OPEN
-					 | G_SPAWN_SEARCH_PATH
-					 | G_SPAWN_DO_NOT_REAP_CHILD),
+					get_spawn_environment (process->priv->use_standard_locale),
+					flags,
 					child_setup,
-					process,
-					&process->priv->command_pid,
+					NULL,
+					&job->pid,
 					NULL,
 					&out_fd,
 					&err_fd,
 					&error))
 	{
-		exec_data->error = fr_error_new (FR_ERROR_SPAWN, 0, error);
-		_fr_process_execute_complete_in_idle (exec_data);
+		/* the sticky commands are executed anyway */
+
+		if (exec_data->error == NULL)
+			exec_data->error = fr_error_new (FR_ERROR_SPAWN, 0, error);
+		allow_sticky_processes_only (exec_data, n_comm);
+		command_set_finished (process, n_comm);
 
+		fr_process_job_free (job);
 		g_error_free (error);
 		g_free (argv);
 		return;
@@ -1009,12 +1252,53 @@ execute_current_command (ExecuteData *exec_data)
 
 	g_free (argv);
 
-	fr_channel_data_set_fd (&process->out, out_fd, _fr_process_get_charset (process));
-	fr_channel_data_set_fd (&process->err, err_fd, _fr_process_get_charset (process));
+	info->state = FR_COMMAND_STATE_RUNNING;
 
-	process->priv->check_timeout = g_timeout_add (REFRESH_RATE,
-					              check_child,
-					              exec_data);
+	job->out.line_func = process->out.line_func;
+	job->out.line_data = process->out.line_data;
+	job->err.line_func = process->err.line_func;
+	job->err.line_data = process->err.line_data;
+	fr_channel_data_set_fd (&job->out, out_fd, _fr_process_get_charset (process));
+	fr_channel_data_set_fd (&job->err, err_fd, _fr_process_get_charset (process));
+
+	process->priv->jobs = g_list_prepend (process->priv->jobs, job);
+	job->check_timeout = g_timeout_add (REFRESH_RATE,
+					    check_job,
+					    job);
+}
+
+
+static void
+_fr_process_schedule (ExecuteData *exec_data)
+{
+	FrProcess *process = exec_data->process;
+	int        i;
+
+	if (! exec_data->stop_scheduling) {
+		for (i = process->priv->first_unfinished;
+		     (i <= process->priv->n_comm) && (g_list_length (process->priv->jobs) < process->priv->max_jobs);
+		     i++)
+		{
+			FrCommandInfo *info;
+
+			info = g_ptr_array_index (process->priv->comm, i);
+			if (info->state != FR_COMMAND_STATE_WAITING)
+				continue;
+
+			/* after an error execute the sticky commands only */
+
+			if (process->priv->sticky_only && ! info->sticky) {
+				command_set_finished (process, i);
+				continue;
+			}
+
+			if (command_dependencies_satisfied (process, i))
+				execute_command (exec_data, i);
+		}
+	}
+
+	if (process->priv->jobs == NULL)
+		_fr_process_execute_done (exec_data);
 }
 
 
@@ -1022,6 +1306,7 @@ static void
 _fr_process_start (ExecuteData *exec_data)
 {
 	FrProcess *process = exec_data->process;
+	int        i;
 
 	_g_string_list_free (exec_data->first_error_stdout);
 	exec_data->first_error_stdout = NULL;
@@ -1032,11 +1317,21 @@ _fr_process_start (ExecuteData *exec_data)
         fr_error_free (exec_data->error);
         exec_data->error = NULL;
 
+	exec_data->stop_scheduling = FALSE;
+	exec_data->restart_pending = FALSE;
+
 	fr_channel_data_reset (&process->out);
 	fr_channel_data_reset (&process->err);
 
+	for (i = 0; i <= process->priv->n_comm; i++) {
+		FrCommandInfo *info;
+
+		info = g_ptr_array_index (process->priv->comm, i);
+		info->state = FR_COMMAND_STATE_WAITING;
+	}
+
+	process->priv->first_unfinished = 0;
 	process->priv->sticky_only = FALSE;
-	process->priv->current_command = 0;
 	process->priv->stopping = FALSE;
 
 	if (process->priv->n_comm == -1) {
@@ -1045,7 +1340,7 @@ _fr_process_start (ExecuteData *exec_data)
 	}
 	else {
 		process->priv->running = TRUE;
-		execute_current_command (exec_data);
+		_fr_process_schedule (exec_data);
 	}
 }
 
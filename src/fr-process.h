@@ -110,6 +110,11 @@ void        fr_process_set_sticky           (FrProcess            *fr_proc,
 					     gboolean              sticky);
 void        fr_process_set_ignore_error     (FrProcess            *fr_proc,
 					     gboolean              ignore_error);
+int         fr_process_get_last_command     (FrProcess            *fr_proc);
+void        fr_process_set_parallel         (FrProcess            *fr_proc,
+					     gboolean              parallel);
+void        fr_process_add_dependency       (FrProcess            *fr_proc,
+					     int                   n_comm);
 void        fr_process_use_standard_locale  (FrProcess            *fr_proc,
 					     gboolean              use_stand_locale);
 void        fr_process_set_out_line_func    (FrProcess            *fr_proc,
@@ -300,6 +300,7 @@ fr_window_activate_open (GSimpleAction *action,
 
 	filter = gtk_file_filter_new ();
 	gtk_file_filter_set_name (filter, _("All archives"));
+	compute_supported_archive_types ();
 	for (i = 0; open_type[i] != -1; i++)
 		gtk_file_filter_add_mime_type (filter, mime_type_desc[open_type[i]].mime_type);
 	gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (file_sel), filter);
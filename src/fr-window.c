@@ -55,6 +55,7 @@
 #include "fr-init.h"
 #include "gtk-utils.h"
 #include "open-file.h"
+#include "open-file-cache.h"
 #include "typedefs.h"
 
 #define LAST_OUTPUT_SCHEMA_NAME "LastOutput"
@@ -465,16 +466,8 @@ fr_window_history_clear (FrWindow *window)
 static void
 fr_window_free_open_files (FrWindow *window)
 {
-	GList *scan;
-
-	for (scan = window->priv->open_files; scan; scan = scan->next) {
-		OpenFile *file = scan->data;
-
-		if (file->monitor != NULL)
-			g_file_monitor_cancel (file->monitor);
-		open_file_free (file);
-	}
-	g_list_free (window->priv->open_files);
+	open_file_cache_unmonitor (window);
+	g_list_free_full (window->priv->open_files, (GDestroyNotify) open_file_free);
 	window->priv->open_files = NULL;
 }
 
@@ -2795,6 +2788,23 @@ fr_window_show_confirmation_dialog_with_open_archive (FrWindow *window)
 }
 
 
+static void
+fr_window_show_confirmation_dialog_with_test_result (FrWindow *window)
+{
+	GtkWidget *dialog;
+
+	dialog = _gtk_message_dialog_new (GTK_WINDOW (window),
+					  GTK_DIALOG_MODAL,
+					  _("No errors found in the archive"),
+					  NULL,
+					  _GTK_LABEL_CLOSE, GTK_RESPONSE_CLOSE,
+					  NULL);
+
+	gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_CLOSE);
+	fr_window_show_confirmation_dialog (window, dialog);
+}
+
+
 static void
 fr_window_add_to_recent_list (FrWindow *window,
 			      GFile    *file)
@@ -2928,6 +2938,7 @@ _handle_archive_operation_error (FrWindow  *window,
 	char      *utf8_name;
 	char      *details;
 	GList     *output;
+	GList     *test_output;
 	GtkWidget *dialog;
 
 	if (continue_batch) *continue_batch = (error == NULL);
@@ -2972,6 +2983,7 @@ _handle_archive_operation_error (FrWindow  *window,
 		msg = NULL;
 		details = NULL;
 		output = NULL;
+		test_output = NULL;
 
 		if (window->priv->batch_mode) {
 			dialog_parent = NULL;
@@ -3055,13 +3067,36 @@ _handle_archive_operation_error (FrWindow  *window,
 		if ((error->code != FR_ERROR_GENERIC) && FR_IS_COMMAND (archive))
 			output = fr_command_get_last_output (FR_COMMAND (archive));
 
+		/* show the list of the damaged files found by an archive
+		 * tested without an external command. */
+
+		if ((action == FR_ACTION_TESTING_ARCHIVE) && ! FR_IS_COMMAND (archive)) {
+			GList *scan;
+
+			for (scan = fr_archive_get_test_failures (archive); scan; scan = scan->next) {
+				FrTestFailure *failure = scan->data;
+
+				if (failure->path != NULL)
+					test_output = g_list_prepend (test_output, g_strdup_printf ("%s: %s", failure->path, failure->message));
+				else
+					test_output = g_list_prepend (test_output, g_strdup (failure->message));
+			}
+			test_output = g_list_reverse (test_output);
+			if (test_output != NULL) {
+				output = test_output;
+				details = NULL;
+			}
+		}
+
 		dialog = _gtk_error_dialog_new (dialog_parent,
 						0,
 						output,
 						msg,
 						((details != NULL) ? "%s" : NULL),
 						details);
-		fr_window_show_error_dialog (window, dialog, dialog_parent, details);
+		fr_window_show_error_dialog (window, dialog, dialog_parent, (test_output != NULL) ? error->message : details);
+
+		_g_string_list_free (test_output);
 		break;
 	}
 }
@@ -3194,8 +3229,12 @@ _archive_operation_completed (FrWindow *window,
 
 	case FR_ACTION_TESTING_ARCHIVE:
 		close_progress_dialog (window, FALSE);
-		if (error == NULL)
-			fr_window_view_last_output (window, _("Test Result"));
+		if (error == NULL) {
+			if (FR_IS_COMMAND (window->archive))
+				fr_window_view_last_output (window, _("Test Result"));
+			else
+				fr_window_show_confirmation_dialog_with_test_result (window);
+		}
 		return;
 
 	case FR_ACTION_EXTRACTING_FILES:
@@ -6151,6 +6190,16 @@ fr_window_get_archive_file (FrWindow *window)
 }
 
 
+/* Returns the operation the archive is performing. */
+FrAction
+fr_window_get_archive_action (FrWindow *window)
+{
+	g_return_val_if_fail (window != NULL, FR_ACTION_NONE);
+
+	return window->priv->action;
+}
+
+
 GFile *
 fr_window_get_archive_file_for_paste (FrWindow *window)
 {
@@ -7452,7 +7501,6 @@ convert_data_new (GFile      *file,
 		cdata->password = g_strdup (password);
 	cdata->encrypt_header = encrypt_header;
 	cdata->volume_size = volume_size;
-	cdata->temp_extraction_dir = _g_file_get_temp_work_dir (NULL);
 
 	return cdata;
 }
@@ -7463,8 +7511,10 @@ convert_data_free (ConvertData *cdata)
 {
 	if (cdata == NULL)
 		return;
-	_g_file_remove_directory (cdata->temp_extraction_dir, NULL, NULL);
-	_g_object_unref (cdata->temp_extraction_dir);
+	if (cdata->temp_extraction_dir != NULL) {
+		_g_file_remove_directory (cdata->temp_extraction_dir, NULL, NULL);
+		g_object_unref (cdata->temp_extraction_dir);
+	}
 	_g_object_unref (cdata->file);
 	_g_object_unref (cdata->new_archive);
 	g_free (cdata->mime_type);
@@ -7638,6 +7688,24 @@ fr_window_archive_save_as (FrWindow   *window,
 	_g_object_unref (window->priv->saving_file);
 	window->priv->saving_file = g_object_ref (cdata->file);
 
+	/* copy the entries directly when possible, otherwise extract the
+	 * archive to a temporary folder and add the extracted files. */
+
+	if (fr_archive_can_convert (cdata->new_archive, window->archive, window->priv->password, cdata->password)) {
+		fr_archive_convert (cdata->new_archive,
+				    window->archive,
+				    window->priv->password,
+				    cdata->password,
+				    cdata->encrypt_header,
+				    window->priv->compression,
+				    cdata->volume_size,
+				    window->priv->cancellable,
+				    archive_add_ready_for_conversion_cb,
+				    cdata);
+		return;
+	}
+
+	cdata->temp_extraction_dir = _g_file_get_temp_work_dir (NULL);
 	fr_archive_action_started (window->archive, FR_ACTION_EXTRACTING_FILES);
 	fr_archive_extract (window->archive,
 			    NULL,
@@ -7756,7 +7824,6 @@ encrypt_data_new (FrWindow   *window,
 	if (password != NULL)
 		edata->password = g_strdup (password);
 	edata->encrypt_header = encrypt_header;
-	edata->temp_extraction_dir = _g_file_get_temp_work_dir (NULL);
 
 	return edata;
 }
@@ -7776,8 +7843,10 @@ encrypt_data_free (EncryptData *edata)
 	}
 	_g_object_unref (edata->temp_new_file);
 	_g_object_unref (edata->new_archive);
-	_g_file_remove_directory (edata->temp_extraction_dir, NULL, NULL);
-	_g_object_unref (edata->temp_extraction_dir);
+	if (edata->temp_extraction_dir != NULL) {
+		_g_file_remove_directory (edata->temp_extraction_dir, NULL, NULL);
+		g_object_unref (edata->temp_extraction_dir);
+	}
 	g_free (edata->password);
 	g_free (edata);
 }
@@ -7998,6 +8067,24 @@ fr_window_archive_encrypt (FrWindow   *window,
 					    edata,
 					    (GFreeFunc) encrypt_data_free);
 
+	/* re-encrypt the entries in memory when possible, this way the
+	 * decrypted files are never written to disk. */
+
+	if (fr_archive_can_convert (edata->new_archive, window->archive, window->priv->password, edata->password)) {
+		fr_archive_convert (edata->new_archive,
+				    window->archive,
+				    window->priv->password,
+				    edata->password,
+				    edata->encrypt_header,
+				    window->priv->compression,
+				    0,
+				    window->priv->cancellable,
+				    archive_add_ready_for_encryption_cb,
+				    edata);
+		return;
+	}
+
+	edata->temp_extraction_dir = _g_file_get_temp_work_dir (NULL);
 	fr_archive_action_started (window->archive, FR_ACTION_EXTRACTING_FILES);
 	fr_archive_extract (window->archive,
 			    NULL,
@@ -9000,7 +9087,11 @@ typedef struct {
 	FrWindow    *window;
 	GList       *file_list;
 	gboolean     ask_application;
-	CommandData *cdata;
+	GList       *extracted_files;   /* GFile list, one for each file in file_list */
+	GList       *temp_dirs;         /* GFile list, the folder of each extracted file */
+	GList       *files_to_extract;  /* the files not present in the cache */
+	GFile       *temp_dir;          /* where the files_to_extract are extracted */
+	char        *archive_key;       /* the archive key in the cache */
 } OpenFilesData;
 
 
@@ -9011,28 +9102,110 @@ open_files_data_new (FrWindow *window,
 
 {
 	OpenFilesData *odata;
-	GList         *scan;
 
 	odata = g_new0 (OpenFilesData, 1);
 	odata->ref_count = 1;
 	odata->window = g_object_ref (window);
 	odata->file_list = _g_string_list_dup (file_list);
 	odata->ask_application = ask_application;
-	odata->cdata = g_new0 (CommandData, 1);
-	odata->cdata->temp_dir = _g_file_get_temp_work_dir (NULL);
-	odata->cdata->file_list = NULL;
-	for (scan = file_list; scan; scan = scan->next) {
-		char  *filename = scan->data;
-		GFile *file;
 
-		file = _g_file_append_path (odata->cdata->temp_dir, filename, NULL);
-		odata->cdata->file_list = g_list_prepend (odata->cdata->file_list, file);
+	return odata;
+}
+
+
+/* Reuses the files extracted before, if not modified.  The encrypted files
+ * are always extracted again, to ask the password in every window. */
+static void
+open_files_data_lookup_cache (OpenFilesData *odata)
+{
+	FrWindow *window = odata->window;
+	GList    *scan;
+
+	for (scan = odata->file_list; scan; scan = scan->next) {
+		char     *filename = scan->data;
+		FileData *file_data;
+		GFile    *extracted_file;
+		GFile    *temp_dir;
+
+		file_data = g_hash_table_lookup (window->archive->files_hash, filename);
+		if ((file_data == NULL)
+		    || file_data->encrypted
+		    || ! open_file_cache_lookup (odata->archive_key, file_data, &extracted_file, &temp_dir))
+		{
+			if (odata->temp_dir == NULL)
+				odata->temp_dir = _g_file_get_temp_work_dir (NULL);
+			extracted_file = _g_file_append_path (odata->temp_dir, filename, NULL);
+			temp_dir = g_object_ref (odata->temp_dir);
+			odata->files_to_extract = g_list_prepend (odata->files_to_extract, g_strdup (filename));
+		}
+
+		odata->extracted_files = g_list_prepend (odata->extracted_files, extracted_file);
+		odata->temp_dirs = g_list_prepend (odata->temp_dirs, temp_dir);
 	}
+	odata->extracted_files = g_list_reverse (odata->extracted_files);
+	odata->temp_dirs = g_list_reverse (odata->temp_dirs);
+	odata->files_to_extract = g_list_reverse (odata->files_to_extract);
+}
 
-	/* Add to CommandList so the cdata is released on exit. */
-	CommandList = g_list_prepend (CommandList, odata->cdata);
 
-	return odata;
+static void
+open_files_data_add_to_cache (OpenFilesData *odata)
+{
+	FrWindow *window = odata->window;
+	gboolean  can_cache;
+	gboolean  cached = FALSE;
+	GList    *scan1, *scan2;
+
+	/* the folder is deleted by the cache when its files are removed, so
+	 * the files are cached only if none of them is encrypted. */
+
+	can_cache = (odata->archive_key != NULL);
+	for (scan1 = odata->file_list, scan2 = odata->extracted_files;
+	     can_cache && scan1 && scan2;
+	     scan1 = scan1->next, scan2 = scan2->next)
+	{
+		FileData *file_data;
+
+		if (! g_file_has_prefix (G_FILE (scan2->data), odata->temp_dir))
+			continue;
+
+		file_data = g_hash_table_lookup (window->archive->files_hash, scan1->data);
+		if ((file_data != NULL) && file_data->encrypted)
+			can_cache = FALSE;
+	}
+
+	if (! can_cache) {
+		CommandData *cdata;
+
+		/* Add to CommandList so the folder is removed on exit. */
+
+		cdata = g_new0 (CommandData, 1);
+		cdata->temp_dir = g_object_ref (odata->temp_dir);
+		CommandList = g_list_prepend (CommandList, cdata);
+		return;
+	}
+
+	for (scan1 = odata->file_list, scan2 = odata->extracted_files;
+	     scan1 && scan2;
+	     scan1 = scan1->next, scan2 = scan2->next)
+	{
+		char     *filename = scan1->data;
+		GFile    *extracted_file = scan2->data;
+		FileData *file_data;
+
+		if (! g_file_has_prefix (extracted_file, odata->temp_dir))
+			continue;
+
+		file_data = g_hash_table_lookup (window->archive->files_hash, filename);
+		if ((file_data == NULL) || ! g_file_query_exists (extracted_file, NULL))
+			continue;
+
+		open_file_cache_add (odata->archive_key, file_data, extracted_file, odata->temp_dir);
+		cached = TRUE;
+	}
+
+	if (! cached)
+		_g_file_remove_directory (odata->temp_dir, NULL, NULL);
 }
 
 
@@ -9052,6 +9225,11 @@ open_files_data_unref (OpenFilesData *odata)
 	if (--odata->ref_count > 0)
 		return;
 
+	g_free (odata->archive_key);
+	_g_object_unref (odata->temp_dir);
+	_g_string_list_free (odata->files_to_extract);
+	_g_object_list_unref (odata->temp_dirs);
+	_g_object_list_unref (odata->extracted_files);
 	_g_string_list_free (odata->file_list);
 	g_object_unref (odata->window);
 	g_free (odata);
@@ -9130,22 +9308,13 @@ fr_window_update_files (FrWindow *window,
 
 
 static void
-open_file_modified_cb (GFileMonitor     *monitor,
-		       GFile            *monitor_file,
-		       GFile            *other_file,
-		       GFileMonitorEvent event_type,
-		       gpointer          user_data)
+open_file_modified_cb (GFile    *monitor_file,
+		       gpointer  user_data)
 {
 	FrWindow *window = user_data;
 	OpenFile *file;
 	GList    *scan;
 
-	if ((event_type != G_FILE_MONITOR_EVENT_CHANGED)
-	    && (event_type != G_FILE_MONITOR_EVENT_CREATED))
-	{
-		return;
-	}
-
 	file = NULL;
 	for (scan = window->priv->open_files; scan; scan = scan->next) {
 		OpenFile *test = scan->data;
@@ -9167,12 +9336,28 @@ static void
 fr_window_monitor_open_file (FrWindow *window,
 			     OpenFile *file)
 {
-	window->priv->open_files = g_list_prepend (window->priv->open_files, file);
-	file->monitor = g_file_monitor_file (file->extracted_file, 0, NULL, NULL);
-	g_signal_connect (file->monitor,
-			  "changed",
-			  G_CALLBACK (open_file_modified_cb),
-			  window);
+	GList *scan;
+
+	/* a cached file can be opened again, or by another window: it's
+	 * monitored once and reported to the last window that opened it. */
+
+	for (scan = window->priv->open_files; scan; scan = scan->next) {
+		OpenFile *test = scan->data;
+
+		if (g_file_equal (test->extracted_file, file->extracted_file)) {
+			open_file_free (file);
+			file = test;
+			break;
+		}
+	}
+
+	if (scan == NULL)
+		window->priv->open_files = g_list_prepend (window->priv->open_files, file);
+
+	open_file_cache_monitor (file->extracted_file,
+				 file->temp_dir,
+				 open_file_modified_cb,
+				 window);
 }
 
 
@@ -9180,17 +9365,17 @@ static void
 monitor_extracted_files (OpenFilesData *odata)
 {
 	FrWindow *window = odata->window;
-	GList    *scan1, *scan2;
+	GList    *scan1, *scan2, *scan3;
 
-	for (scan1 = odata->file_list, scan2 = odata->cdata->file_list;
-	     scan1 && scan2;
-	     scan1 = scan1->next, scan2 = scan2->next)
+	for (scan1 = odata->file_list, scan2 = odata->extracted_files, scan3 = odata->temp_dirs;
+	     scan1 && scan2 && scan3;
+	     scan1 = scan1->next, scan2 = scan2->next, scan3 = scan3->next)
 	{
 		char     *original_path = (char *) scan1->data;
 		GFile    *extracted_file = G_FILE (scan2->data);
 		OpenFile *ofile;
 
-		ofile = open_file_new (original_path, extracted_file, odata->cdata->temp_dir);
+		ofile = open_file_new (original_path, extracted_file, G_FILE (scan3->data));
 		if (ofile != NULL)
 			fr_window_monitor_open_file (window, ofile);
 	}
@@ -9200,7 +9385,7 @@ monitor_extracted_files (OpenFilesData *odata)
 static gboolean
 fr_window_open_extracted_files (OpenFilesData *odata)
 {
-	GList               *file_list = odata->cdata->file_list;
+	GList               *file_list = odata->extracted_files;
 	GFile               *first_file;
 	const char          *first_mime_type;
 	GAppInfo            *app;
@@ -9290,25 +9475,42 @@ open_files_extract_ready_cb (GObject      *source_object,
 	fr_archive_operation_finish (FR_ARCHIVE (source_object), result, &error);
 	_archive_operation_completed (odata->window, FR_ACTION_EXTRACTING_FILES, error);
 
-	if (error == NULL)
+	if (error == NULL) {
+		open_files_data_add_to_cache (odata);
 		fr_window_open_extracted_files (odata);
+	}
+	else
+		_g_file_remove_directory (odata->temp_dir, NULL, NULL);
 
 	open_files_data_unref (odata);
 	_g_error_free (error);
 }
 
 
-void
-fr_window_open_files (FrWindow *window,
-		      GList    *file_list,
-		      gboolean  ask_application)
+static void
+open_files_archive_key_ready_cb (char     *archive_key,
+				 gpointer  user_data)
 {
-	OpenFilesData *odata;
+	OpenFilesData *odata = user_data;
+	FrWindow      *window = odata->window;
 
-	if (window->priv->activity_ref > 0)
+	odata->archive_key = archive_key;
+
+	/* the archive can be closed while it is queried */
+
+	if (window->archive == NULL) {
+		open_files_data_unref (odata);
 		return;
+	}
+
+	open_files_data_lookup_cache (odata);
+
+	if (odata->files_to_extract == NULL) {
+		fr_window_open_extracted_files (odata);
+		open_files_data_unref (odata);
+		return;
+	}
 
-	odata = open_files_data_new (window, file_list, ask_application);
 	fr_window_set_current_action (window,
 					    FR_BATCH_ACTION_OPEN_FILES,
 					    odata,
@@ -9317,8 +9519,8 @@ fr_window_open_files (FrWindow *window,
 	_archive_operation_started (odata->window, FR_ACTION_EXTRACTING_FILES);
 
 	fr_archive_extract (window->archive,
-			    odata->file_list,
-			    odata->cdata->temp_dir,
+			    odata->files_to_extract,
+			    odata->temp_dir,
 			    NULL,
 			    FALSE,
 			    TRUE,
@@ -9330,6 +9532,26 @@ fr_window_open_files (FrWindow *window,
 }
 
 
+void
+fr_window_open_files (FrWindow *window,
+		      GList    *file_list,
+		      gboolean  ask_application)
+{
+	OpenFilesData *odata;
+
+	if (window->priv->activity_ref > 0)
+		return;
+
+	/* the archive is queried asynchronously, it can be a remote file. */
+
+	odata = open_files_data_new (window, file_list, ask_application);
+	open_file_cache_get_archive_key (window->archive,
+					 NULL,
+					 open_files_archive_key_ready_cb,
+					 odata);
+}
+
+
 /**/
 
 
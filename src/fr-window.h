@@ -123,6 +123,7 @@ FrWindow *      fr_window_archive_open                 (FrWindow      *window,
 void            fr_window_archive_close                (FrWindow      *window);
 GFile *         fr_window_get_archive_file             (FrWindow      *window);
 GFile *         fr_window_get_archive_file_for_paste   (FrWindow      *window);
+FrAction        fr_window_get_archive_action           (FrWindow      *window);
 gboolean        fr_window_archive_is_present           (FrWindow      *window);
 void            fr_window_archive_reload               (FrWindow      *window);
 void            fr_window_archive_add_files            (FrWindow      *window,
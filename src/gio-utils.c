@@ -28,11 +28,24 @@
 #include "glib-utils.h"
 
 #define N_FILES_PER_REQUEST 128
+#define MAX_RUNNING_ENUMERATORS 8
 
 
 /* FileInfo */
 
 
+static GQuark
+file_info_quark (void)
+{
+	static GQuark quark = 0;
+
+	if (quark == 0)
+		quark = g_quark_from_static_string ("file-roller-file-info");
+
+	return quark;
+}
+
+
 FileInfo *
 file_info_new (GFile     *file,
 	       GFileInfo *info)
@@ -58,6 +71,26 @@ file_info_free (FileInfo *file_info)
 }
 
 
+/* Attaches @info to @file, to avoid querying the same attributes again
+ * later. */
+void
+_g_file_set_cached_info (GFile     *file,
+			 GFileInfo *info)
+{
+	g_object_set_qdata_full (G_OBJECT (file),
+				 file_info_quark (),
+				 _g_object_ref (info),
+				 _g_object_unref);
+}
+
+
+GFileInfo *
+_g_file_get_cached_info (GFile *file)
+{
+	return g_object_get_qdata (G_OBJECT (file), file_info_quark ());
+}
+
+
 void
 file_info_list_free (GList *list)
 {
@@ -69,24 +102,123 @@ file_info_list_free (GList *list)
 /* -- filter -- */
 
 
+/* Characters with a special meaning in the patterns, other than '*'. */
+#define COMPLEX_PATTERN_CHARS "\\^$|?+()[]{}"
+
+
+/* A pattern matches any part of the file name, as it always did, so the
+ * filters saved in the settings and in the option files keep their
+ * meaning: '*.o' matches 'foo.o' and 'foo.orig'. */
 struct _FileFilter {
-	int      ref_count;
-	char    *pattern;
-	GRegex **regexps;
+	int          ref_count;
+	char        *pattern;
+	gboolean     match_all;
+	GPtrArray   *substrings;      /* the patterns without other '*' */
+	GRegex     **regexps;         /* any other pattern */
 };
 
 
+static gboolean
+_g_ascii_str_case_contains (const char *haystack,
+			    const char *needle,
+			    gsize       needle_len)
+{
+	for (; *haystack != '\0'; haystack++)
+		if (g_ascii_strncasecmp (haystack, needle, needle_len) == 0)
+			return TRUE;
+
+	return FALSE;
+}
+
+
+/* Whether the pattern contains only printable ascii characters and '*' is
+ * used only at the beginning or at the end. */
+static gboolean
+_pattern_is_simple (const char *pattern,
+		    const char *body,
+		    gsize       body_len)
+{
+	const char *p;
+
+	for (p = pattern; *p != '\0'; p++) {
+		if (! g_ascii_isprint (*p) || (strchr (COMPLEX_PATTERN_CHARS, *p) != NULL))
+			return FALSE;
+	}
+
+	return memchr (body, '*', body_len) == NULL;
+}
+
+
+static void
+file_filter_add_pattern (FileFilter *filter,
+			 GPtrArray  *regexps,
+			 const char *pattern)
+{
+	const char *body;
+	gsize       body_len;
+
+	if (pattern[0] == '\0')
+		return;
+
+	/* the leading and trailing '*' don't change the matched names */
+
+	body = pattern;
+	while (*body == '*')
+		body++;
+	body_len = strlen (body);
+	while ((body_len > 0) && (body[body_len - 1] == '*'))
+		body_len--;
+
+	if (body_len == 0) {
+		filter->match_all = TRUE;
+	}
+	else if (_pattern_is_simple (pattern, body, body_len)) {
+		g_ptr_array_add (filter->substrings, g_strndup (body, body_len));
+	}
+	else {
+		char   *p1;
+		char   *p2;
+		GRegex *regex;
+
+		p1 = _g_str_substitute (pattern, ".", "\\.");
+		p2 = _g_str_substitute (p1, "*", ".*");
+		regex = g_regex_new (p2,
+				     G_REGEX_OPTIMIZE | G_REGEX_CASELESS,
+				     G_REGEX_MATCH_NOTEMPTY,
+				     NULL);
+		if (regex != NULL)
+			g_ptr_array_add (regexps, regex);
+
+		g_free (p2);
+		g_free (p1);
+	}
+}
+
+
 FileFilter *
 file_filter_new (const char *pattern)
 {
-	FileFilter *filter;
+	FileFilter  *filter;
+	char       **patterns;
+	GPtrArray   *regexps;
+	int          i;
 
 	filter = g_new0 (FileFilter, 1);
 	filter->ref_count = 1;
 	if ((pattern != NULL) && (strcmp (pattern, "*") != 0))
 		filter->pattern = g_strdup (pattern);
 
-	filter->regexps = _g_regexp_split_from_patterns (pattern, G_REGEX_CASELESS);
+	filter->substrings = g_ptr_array_new_with_free_func (g_free);
+
+	regexps = g_ptr_array_new ();
+	if (filter->pattern != NULL) {
+		patterns = g_strsplit (filter->pattern, ";", -1);
+		for (i = 0; patterns[i] != NULL; i++)
+			file_filter_add_pattern (filter, regexps, g_strstrip (patterns[i]));
+		g_strfreev (patterns);
+	}
+	g_ptr_array_add (regexps, NULL);
+	filter->regexps = (GRegex **) g_ptr_array_free (regexps, FALSE);
 
 	return filter;
 }
@@ -101,17 +233,68 @@ file_filter_unref (FileFilter *filter)
 		return;
 
 	g_free (filter->pattern);
+	g_ptr_array_unref (filter->substrings);
 	_g_regexp_freev (filter->regexps);
 	g_free (filter);
 }
 
 
+/* Matches any part of the file name, ignoring the case.  @name is the file
+ * name in the file system encoding. */
+gboolean
+file_filter_matches_name (FileFilter *filter,
+			  const char *name)
+{
+	guint    i;
+	gboolean matched;
+
+	g_return_val_if_fail (name != NULL, FALSE);
+
+	if ((filter->pattern == NULL) || filter->match_all)
+		return TRUE;
+
+	for (i = 0; i < filter->substrings->len; i++) {
+		const char *substring = g_ptr_array_index (filter->substrings, i);
+
+		if (_g_ascii_str_case_contains (name, substring, strlen (substring)))
+			return TRUE;
+	}
+
+	if (filter->regexps[0] == NULL)
+		return FALSE;
+
+	if (g_utf8_validate (name, -1, NULL)) {
+		matched = _g_regexp_matchv (filter->regexps, name, 0);
+	}
+	else {
+		char *utf8_name;
+
+		utf8_name = g_filename_to_utf8 (name, -1, NULL, NULL, NULL);
+		matched = (utf8_name != NULL) && _g_regexp_matchv (filter->regexps, utf8_name, 0);
+		g_free (utf8_name);
+	}
+
+	return matched;
+}
+
+
+gboolean
+file_filter_matches_info (FileFilter *filter,
+			  GFile      *file,
+			  GFileInfo  *info)
+{
+	if ((info != NULL) && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_NAME))
+		return file_filter_matches_name (filter, g_file_info_get_name (info));
+	else
+		return file_filter_matches (filter, file);
+}
+
+
 gboolean
 file_filter_matches (FileFilter *filter,
 		     GFile      *file)
 {
 	char     *file_name;
-	char     *utf8_name;
 	gboolean  matched;
 
 	g_return_val_if_fail (file != NULL, FALSE);
@@ -120,10 +303,8 @@ file_filter_matches (FileFilter *filter,
 		return TRUE;
 
 	file_name = g_file_get_basename (file);
-	utf8_name = g_filename_to_utf8 (file_name, -1, NULL, NULL, NULL);
-	matched = _g_regexp_matchv (filter->regexps, utf8_name, 0);
+	matched = file_filter_matches_name (filter, file_name);
 
-	g_free (utf8_name);
 	g_free (file_name);
 
 	return matched;
@@ -140,15 +321,6 @@ file_filter_empty (FileFilter *filter)
 /* -- g_directory_foreach_child -- */
 
 
-static void
-_g_info_data_freev (FileInfo **data)
-{
-	if (*data != NULL)
-		file_info_free (*data);
-	*data = NULL;
-}
-
-
 typedef struct {
 	GFile                *base_directory;
 	gboolean              recursive;
@@ -160,19 +332,25 @@ typedef struct {
 
 	/* private */
 
-	FileInfo            *current;
 	GHashTable           *already_visited;
-	GList                *to_visit;
+	GQueue               *to_visit;
 	char                 *attributes;
 	GCancellable         *cancellable;
-	GFileEnumerator      *enumerator;
 	GError               *error;
 	guint                 source_id;
-	GList                *children;
-	GList                *current_child;
+	int                   n_running;    /* number of directories being
+					     * enumerated. */
+	gboolean              stopped;
 } ForEachChildData;
 
 
+typedef struct {
+	ForEachChildData     *fec;
+	FileInfo             *directory;
+	GFileEnumerator      *enumerator;
+} ForEachChildJob;
+
+
 static void
 for_each_child_data_free (ForEachChildData *fec)
 {
@@ -182,12 +360,8 @@ for_each_child_data_free (ForEachChildData *fec)
 	g_object_unref (fec->base_directory);
 	if (fec->already_visited != NULL)
 		g_hash_table_destroy (fec->already_visited);
-	_g_info_data_freev (&(fec->current));
 	g_free (fec->attributes);
-	if (fec->to_visit != NULL) {
-		g_list_foreach (fec->to_visit, (GFunc) file_info_free, NULL);
-		g_list_free (fec->to_visit);
-	}
+	g_queue_free_full (fec->to_visit, (GDestroyNotify) file_info_free);
 	_g_object_unref (fec->cancellable);
 	g_free (fec);
 }
@@ -199,7 +373,6 @@ for_each_child_done_cb (gpointer user_data)
 	ForEachChildData *fec = user_data;
 
 	g_source_remove (fec->source_id);
-	_g_info_data_freev (&(fec->current));
 	if (fec->done_func)
 		fec->done_func (fec->error, fec->user_data);
 	for_each_child_data_free (fec);
@@ -215,88 +388,96 @@ for_each_child_done (ForEachChildData *fec)
 }
 
 
-static void for_each_child_start_current (ForEachChildData *fec);
-
-
 static void
-for_each_child_start (ForEachChildData *fec)
+for_each_child_set_error (ForEachChildData  *fec,
+			  GError           **error)
 {
-	for_each_child_start_current (fec);
-}
+	if (*error == NULL)
+		return;
 
+	if (fec->error == NULL)
+		fec->error = *error;
+	else
+		g_error_free (*error);
+	*error = NULL;
 
-static void
-for_each_child_set_current (ForEachChildData *fec,
-			    FileInfo        *data)
-{
-	_g_info_data_freev (&(fec->current));
-	fec->current = data;
+	fec->stopped = TRUE;
 }
 
 
+static void for_each_child_job_start (ForEachChildJob *job);
+
+
+/* Starts enumerating the queued directories, up to
+ * MAX_RUNNING_ENUMERATORS at the same time.  The callbacks are always
+ * invoked in the main thread, so no locking is required. */
 static void
-for_each_child_start_next_sub_directory (ForEachChildData *fec)
+for_each_child_start_next_sub_directories (ForEachChildData *fec)
 {
-	FileInfo *child = NULL;
+	while (! fec->stopped
+	       && (fec->n_running < MAX_RUNNING_ENUMERATORS)
+	       && ! g_queue_is_empty (fec->to_visit))
+	{
+		FileInfo        *directory;
+		ForEachChildJob *job;
 
-	if (fec->to_visit != NULL) {
-		GList *tmp;
+		directory = g_queue_pop_head (fec->to_visit);
 
-		child = (FileInfo *) fec->to_visit->data;
-		tmp = fec->to_visit;
-		fec->to_visit = g_list_remove_link (fec->to_visit, tmp);
-		g_list_free (tmp);
-	}
+		if (fec->start_dir_func != NULL) {
+			DirOp   op;
+			GError *error = NULL;
+
+			op = fec->start_dir_func (directory->file, directory->info, &error, fec->user_data);
+			for_each_child_set_error (fec, &error);
 
-	if (child != NULL) {
-		for_each_child_set_current (fec, child);
-		for_each_child_start (fec);
+			if (op != DIR_OP_CONTINUE) {
+				if (op == DIR_OP_STOP)
+					fec->stopped = TRUE;
+				file_info_free (directory);
+				continue;
+			}
+		}
+
+		job = g_new0 (ForEachChildJob, 1);
+		job->fec = fec;
+		job->directory = directory;
+		job->enumerator = NULL;
+
+		fec->n_running++;
+		for_each_child_job_start (job);
 	}
-	else
+
+	if (fec->n_running == 0)
 		for_each_child_done (fec);
 }
 
 
 static void
-for_each_child_close_enumerator (GObject      *source_object,
-				 GAsyncResult *result,
-		      		 gpointer      user_data)
+for_each_child_job_done (ForEachChildJob *job)
 {
-	ForEachChildData *fec = user_data;
-	GError           *error = NULL;
+	ForEachChildData *fec = job->fec;
 
-	if (! g_file_enumerator_close_finish (fec->enumerator,
-					      result,
-					      &error))
-	{
-		if (fec->error == NULL)
-			fec->error = g_error_copy (error);
-		g_clear_error (&error);
-	}
+	_g_object_unref (job->enumerator);
+	file_info_free (job->directory);
+	g_free (job);
 
-	if ((fec->error == NULL) && fec->recursive)
-		for_each_child_start_next_sub_directory (fec);
-	else
-		for_each_child_done (fec);
+	fec->n_running--;
+	for_each_child_start_next_sub_directories (fec);
 }
 
 
-static void for_each_child_next_files_ready (GObject      *source_object,
-					     GAsyncResult *result,
-					     gpointer      user_data);
-
-
 static void
-for_each_child_read_next_files (ForEachChildData *fec)
+for_each_child_close_enumerator (GObject      *source_object,
+				 GAsyncResult *result,
+		      		 gpointer      user_data)
 {
-	_g_object_list_unref (fec->children);
-	fec->children = NULL;
-	g_file_enumerator_next_files_async (fec->enumerator,
-					    N_FILES_PER_REQUEST,
-					    G_PRIORITY_DEFAULT,
-					    fec->cancellable,
-					    for_each_child_next_files_ready,
-					    fec);
+	ForEachChildJob *job = user_data;
+	GError          *error = NULL;
+
+	g_file_enumerator_close_finish (job->enumerator, result, &error);
+	for_each_child_set_error (job->fec, &error);
+
+	for_each_child_job_done (job);
 }
 
 
@@ -305,7 +486,7 @@ for_each_child_compute_child (ForEachChildData *fec,
 			      GFile            *file,
 			      GFileInfo        *info)
 {
-	if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+	if (fec->recursive && (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)) {
 		char *id;
 
 		/* avoid to visit a directory more than ones */
@@ -316,7 +497,7 @@ for_each_child_compute_child (ForEachChildData *fec,
 
 		if (g_hash_table_lookup (fec->already_visited, id) == NULL) {
 			g_hash_table_insert (fec->already_visited, g_strdup (id), GINT_TO_POINTER (1));
-			fec->to_visit = g_list_append (fec->to_visit, file_info_new (file, info));
+			g_queue_push_tail (fec->to_visit, file_info_new (file, info));
 		}
 
 		g_free (id);
@@ -331,33 +512,49 @@ for_each_child_next_files_ready (GObject      *source_object,
 				 GAsyncResult *result,
 				 gpointer      user_data)
 {
-	ForEachChildData *fec = user_data;
+	ForEachChildJob  *job = user_data;
+	ForEachChildData *fec = job->fec;
+	GList            *children;
 	GList            *scan;
+	GError           *error = NULL;
 
-	fec->children = g_file_enumerator_next_files_finish (fec->enumerator,
-							     result,
-							     &(fec->error));
+	children = g_file_enumerator_next_files_finish (job->enumerator,
+							result,
+							&error);
+	for_each_child_set_error (fec, &error);
 
-	if (fec->children == NULL) {
-		g_file_enumerator_close_async (fec->enumerator,
+	if ((children == NULL) || fec->stopped) {
+		_g_object_list_unref (children);
+		g_file_enumerator_close_async (job->enumerator,
 					       G_PRIORITY_DEFAULT,
 					       g_cancellable_is_cancelled (fec->cancellable) ? NULL : fec->cancellable,
 					       for_each_child_close_enumerator,
-					       fec);
+					       job);
 		return;
 	}
 
-	for (scan = fec->children; scan; scan = scan->next) {
+	for (scan = children; scan; scan = scan->next) {
 		GFileInfo *child_info = scan->data;
 		GFile     *child_file;
 
-		child_file = g_file_get_child (fec->current->file, g_file_info_get_name (child_info));
+		child_file = g_file_get_child (job->directory->file, g_file_info_get_name (child_info));
 		for_each_child_compute_child (fec, child_file, child_info);
 
 		g_object_unref (child_file);
 	}
+	_g_object_list_unref (children);
+
+	/* start to visit the new sub-directories while this one is still
+	 * being read. */
 
-	for_each_child_read_next_files (fec);
+	for_each_child_start_next_sub_directories (fec);
+
+	g_file_enumerator_next_files_async (job->enumerator,
+					    N_FILES_PER_REQUEST,
+					    G_PRIORITY_DEFAULT,
+					    fec->cancellable,
+					    for_each_child_next_files_ready,
+					    job);
 }
 
 
@@ -366,49 +563,38 @@ for_each_child_ready (GObject      *source_object,
 		      GAsyncResult *result,
 		      gpointer      user_data)
 {
-	ForEachChildData *fec = user_data;
+	ForEachChildJob  *job = user_data;
+	ForEachChildData *fec = job->fec;
+	GError           *error = NULL;
 
-	fec->enumerator = g_file_enumerate_children_finish (G_FILE (source_object), result, &(fec->error));
-	if (fec->enumerator == NULL) {
-		for_each_child_done (fec);
+	job->enumerator = g_file_enumerate_children_finish (G_FILE (source_object), result, &error);
+	if (job->enumerator == NULL) {
+		for_each_child_set_error (fec, &error);
+		for_each_child_job_done (job);
 		return;
 	}
 
-	g_file_enumerator_next_files_async (fec->enumerator,
+	g_file_enumerator_next_files_async (job->enumerator,
 					    N_FILES_PER_REQUEST,
 					    G_PRIORITY_DEFAULT,
 					    fec->cancellable,
 					    for_each_child_next_files_ready,
-					    fec);
+					    job);
 }
 
 
 static void
-for_each_child_start_current (ForEachChildData *fec)
-{
-	if (fec->start_dir_func != NULL) {
-		DirOp  op;
-
-		op = fec->start_dir_func (fec->current->file, fec->current->info, &(fec->error), fec->user_data);
-		switch (op) {
-		case DIR_OP_SKIP:
-			for_each_child_start_next_sub_directory (fec);
-			return;
-		case DIR_OP_STOP:
-			for_each_child_done (fec);
-			return;
-		case DIR_OP_CONTINUE:
-			break;
-		}
-	}
+for_each_child_job_start (ForEachChildJob *job)
+{
+	ForEachChildData *fec = job->fec;
 
-	g_file_enumerate_children_async (fec->current->file,
+	g_file_enumerate_children_async (job->directory->file,
 					 fec->attributes,
 					 fec->follow_links ? G_FILE_QUERY_INFO_NONE : G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
 					 G_PRIORITY_DEFAULT,
 					 fec->cancellable,
 					 for_each_child_ready,
-					 fec);
+					 job);
 }
 
 
@@ -419,7 +605,6 @@ directory_info_ready_cb (GObject      *source_object,
 {
 	ForEachChildData *fec = user_data;
 	GFileInfo        *info;
-	FileInfo        *child;
 
 	info = g_file_query_info_finish (G_FILE (source_object), result, &(fec->error));
 	if (info == NULL) {
@@ -427,11 +612,10 @@ directory_info_ready_cb (GObject      *source_object,
 		return;
 	}
 
-	child = file_info_new (fec->base_directory, info);
+	g_queue_push_tail (fec->to_visit, file_info_new (fec->base_directory, info));
 	g_object_unref (info);
 
-	for_each_child_set_current (fec, child);
-	for_each_child_start_current (fec);
+	for_each_child_start_next_sub_directories (fec);
 }
 
 
@@ -457,6 +641,9 @@ directory_info_ready_cb (GObject      *source_object,
  * Some traversing options are available: if @recursive is TRUE the
  * directory is traversed recursively; if @follow_links is TRUE, symbolic
  * links are dereferenced, otherwise they are returned as links.
+ * Up to MAX_RUNNING_ENUMERATORS sub-directories are enumerated at the same
+ * time, so the files of different directories can be reported in any
+ * order, but a directory is always started before its children.
  * Each callback uses the same @user_data additional parameter.
  */
 void
@@ -492,6 +679,9 @@ g_directory_foreach_child (GFile                *directory,
 						      g_str_equal,
 						      g_free,
 						      NULL);
+	fec->to_visit = g_queue_new ();
+	fec->n_running = 0;
+	fec->stopped = FALSE;
 
 	g_file_query_info_async (fec->base_directory,
 				 fec->attributes,
@@ -514,6 +704,8 @@ typedef struct {
 	FilterMatchCallback  directory_filter_func;
 	FilterMatchCallback  file_filter_func;
 	InfoReadyCallback    callback;
+	ForEachChildCallback for_each_file_func;
+	ForEachDoneCallback  done_func;
 	gpointer             user_data;
 	GList               *current;
 	GList               *files;
@@ -534,6 +726,36 @@ query_data_free (QueryData *query_data)
 static void query_info__query_current (QueryData *query_data);
 
 
+static void
+query_data_add_file (QueryData *query_data,
+		     GFile     *file,
+		     GFileInfo *info)
+{
+	if (query_data->for_each_file_func != NULL)
+		query_data->for_each_file_func (file, info, query_data->user_data);
+	else
+		query_data->files = g_list_prepend (query_data->files, file_info_new (file, info));
+}
+
+
+static void
+query_data_complete (QueryData *query_data,
+		     GError    *error)
+{
+	if (query_data->done_func != NULL) {
+		query_data->done_func (error, query_data->user_data);
+	}
+	else if (error != NULL) {
+		query_data->callback (NULL, error, query_data->user_data);
+	}
+	else {
+		query_data->files = g_list_reverse (query_data->files);
+		query_data->callback (query_data->files, NULL, query_data->user_data);
+	}
+	query_data_free (query_data);
+}
+
+
 static void
 query_info__query_next (QueryData *query_data)
 {
@@ -549,8 +771,7 @@ query_data__done_cb (GError   *error,
 	QueryData *query_data = user_data;
 
 	if (error != NULL) {
-		query_data->callback (NULL, error, query_data->user_data);
-		query_data_free (query_data);
+		query_data_complete (query_data, error);
 		return;
 	}
 
@@ -574,7 +795,7 @@ query_data__for_each_file_cb (GFile      *file,
 	if ((query_data->file_filter_func != NULL) && query_data->file_filter_func (file, info, query_data->user_data))
 		return;
 
-	query_data->files = g_list_prepend (query_data->files, file_info_new (file, info));
+	query_data_add_file (query_data, file, info);
 }
 
 
@@ -593,7 +814,7 @@ query_data__start_dir_cb (GFile       *file,
 	if ((query_data->directory_filter_func != NULL) && query_data->directory_filter_func (file, info, query_data->user_data))
 		return DIR_OP_SKIP;
 
-	query_data->files = g_list_prepend (query_data->files, file_info_new (file, info));
+	query_data_add_file (query_data, file, info);
 
 	return DIR_OP_CONTINUE;
 }
@@ -630,7 +851,7 @@ query_data_info_ready_cb (GObject      *source_object,
 					   query_data);
 	}
 	else {
-		query_data->files = g_list_prepend (query_data->files, file_info_new ((GFile *) query_data->current->data, info));
+		query_data_add_file (query_data, (GFile *) query_data->current->data, info);
 		query_info__query_next (query_data);
 	}
 
@@ -644,9 +865,7 @@ query_info__query_current (QueryData *query_data)
 	GFileQueryInfoFlags flags;
 
 	if (query_data->current == NULL) {
-		query_data->files = g_list_reverse (query_data->files);
-		query_data->callback (query_data->files, NULL, query_data->user_data);
-		query_data_free (query_data);
+		query_data_complete (query_data, NULL);
 		return;
 	}
 
@@ -664,15 +883,14 @@ query_info__query_current (QueryData *query_data)
 }
 
 
-void
-_g_file_list_query_info_async (GList               *file_list,
-			       FileListFlags        flags,
-			       const char          *attributes,
-			       GCancellable        *cancellable,
-			       FilterMatchCallback  directory_filter_func,
-			       FilterMatchCallback  file_filter_func,
-			       InfoReadyCallback    ready_callback,
-			       gpointer             user_data)
+static QueryData *
+query_data_new (GList               *file_list,
+		FileListFlags        flags,
+		const char          *attributes,
+		GCancellable        *cancellable,
+		FilterMatchCallback  directory_filter_func,
+		FilterMatchCallback  file_filter_func,
+		gpointer             user_data)
 {
 	QueryData *query_data;
 
@@ -686,10 +904,66 @@ _g_file_list_query_info_async (GList               *file_list,
 	query_data->cancellable = _g_object_ref (cancellable);
 	query_data->directory_filter_func = directory_filter_func;
 	query_data->file_filter_func = file_filter_func;
-	query_data->callback = ready_callback;
 	query_data->user_data = user_data;
-
 	query_data->current = query_data->file_list;
+
+	return query_data;
+}
+
+
+void
+_g_file_list_query_info_async (GList               *file_list,
+			       FileListFlags        flags,
+			       const char          *attributes,
+			       GCancellable        *cancellable,
+			       FilterMatchCallback  directory_filter_func,
+			       FilterMatchCallback  file_filter_func,
+			       InfoReadyCallback    ready_callback,
+			       gpointer             user_data)
+{
+	QueryData *query_data;
+
+	query_data = query_data_new (file_list,
+				     flags,
+				     attributes,
+				     cancellable,
+				     directory_filter_func,
+				     file_filter_func,
+				     user_data);
+	query_data->callback = ready_callback;
+	query_info__query_current (query_data);
+}
+
+
+/* Same as _g_file_list_query_info_async but each file is passed to
+ * @for_each_file_func as soon as it's found, instead of collecting all
+ * the files in a list.  The directories are always reported before their
+ * content. */
+void
+_g_file_list_foreach_async (GList                *file_list,
+			    FileListFlags         flags,
+			    const char           *attributes,
+			    GCancellable         *cancellable,
+			    FilterMatchCallback   directory_filter_func,
+			    FilterMatchCallback   file_filter_func,
+			    ForEachChildCallback  for_each_file_func,
+			    ForEachDoneCallback   done_func,
+			    gpointer              user_data)
+{
+	QueryData *query_data;
+
+	g_return_if_fail (for_each_file_func != NULL);
+	g_return_if_fail (done_func != NULL);
+
+	query_data = query_data_new (file_list,
+				     flags,
+				     attributes,
+				     cancellable,
+				     directory_filter_func,
+				     file_filter_func,
+				     user_data);
+	query_data->for_each_file_func = for_each_file_func;
+	query_data->done_func = done_func;
 	query_info__query_current (query_data);
 }
 
@@ -697,22 +971,57 @@ _g_file_list_query_info_async (GList               *file_list,
 /* -- g_copy_files_async -- */
 
 
+#define MAX_RUNNING_COPIES 4
+
+
+typedef struct _CopyFilesData CopyFilesData;
+
+
 typedef struct {
-	GList                 *sources;
-	GList                 *destinations;
+	CopyFilesData *cfd;
+	GFile         *source;
+	GFile         *destination;
+	int            index;
+	gboolean       is_regular;
+	goffset        size;
+	goffset        current_num_bytes;
+	goffset        total_num_bytes;
+} CopyFileJob;
+
+
+struct _CopyFilesData {
+	GList                 *jobs;
 	GFileCopyFlags         flags;
 	int                    io_priority;
+	int                    max_jobs;
+	gboolean               largest_first;
 	GCancellable          *cancellable;
+	GCancellable          *user_cancellable;
+	gulong                 cancelled_id;
 	CopyProgressCallback   progress_callback;
 	gpointer               progress_callback_data;
 	CopyDoneCallback       callback;
 	gpointer               user_data;
+	GError                *error;
 
-	GList                 *source;
-	GList                 *destination;
-	int                    n_file;
+	GList                 *next_job;
+	GList                 *running;
+	int                    n_running;
+	int                    n_completed;
 	int                    tot_files;
-} CopyFilesData;
+	goffset                completed_bytes;
+	goffset                tot_bytes;         /* 0 if unknown */
+};
+
+
+static void
+copy_files_cancelled_cb (GCancellable *cancellable,
+			 gpointer      user_data)
+{
+	CopyFilesData *cfd = user_data;
+
+	g_cancellable_cancel (cfd->cancellable);
+}
 
 
 static CopyFilesData*
@@ -720,6 +1029,8 @@ copy_files_data_new (GList                 *sources,
 		     GList                 *destinations,
 		     GFileCopyFlags         flags,
 		     int                    io_priority,
+		     int                    max_jobs,
+		     gboolean               largest_first,
 		     GCancellable          *cancellable,
 		     CopyProgressCallback   progress_callback,
 		     gpointer               progress_callback_data,
@@ -727,136 +1038,353 @@ copy_files_data_new (GList                 *sources,
 		     gpointer               user_data)
 {
 	CopyFilesData *cfd;
+	GList         *scan_source;
+	GList         *scan_destination;
 
 	cfd = g_new0 (CopyFilesData, 1);
-	cfd->sources = _g_file_list_dup (sources);
-	cfd->destinations = _g_file_list_dup (destinations);
 	cfd->flags = flags;
 	cfd->io_priority = io_priority;
-	cfd->cancellable = cancellable;
+	cfd->max_jobs = MAX (max_jobs, 1);
+	cfd->largest_first = largest_first;
+	cfd->cancellable = g_cancellable_new ();
+	cfd->user_cancellable = _g_object_ref (cancellable);
 	cfd->progress_callback = progress_callback;
 	cfd->progress_callback_data = progress_callback_data;
 	cfd->callback = callback;
 	cfd->user_data = user_data;
 
-	cfd->source = cfd->sources;
-	cfd->destination = cfd->destinations;
-	cfd->n_file = 1;
-	cfd->tot_files = g_list_length (cfd->sources);
+	for (scan_source = sources, scan_destination = destinations;
+	     (scan_source != NULL) && (scan_destination != NULL);
+	     scan_source = scan_source->next, scan_destination = scan_destination->next)
+	{
+		CopyFileJob *job;
+
+		job = g_new0 (CopyFileJob, 1);
+		job->cfd = cfd;
+		job->source = g_object_ref (scan_source->data);
+		job->destination = g_object_ref (scan_destination->data);
+		job->index = cfd->tot_files;
+		job->size = -1;
+		cfd->jobs = g_list_prepend (cfd->jobs, job);
+		cfd->tot_files++;
+	}
+	cfd->jobs = g_list_reverse (cfd->jobs);
+	cfd->next_job = cfd->jobs;
+
+	/* connect after the jobs are created, the callback is called
+	 * immediately if the operation is already cancelled. */
+
+	if (cfd->user_cancellable != NULL)
+		cfd->cancelled_id = g_cancellable_connect (cfd->user_cancellable,
+							   G_CALLBACK (copy_files_cancelled_cb),
+							   cfd,
+							   NULL);
 
 	return cfd;
 }
 
 
+static void
+copy_file_job_free (CopyFileJob *job)
+{
+	g_object_unref (job->source);
+	g_object_unref (job->destination);
+	g_free (job);
+}
+
+
 static void
 copy_files_data_free (CopyFilesData *cfd)
 {
 	if (cfd == NULL)
 		return;
-	_g_file_list_free (cfd->sources);
-	_g_file_list_free (cfd->destinations);
+	if (cfd->user_cancellable != NULL) {
+		g_cancellable_disconnect (cfd->user_cancellable, cfd->cancelled_id);
+		g_object_unref (cfd->user_cancellable);
+	}
+	g_list_free_full (cfd->jobs, (GDestroyNotify) copy_file_job_free);
+	g_list_free (cfd->running);
+	g_object_unref (cfd->cancellable);
+	g_clear_error (&cfd->error);
 	g_free (cfd);
 }
 
 
-static void g_copy_current_file (CopyFilesData *cfd);
+static void
+copy_files_set_error (CopyFilesData *cfd,
+		      GError        *error)
+{
+	if (cfd->error == NULL) {
+		cfd->error = error;
+		/* stop the running copies as well. */
+		g_cancellable_cancel (cfd->cancellable);
+	}
+	else
+		g_error_free (error);
+}
 
 
 static void
-g_copy_next_file (CopyFilesData *cfd)
+g_copy_files_progess_cb (goffset  current_num_bytes,
+                         goffset  total_num_bytes,
+                         gpointer user_data)
 {
-	cfd->source = g_list_next (cfd->source);
-	cfd->destination = g_list_next (cfd->destination);
-	cfd->n_file++;
+	CopyFileJob   *job = user_data;
+	CopyFilesData *cfd = job->cfd;
+	goffset        current_bytes;
+	goffset        tot_bytes;
+	GList         *scan;
+
+	job->current_num_bytes = current_num_bytes;
+	job->total_num_bytes = total_num_bytes;
 
-	g_copy_current_file (cfd);
+	if (cfd->progress_callback == NULL)
+		return;
+
+	/* report the progress of all the running copies */
+
+	current_bytes = cfd->completed_bytes;
+	tot_bytes = cfd->completed_bytes;
+	for (scan = cfd->running; scan; scan = scan->next) {
+		CopyFileJob *running_job = scan->data;
+
+		current_bytes += running_job->current_num_bytes;
+		tot_bytes += running_job->total_num_bytes;
+	}
+	if (cfd->tot_bytes > 0)
+		tot_bytes = cfd->tot_bytes;
+
+	cfd->progress_callback (MIN (cfd->n_completed + 1, cfd->tot_files),
+				cfd->tot_files,
+				job->source,
+				job->destination,
+				current_bytes,
+				tot_bytes,
+				cfd->progress_callback_data);
 }
 
 
+static void g_copy_files_start_next (CopyFilesData *cfd);
+
+
 static void
 g_copy_files_ready_cb (GObject      *source_object,
                        GAsyncResult *result,
                        gpointer      user_data)
 {
-	CopyFilesData *cfd = user_data;
-	GFile         *source = cfd->source->data;
+	CopyFileJob   *job = user_data;
+	CopyFilesData *cfd = job->cfd;
 	GError        *error = NULL;
 
-	if (! g_file_copy_finish (source, result, &error)) {
+	if (! g_file_copy_finish (job->source, result, &error)) {
 		/* source and target are directories, ignore the error */
 		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_MERGE))
 			g_clear_error (&error);
 		/* source is directory, create target directory */
 		if (g_error_matches (error, G_IO_ERROR,  G_IO_ERROR_WOULD_RECURSE)) {
 			g_clear_error (&error);
-			g_file_make_directory ((GFile*) cfd->destination->data,
+			g_file_make_directory (job->destination,
 					       cfd->cancellable,
 					       &error);
 		}
 	}
 
-	if (error) {
+	if (error != NULL)
+		copy_files_set_error (cfd, error);
+
+	cfd->running = g_list_remove (cfd->running, job);
+	cfd->n_running--;
+	cfd->n_completed++;
+	cfd->completed_bytes += job->total_num_bytes;
+
+	g_copy_files_start_next (cfd);
+}
+
+
+/* Whether the parent folder of @job is still being copied. */
+static gboolean
+copy_file_job_is_waiting (CopyFileJob *job)
+{
+	GList *scan;
+
+	for (scan = job->cfd->running; scan; scan = scan->next) {
+		CopyFileJob *running_job = scan->data;
+
+		if (g_file_has_prefix (job->destination, running_job->destination))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+static void
+g_copy_files_start_next (CopyFilesData *cfd)
+{
+	while ((cfd->error == NULL)
+	       && (cfd->next_job != NULL)
+	       && (cfd->n_running < cfd->max_jobs))
+	{
+		CopyFileJob *job = cfd->next_job->data;
+
+		if (copy_file_job_is_waiting (job))
+			break;
+
+		cfd->next_job = cfd->next_job->next;
+		cfd->running = g_list_prepend (cfd->running, job);
+		cfd->n_running++;
+
+		g_file_copy_async (job->source,
+				   job->destination,
+				   cfd->flags,
+				   cfd->io_priority,
+				   cfd->cancellable,
+				   g_copy_files_progess_cb,
+				   job,
+				   g_copy_files_ready_cb,
+				   job);
+	}
+
+	if ((cfd->n_running == 0) && ((cfd->next_job == NULL) || (cfd->error != NULL))) {
 		if (cfd->callback)
-			cfd->callback (error, cfd->user_data);
-		g_clear_error (&error);
+			cfd->callback (cfd->error, cfd->user_data);
 		copy_files_data_free (cfd);
-		return;
+	}
+}
+
+
+static int
+copy_file_job_compare_by_size (gconstpointer a,
+			       gconstpointer b)
+{
+	const CopyFileJob *job_a = a;
+	const CopyFileJob *job_b = b;
+
+	/* copy the folders and the other non-regular files first, in the
+	 * original order, so that a folder is always created before its
+	 * content. */
+
+	if (job_a->is_regular != job_b->is_regular)
+		return job_a->is_regular ? 1 : -1;
+
+	if (job_a->is_regular) {
+		if (job_a->size > job_b->size)
+			return -1;
+		if (job_a->size < job_b->size)
+			return 1;
 	}
 
-	g_copy_next_file (cfd);
+	return job_a->index - job_b->index;
 }
 
 
 static void
-g_copy_files_progess_cb (goffset  current_num_bytes,
-                         goffset  total_num_bytes,
-                         gpointer user_data)
+copy_file_job_set_info (CopyFileJob *job,
+			GFileInfo   *info)
 {
-	CopyFilesData *cfd = user_data;
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_TYPE))
+		job->is_regular = (g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR);
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE)) {
+		job->size = g_file_info_get_size (info);
+		job->cfd->tot_bytes += job->size;
+	}
+}
+
+
+static void g_copy_files_query_next (CopyFilesData *cfd);
 
-	if (cfd->progress_callback)
-		cfd->progress_callback (cfd->n_file,
-					cfd->tot_files,
-					(GFile*) cfd->source->data,
-					(GFile*) cfd->destination->data,
-					current_num_bytes,
-					total_num_bytes,
-					cfd->progress_callback_data);
+
+static void
+g_copy_files_query_ready_cb (GObject      *source_object,
+			     GAsyncResult *result,
+			     gpointer      user_data)
+{
+	CopyFileJob   *job = user_data;
+	CopyFilesData *cfd = job->cfd;
+	GFileInfo     *info;
+	GError        *error = NULL;
+
+	info = g_file_query_info_finish (job->source, result, &error);
+	if (info != NULL) {
+		copy_file_job_set_info (job, info);
+		g_object_unref (info);
+	}
+	else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		copy_files_set_error (cfd, error);
+	else
+		/* the copy will report the error, if any. */
+		g_error_free (error);
+
+	cfd->n_running--;
+	g_copy_files_query_next (cfd);
 }
 
 
+/* Reads the size of the files to copy, using the info collected when
+ * scanning the files if available, then sorts them. */
 static void
-g_copy_current_file (CopyFilesData *cfd)
+g_copy_files_query_next (CopyFilesData *cfd)
 {
-	if ((cfd->source == NULL) || (cfd->destination == NULL)) {
-		if (cfd->callback)
-			cfd->callback (NULL, cfd->user_data);
-		copy_files_data_free (cfd);
-		return;
+	while ((cfd->error == NULL)
+	       && (cfd->next_job != NULL)
+	       && (cfd->n_running < cfd->max_jobs))
+	{
+		CopyFileJob *job = cfd->next_job->data;
+		GFileInfo   *info;
+
+		cfd->next_job = cfd->next_job->next;
+
+		info = _g_file_get_cached_info (job->source);
+		if ((info != NULL)
+		    && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_TYPE)
+		    && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE))
+		{
+			copy_file_job_set_info (job, info);
+			continue;
+		}
+
+		cfd->n_running++;
+		g_file_query_info_async (job->source,
+					 G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					 G_FILE_QUERY_INFO_NONE,
+					 cfd->io_priority,
+					 cfd->cancellable,
+					 g_copy_files_query_ready_cb,
+					 job);
 	}
 
-	g_file_copy_async ((GFile*) cfd->source->data,
-			   (GFile*) cfd->destination->data,
-			   cfd->flags,
-			   cfd->io_priority,
-			   cfd->cancellable,
-			   g_copy_files_progess_cb,
-			   cfd,
-			   g_copy_files_ready_cb,
-			   cfd);
+	if (cfd->n_running > 0)
+		return;
+
+	if (cfd->error == NULL) {
+		cfd->jobs = g_list_sort (cfd->jobs, copy_file_job_compare_by_size);
+		cfd->next_job = cfd->jobs;
+	}
+	g_copy_files_start_next (cfd);
 }
 
 
+/**
+ * g_copy_files_async_full:
+ * @max_jobs: the maximum number of files copied at the same time.
+ * @largest_first: whether to copy the largest files first.
+ *
+ * Copies @sources to @destinations.  A file is not copied before its parent
+ * folder, if the folder is in @sources as well.  The progress callback
+ * reports the progress of all the running copies.
+ */
 void
-g_copy_files_async (GList                 *sources,
-		    GList                 *destinations,
-		    GFileCopyFlags         flags,
-		    int                    io_priority,
-		    GCancellable          *cancellable,
-		    CopyProgressCallback   progress_callback,
-		    gpointer               progress_callback_data,
-		    CopyDoneCallback       callback,
-		    gpointer               user_data)
+g_copy_files_async_full (GList                 *sources,
+			 GList                 *destinations,
+			 GFileCopyFlags         flags,
+			 int                    io_priority,
+			 int                    max_jobs,
+			 gboolean               largest_first,
+			 GCancellable          *cancellable,
+			 CopyProgressCallback   progress_callback,
+			 gpointer               progress_callback_data,
+			 CopyDoneCallback       callback,
+			 gpointer               user_data)
 {
 	CopyFilesData *cfd;
 
@@ -864,12 +1392,42 @@ g_copy_files_async (GList                 *sources,
 				   destinations,
 				   flags,
 				   io_priority,
+				   max_jobs,
+				   largest_first,
 				   cancellable,
 				   progress_callback,
 				   progress_callback_data,
 				   callback,
 				   user_data);
-	g_copy_current_file (cfd);
+	if (cfd->largest_first && (cfd->tot_files > 1))
+		g_copy_files_query_next (cfd);
+	else
+		g_copy_files_start_next (cfd);
+}
+
+
+void
+g_copy_files_async (GList                 *sources,
+		    GList                 *destinations,
+		    GFileCopyFlags         flags,
+		    int                    io_priority,
+		    GCancellable          *cancellable,
+		    CopyProgressCallback   progress_callback,
+		    gpointer               progress_callback_data,
+		    CopyDoneCallback       callback,
+		    gpointer               user_data)
+{
+	g_copy_files_async_full (sources,
+				 destinations,
+				 flags,
+				 io_priority,
+				 MAX_RUNNING_COPIES,
+				 FALSE,
+				 cancellable,
+				 progress_callback,
+				 progress_callback_data,
+				 callback,
+				 user_data);
 }
 
 
@@ -984,10 +1542,7 @@ typedef struct {
 	GError                *error;
 
 	GList                 *to_copy;
-	GList                 *current;
-	GFile                 *current_source;
-	GFile                 *current_destination;
-	int                    n_file, tot_files;
+	int                    tot_files;
 	guint                  source_id;
 } DirectoryCopyData;
 
@@ -1002,14 +1557,6 @@ directory_copy_data_free (DirectoryCopyData *dcd)
 		g_object_unref (dcd->source);
 	if (dcd->destination != NULL)
 		g_object_unref (dcd->destination);
-	if (dcd->current_source != NULL) {
-		g_object_unref (dcd->current_source);
-		dcd->current_source = NULL;
-	}
-	if (dcd->current_destination != NULL) {
-		g_object_unref (dcd->current_destination);
-		dcd->current_destination = NULL;
-	}
 	g_list_foreach (dcd->to_copy, (GFunc) file_info_free, NULL);
 	g_list_free (dcd->to_copy);
 	g_free (dcd);
@@ -1052,143 +1599,15 @@ get_destination_for_uri (DirectoryCopyData *dcd,
 }
 
 
-static void g_directory_copy_current_child (DirectoryCopyData *dcd);
-
-
-static gboolean
-g_directory_copy_next_child (gpointer user_data)
-{
-	DirectoryCopyData *dcd = user_data;
-
-	g_source_remove (dcd->source_id);
-
-	dcd->current = g_list_next (dcd->current);
-	dcd->n_file++;
-	g_directory_copy_current_child (dcd);
-
-	return FALSE;
-}
-
-
-static void
-g_directory_copy_child_done_cb (GObject      *source_object,
-                        	GAsyncResult *result,
- 	                        gpointer      user_data)
-{
-	DirectoryCopyData *dcd = user_data;
-
-	if (! g_file_copy_finish ((GFile*)source_object, result, &(dcd->error))) {
-		dcd->source_id = g_idle_add (g_directory_copy_done, dcd);
-		return;
-	}
-
-	dcd->source_id = g_idle_add (g_directory_copy_next_child, dcd);
-}
-
-
 static void
-g_directory_copy_child_progess_cb (goffset  current_num_bytes,
-                           	   goffset  total_num_bytes,
-                           	   gpointer user_data)
+g_directory_copy_files_done_cb (GError   *error,
+				gpointer  user_data)
 {
 	DirectoryCopyData *dcd = user_data;
 
-	if (dcd->progress_callback)
-		dcd->progress_callback (dcd->n_file,
-					dcd->tot_files,
-					dcd->current_source,
-					dcd->current_destination,
-					current_num_bytes,
-					total_num_bytes,
-					dcd->progress_callback_data);
-}
-
-
-static void
-g_directory_copy_current_child (DirectoryCopyData *dcd)
-{
-	FileInfo *child;
-	gboolean   async_op = FALSE;
-
-	if (dcd->current == NULL) {
-		dcd->source_id = g_idle_add (g_directory_copy_done, dcd);
-		return;
-	}
-
-	if (dcd->current_source != NULL) {
-		g_object_unref (dcd->current_source);
-		dcd->current_source = NULL;
-	}
-	if (dcd->current_destination != NULL) {
-		g_object_unref (dcd->current_destination);
-		dcd->current_destination = NULL;
-	}
-
-	child = dcd->current->data;
-	dcd->current_source = g_object_ref (child->file);
-	dcd->current_destination = get_destination_for_uri (dcd, child->file);
-	if (dcd->current_destination == NULL) {
-		dcd->source_id = g_idle_add (g_directory_copy_next_child, dcd);
-		return;
-	}
-
-	switch (g_file_info_get_file_type (child->info)) {
-	case G_FILE_TYPE_DIRECTORY:
-		/* FIXME: how to make a directory asynchronously ? */
-
-		/* doesn't check the returned error for now, because when an
-		 * error occurs the code is not returned (for example when
-		 * a directory already exists the G_IO_ERROR_EXISTS code is
-		 * *not* returned), so we cannot discriminate between warnings
-		 * and fatal errors. (see bug #525155) */
-
-		g_file_make_directory (dcd->current_destination,
-				       NULL,
-				       NULL);
-
-		/*if (! g_file_make_directory (dcd->current_destination,
-					     dcd->cancellable,
-					     &(dcd->error)))
-		{
-			dcd->source_id = g_idle_add (g_directory_copy_done, dcd);
-			return;
-		}*/
-		break;
-	case G_FILE_TYPE_SYMBOLIC_LINK:
-		/* FIXME: how to make a link asynchronously ? */
-
-		g_file_make_symbolic_link (dcd->current_destination,
-					   g_file_info_get_symlink_target (child->info),
-					   NULL,
-					   NULL);
-
-		/*if (! g_file_make_symbolic_link (dcd->current_destination,
-						 g_file_info_get_symlink_target (child->info),
-						 dcd->cancellable,
-						 &(dcd->error)))
-		{
-			dcd->source_id = g_idle_add (g_directory_copy_done, dcd);
-			return;
-		}*/
-		break;
-	case G_FILE_TYPE_REGULAR:
-		g_file_copy_async (dcd->current_source,
-				   dcd->current_destination,
-				   dcd->flags,
-				   dcd->io_priority,
-				   dcd->cancellable,
-				   g_directory_copy_child_progess_cb,
-				   dcd,
-				   g_directory_copy_child_done_cb,
-				   dcd);
-		async_op = TRUE;
-		break;
-	default:
-		break;
-	}
-
-	if (! async_op)
-		dcd->source_id = g_idle_add (g_directory_copy_next_child, dcd);
+	if (error != NULL)
+		dcd->error = g_error_copy (error);
+	dcd->source_id = g_idle_add (g_directory_copy_done, dcd);
 }
 
 
@@ -1196,13 +1615,74 @@ static gboolean
 g_directory_copy_start_copying (gpointer user_data)
 {
 	DirectoryCopyData *dcd = user_data;
+	GList             *sources;
+	GList             *destinations;
+	GList             *scan;
 
 	g_source_remove (dcd->source_id);
 
+	/* create the folders and the links, then copy the regular files
+	 * concurrently. */
+
 	dcd->to_copy = g_list_reverse (dcd->to_copy);
-	dcd->current = dcd->to_copy;
-	dcd->n_file = 1;
-	g_directory_copy_current_child (dcd);
+	sources = NULL;
+	destinations = NULL;
+	for (scan = dcd->to_copy; scan; scan = scan->next) {
+		FileInfo *child = scan->data;
+		GFile    *destination;
+
+		destination = get_destination_for_uri (dcd, child->file);
+		if (destination == NULL)
+			continue;
+
+		switch (g_file_info_get_file_type (child->info)) {
+		case G_FILE_TYPE_DIRECTORY:
+			/* FIXME: how to make a directory asynchronously ? */
+
+			/* doesn't check the returned error for now, because when an
+			 * error occurs the code is not returned (for example when
+			 * a directory already exists the G_IO_ERROR_EXISTS code is
+			 * *not* returned), so we cannot discriminate between warnings
+			 * and fatal errors. (see bug #525155) */
+
+			g_file_make_directory (destination, NULL, NULL);
+			break;
+		case G_FILE_TYPE_SYMBOLIC_LINK:
+			/* FIXME: how to make a link asynchronously ? */
+
+			g_file_make_symbolic_link (destination,
+						   g_file_info_get_symlink_target (child->info),
+						   NULL,
+						   NULL);
+			break;
+		case G_FILE_TYPE_REGULAR:
+			_g_file_set_cached_info (child->file, child->info);
+			sources = g_list_prepend (sources, g_object_ref (child->file));
+			destinations = g_list_prepend (destinations, g_object_ref (destination));
+			break;
+		default:
+			break;
+		}
+
+		g_object_unref (destination);
+	}
+	sources = g_list_reverse (sources);
+	destinations = g_list_reverse (destinations);
+
+	g_copy_files_async_full (sources,
+				 destinations,
+				 dcd->flags,
+				 dcd->io_priority,
+				 MAX_RUNNING_COPIES,
+				 TRUE,
+				 dcd->cancellable,
+				 dcd->progress_callback,
+				 dcd->progress_callback_data,
+				 g_directory_copy_files_done_cb,
+				 dcd);
+
+	_g_file_list_free (sources);
+	_g_file_list_free (destinations);
 
 	return FALSE;
 }
@@ -1279,7 +1759,7 @@ g_directory_copy_async (GFile                 *source,
 	g_directory_foreach_child (dcd->source,
 			           TRUE,
 			           TRUE,
-			           NULL,
+			           G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_STANDARD_SYMLINK_TARGET,
 			           dcd->cancellable,
 			           g_directory_copy_start_dir,
 			           g_directory_copy_for_each_file,
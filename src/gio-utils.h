@@ -54,6 +54,9 @@ FileInfo *    file_info_new          (GFile             *file,
 				      GFileInfo         *info);
 void          file_info_free         (FileInfo          *file_info);
 void          file_info_list_free    (GList             *list);
+void          _g_file_set_cached_info (GFile            *file,
+				      GFileInfo         *info);
+GFileInfo *   _g_file_get_cached_info (GFile            *file);
 
 /* FileFilter */
 
@@ -63,6 +66,11 @@ FileFilter *  file_filter_new        (const char        *pattern);
 void          file_filter_unref      (FileFilter        *filter);
 gboolean      file_filter_matches    (FileFilter        *filter,
 				      GFile             *file);
+gboolean      file_filter_matches_name (FileFilter      *filter,
+				      const char        *name);
+gboolean      file_filter_matches_info (FileFilter      *filter,
+				      GFile             *file,
+				      GFileInfo         *info);
 gboolean      file_filter_empty      (FileFilter        *filter);
 
 /* callback types */
@@ -115,6 +123,15 @@ void   _g_file_list_query_info_async (GList                 *file_list, /* GFile
                      	     	      FilterMatchCallback    file_filter_func,
                      	     	      InfoReadyCallback      ready_callback,
                      	     	      gpointer               user_data);
+void   _g_file_list_foreach_async    (GList                 *file_list, /* GFile list */
+				      FileListFlags          flags,
+				      const char            *attributes,
+				      GCancellable          *cancellable,
+				      FilterMatchCallback    directory_filter_func,
+				      FilterMatchCallback    file_filter_func,
+				      ForEachChildCallback   for_each_file_func,
+				      ForEachDoneCallback    done_func,
+				      gpointer               user_data);
 
 /* asynchronous copy functions */
 
@@ -127,6 +144,17 @@ void   g_copy_files_async            (GList                 *sources,
 				      gpointer               progress_callback_data,
 				      CopyDoneCallback       callback,
 				      gpointer               user_data);
+void   g_copy_files_async_full       (GList                 *sources,
+				      GList                 *destinations,
+				      GFileCopyFlags         flags,
+				      int                    io_priority,
+				      int                    max_jobs,
+				      gboolean               largest_first,
+				      GCancellable          *cancellable,
+				      CopyProgressCallback   progress_callback,
+				      gpointer               progress_callback_data,
+				      CopyDoneCallback       callback,
+				      gpointer               user_data);
 void   g_copy_uris_async             (GList                 *sources,
 				      GList                 *destinations,
 				      GFileCopyFlags         flags,
@@ -0,0 +1,463 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include "file-utils.h"
+#include "glib-utils.h"
+#include "open-file-cache.h"
+
+
+#define MAX_CACHE_SIZE (256 * 1024 * 1024)
+
+
+/* The folders where the files are extracted, a folder is deleted when
+ * it doesn't contain cached files and none of its files is monitored. */
+typedef struct {
+	GFile *file;
+	int    n_entries;
+	int    n_pins;
+} CacheDir;
+
+
+typedef struct {
+	char     *key;
+	GFile    *file;
+	CacheDir *dir;
+	goffset   size;
+	time_t    mtime;         /* modification time of the extracted file */
+} CacheEntry;
+
+
+/* A file opened by several windows is monitored once, the changes are
+ * reported to the window that opened it last. */
+typedef struct {
+	GFile               *file;
+	GFile               *temp_dir;
+	GFileMonitor        *monitor;
+	OpenFileChangedFunc  func;
+	gpointer             user_data;
+} CacheMonitor;
+
+
+static GHashTable *cache_entries = NULL;    /* key -> GList link of lru_list */
+static GHashTable *cache_dirs = NULL;       /* GFile -> CacheDir */
+static GHashTable *cache_monitors = NULL;   /* GFile -> CacheMonitor */
+static GQueue      lru_list = G_QUEUE_INIT; /* CacheEntry list, most recently used first */
+static goffset     cache_size = 0;
+
+
+static void
+cache_dir_free (CacheDir *dir)
+{
+	_g_file_remove_directory (dir->file, NULL, NULL);
+	g_object_unref (dir->file);
+	g_free (dir);
+}
+
+
+static void cache_monitor_free (CacheMonitor *monitor);
+
+
+static void
+cache_init (void)
+{
+	if (cache_entries != NULL)
+		return;
+
+	cache_entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+	cache_dirs = g_hash_table_new_full (g_file_hash,
+					    (GEqualFunc) g_file_equal,
+					    NULL,
+					    (GDestroyNotify) cache_dir_free);
+	cache_monitors = g_hash_table_new_full (g_file_hash,
+						(GEqualFunc) g_file_equal,
+						NULL,
+						(GDestroyNotify) cache_monitor_free);
+}
+
+
+static CacheDir *
+cache_get_dir (GFile    *file,
+	       gboolean  create)
+{
+	CacheDir *dir;
+
+	cache_init ();
+
+	dir = g_hash_table_lookup (cache_dirs, file);
+	if ((dir == NULL) && create) {
+		dir = g_new0 (CacheDir, 1);
+		dir->file = g_object_ref (file);
+		g_hash_table_insert (cache_dirs, dir->file, dir);
+	}
+
+	return dir;
+}
+
+
+static void
+cache_release_dir (CacheDir *dir)
+{
+	if ((dir->n_entries == 0) && (dir->n_pins == 0))
+		g_hash_table_remove (cache_dirs, dir->file);
+}
+
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	entry->dir->n_entries--;
+	cache_release_dir (entry->dir);
+	g_object_unref (entry->file);
+	g_free (entry->key);
+	g_free (entry);
+}
+
+
+static void
+cache_remove_link (GList *link)
+{
+	CacheEntry *entry = link->data;
+
+	g_hash_table_remove (cache_entries, entry->key);
+	g_queue_unlink (&lru_list, link);
+	g_list_free (link);
+	cache_size -= entry->size;
+	cache_entry_free (entry);
+}
+
+
+/* Removes the least recently used file from the cache and deletes it from
+ * the disk, unless it is still monitored because opened in an application. */
+static void
+cache_evict_link (GList *link)
+{
+	CacheEntry *entry = link->data;
+
+	if ((cache_monitors == NULL) || (g_hash_table_lookup (cache_monitors, entry->file) == NULL))
+		g_file_delete (entry->file, NULL, NULL);
+	cache_remove_link (link);
+}
+
+
+typedef struct {
+	GFile               *file;
+	ArchiveKeyReadyFunc  ready_func;
+	gpointer             user_data;
+} ArchiveKeyData;
+
+
+static void
+archive_info_ready_cb (GObject      *source_object,
+		       GAsyncResult *result,
+		       gpointer      user_data)
+{
+	ArchiveKeyData *data = user_data;
+	GFileInfo      *info;
+	char           *key = NULL;
+
+	info = g_file_query_info_finish (G_FILE (source_object), result, NULL);
+	if (info != NULL) {
+		char *uri;
+
+		uri = g_file_get_uri (data->file);
+		key = g_strdup_printf ("%s|%" G_GUINT64_FORMAT "|%" G_GOFFSET_FORMAT,
+				       uri,
+				       g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+				       g_file_info_get_size (info));
+
+		g_free (uri);
+		g_object_unref (info);
+	}
+
+	data->ready_func (key, data->user_data);
+
+	g_object_unref (data->file);
+	g_free (data);
+}
+
+
+/* The archive is identified by its uri, modification time and size.  The
+ * key is NULL if the archive cannot be queried, the files are not cached
+ * in that case. */
+void
+open_file_cache_get_archive_key (FrArchive           *archive,
+				 GCancellable        *cancellable,
+				 ArchiveKeyReadyFunc  ready_func,
+				 gpointer             user_data)
+{
+	GFile          *file;
+	ArchiveKeyData *data;
+
+	file = fr_archive_get_file (archive);
+	if (file == NULL) {
+		ready_func (NULL, user_data);
+		return;
+	}
+
+	data = g_new0 (ArchiveKeyData, 1);
+	data->file = g_object_ref (file);
+	data->ready_func = ready_func;
+	data->user_data = user_data;
+
+	g_file_query_info_async (file,
+				 G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_DEFAULT,
+				 cancellable,
+				 archive_info_ready_cb,
+				 data);
+}
+
+
+/* The file is identified by the archive key and its path, modification
+ * time and size. */
+static char *
+get_cache_key (const char *archive_key,
+	       FileData   *file_data)
+{
+	return g_strdup_printf ("%s|%s|%" G_GINT64_FORMAT "|%" G_GOFFSET_FORMAT,
+				archive_key,
+				file_data->original_path,
+				(gint64) file_data->modified,
+				file_data->size);
+}
+
+
+gboolean
+open_file_cache_lookup (const char  *archive_key,
+			FileData    *file_data,
+			GFile      **extracted_file,
+			GFile      **temp_dir)
+{
+	char       *key;
+	GList      *link;
+	CacheEntry *entry;
+
+	cache_init ();
+
+	if (archive_key == NULL)
+		return FALSE;
+
+	key = get_cache_key (archive_key, file_data);
+	link = g_hash_table_lookup (cache_entries, key);
+	g_free (key);
+
+	if (link == NULL)
+		return FALSE;
+
+	/* the cached copy is not valid if it was deleted or modified. */
+
+	entry = link->data;
+	if (! g_file_query_exists (entry->file, NULL)
+	    || (_g_file_get_file_mtime (entry->file) != entry->mtime))
+	{
+		cache_remove_link (link);
+		return FALSE;
+	}
+
+	g_queue_unlink (&lru_list, link);
+	g_queue_push_head_link (&lru_list, link);
+
+	*extracted_file = g_object_ref (entry->file);
+	*temp_dir = g_object_ref (entry->dir->file);
+
+	return TRUE;
+}
+
+
+void
+open_file_cache_add (const char *archive_key,
+		     FileData   *file_data,
+		     GFile      *extracted_file,
+		     GFile      *temp_dir)
+{
+	char       *key;
+	GList      *link;
+	CacheEntry *entry;
+
+	cache_init ();
+
+	if (archive_key == NULL)
+		return;
+
+	key = get_cache_key (archive_key, file_data);
+	link = g_hash_table_lookup (cache_entries, key);
+	if (link != NULL)
+		cache_remove_link (link);
+
+	entry = g_new0 (CacheEntry, 1);
+	entry->key = key;
+	entry->file = g_object_ref (extracted_file);
+	entry->dir = cache_get_dir (temp_dir, TRUE);
+	entry->dir->n_entries++;
+	entry->size = file_data->size;
+	entry->mtime = _g_file_get_file_mtime (extracted_file);
+
+	g_queue_push_head (&lru_list, entry);
+	g_hash_table_insert (cache_entries, entry->key, lru_list.head);
+	cache_size += entry->size;
+
+	/* remove the least recently used files, keeping the new one even if
+	 * bigger than the cache. */
+
+	while ((cache_size > MAX_CACHE_SIZE) && (lru_list.length > 1))
+		cache_evict_link (lru_list.tail);
+}
+
+
+/* -- monitors -- */
+
+
+/* The folders of the monitored files are not deleted until the monitor is
+ * removed, even if the files are removed from the cache. */
+static void
+cache_pin_dir (GFile *temp_dir)
+{
+	CacheDir *dir;
+
+	dir = cache_get_dir (temp_dir, FALSE);
+	if (dir != NULL)
+		dir->n_pins++;
+}
+
+
+static void
+cache_unpin_dir (GFile *temp_dir)
+{
+	CacheDir *dir;
+
+	dir = cache_get_dir (temp_dir, FALSE);
+	if ((dir == NULL) || (dir->n_pins == 0))
+		return;
+
+	dir->n_pins--;
+	cache_release_dir (dir);
+}
+
+
+static void
+cache_monitor_free (CacheMonitor *monitor)
+{
+	g_signal_handlers_disconnect_by_data (monitor->monitor, monitor);
+	g_file_monitor_cancel (monitor->monitor);
+	g_object_unref (monitor->monitor);
+	cache_unpin_dir (monitor->temp_dir);
+	g_object_unref (monitor->temp_dir);
+	g_object_unref (monitor->file);
+	g_free (monitor);
+}
+
+
+static void
+monitor_changed_cb (GFileMonitor      *file_monitor,
+		    GFile             *file,
+		    GFile             *other_file,
+		    GFileMonitorEvent  event_type,
+		    gpointer           user_data)
+{
+	CacheMonitor *monitor = user_data;
+
+	if ((event_type != G_FILE_MONITOR_EVENT_CHANGED)
+	    && (event_type != G_FILE_MONITOR_EVENT_CREATED))
+	{
+		return;
+	}
+
+	monitor->func (monitor->file, monitor->user_data);
+}
+
+
+/* Calls @func when @extracted_file is modified.  If the file is already
+ * monitored for another window, only @func is called from now on. */
+void
+open_file_cache_monitor (GFile               *extracted_file,
+			 GFile               *temp_dir,
+			 OpenFileChangedFunc  func,
+			 gpointer             user_data)
+{
+	CacheMonitor *monitor;
+
+	cache_init ();
+
+	monitor = g_hash_table_lookup (cache_monitors, extracted_file);
+	if (monitor != NULL) {
+		monitor->func = func;
+		monitor->user_data = user_data;
+		return;
+	}
+
+	monitor = g_new0 (CacheMonitor, 1);
+	monitor->file = g_object_ref (extracted_file);
+	monitor->temp_dir = g_object_ref (temp_dir);
+	monitor->monitor = g_file_monitor_file (extracted_file, 0, NULL, NULL);
+	monitor->func = func;
+	monitor->user_data = user_data;
+	if (monitor->monitor == NULL) {
+		g_object_unref (monitor->temp_dir);
+		g_object_unref (monitor->file);
+		g_free (monitor);
+		return;
+	}
+
+	g_signal_connect (monitor->monitor,
+			  "changed",
+			  G_CALLBACK (monitor_changed_cb),
+			  monitor);
+	cache_pin_dir (temp_dir);
+	g_hash_table_insert (cache_monitors, monitor->file, monitor);
+}
+
+
+static gboolean
+monitor_has_user_data (gpointer key,
+		       gpointer value,
+		       gpointer user_data)
+{
+	CacheMonitor *monitor = value;
+
+	return monitor->user_data == user_data;
+}
+
+
+/* Removes the monitors that call back with @user_data. */
+void
+open_file_cache_unmonitor (gpointer user_data)
+{
+	if (cache_monitors == NULL)
+		return;
+
+	g_hash_table_foreach_remove (cache_monitors, monitor_has_user_data, user_data);
+}
+
+
+/* Deletes all the extracted files, called when the program exits. */
+void
+open_file_cache_clear (void)
+{
+	if (cache_entries == NULL)
+		return;
+
+	g_hash_table_remove_all (cache_monitors);
+	while (lru_list.head != NULL)
+		cache_remove_link (lru_list.head);
+	g_hash_table_remove_all (cache_dirs);
+}
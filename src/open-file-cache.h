@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPEN_FILE_CACHE_H
+#define OPEN_FILE_CACHE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "file-data.h"
+#include "fr-archive.h"
+
+/* The files extracted to be opened are kept in a cache shared by all the
+ * windows, so opening a file again doesn't extract it another time. */
+
+typedef void (*OpenFileChangedFunc) (GFile    *file,
+				     gpointer  user_data);
+typedef void (*ArchiveKeyReadyFunc) (char     *archive_key,
+				     gpointer  user_data);
+
+void        open_file_cache_get_archive_key (FrArchive            *archive,
+					     GCancellable         *cancellable,
+					     ArchiveKeyReadyFunc   ready_func,
+					     gpointer              user_data);
+gboolean    open_file_cache_lookup          (const char           *archive_key,
+					     FileData             *file_data,
+					     GFile               **extracted_file,
+					     GFile               **temp_dir);
+void        open_file_cache_add             (const char           *archive_key,
+					     FileData             *file_data,
+					     GFile                *extracted_file,
+					     GFile                *temp_dir);
+void        open_file_cache_monitor         (GFile                *extracted_file,
+					     GFile                *temp_dir,
+					     OpenFileChangedFunc   func,
+					     gpointer              user_data);
+void        open_file_cache_unmonitor       (gpointer              user_data);
+void        open_file_cache_clear           (void);
+
+#endif /* OPEN_FILE_CACHE_H */
@@ -52,6 +52,7 @@
 
 #define PREF_GENERAL_EDITORS              "editors"
 #define PREF_GENERAL_COMPRESSION_LEVEL    "compression-level"
+#define PREF_GENERAL_COMPRESSION_THREADS  "compression-threads"
 #define PREF_GENERAL_ENCRYPT_HEADER       "encrypt-header"
 
 #define PREF_EXTRACT_SKIP_NEWER           "skip-newer"
@@ -22,6 +22,20 @@ if test "x$3" = x-x; then
 	file_to_extract=$4
 	outfile=$5
 	isoinfo $iso_extensions -i "$filename" -x "$file_to_extract" > "$outfile"
+elif test "x$3" = x-X; then
+	# extract all the remaining arguments in the current folder,
+	# probing the image only once.
+	shift 3
+	current_dir=
+	for file_to_extract in "$@"; do
+		outfile="./${file_to_extract#/}"
+		outdir="${outfile%/*}"
+		if test "x$outdir" != "x$current_dir"; then
+			mkdir -p "$outdir" || exit 1
+			current_dir=$outdir
+		fi
+		isoinfo $iso_extensions -i "$filename" -x "$file_to_extract" > "$outfile" || exit 1
+	done
 else
 	isoinfo $iso_extensions -i "$filename" -l
 fi
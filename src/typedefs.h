@@ -76,8 +76,9 @@ typedef guint8 FrArchiveCaps;
 
 typedef struct {
 	const char    *mime_type;
-	FrArchiveCaps  current_capabilities;
+	FrArchiveCaps  current_capabilities;   /* valid if probed is TRUE */
 	FrArchiveCaps  potential_capabilities;
+	gboolean       probed;
 } FrMimeTypeCap;
 
 typedef struct {
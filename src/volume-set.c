@@ -0,0 +1,688 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include "glib-utils.h"
+#include "volume-set.h"
+
+
+#define READ_AHEAD_SIZE (4 * 1024 * 1024)
+#define MAX_RAR_VOLUMES 101 /* name.rar, name.r00 ... name.r99 */
+#define SIGNATURE_SIZE 512
+
+
+/* -- VolumeName -- */
+
+
+typedef enum {
+	VOLUME_NAME_PART,      /* name.part1.rar, name.part2.rar, ... */
+	VOLUME_NAME_RAR,       /* name.rar, name.r00, name.r01, ... */
+	VOLUME_NAME_NUMBER     /* name.001, name.002, ... at least 3 digits */
+} VolumeNameType;
+
+
+static struct {
+	const char     *pattern;
+	VolumeNameType  type;
+	GRegex         *regex;
+} volume_name_patterns[] = {
+	{ "^(.*\\.part)([0-9]+)(\\.rar)$", VOLUME_NAME_PART, NULL },
+	{ "^(.*\\.r)([0-9]+|ar)()$", VOLUME_NAME_RAR, NULL },
+	{ "^(.*\\.)([0-9]{3,})()$", VOLUME_NAME_NUMBER, NULL },
+};
+
+
+typedef struct {
+	VolumeNameType  type;
+	char           *prefix;
+	char           *number;
+	char           *suffix;
+} VolumeName;
+
+
+static void
+volume_name_compile_patterns (void)
+{
+	static gsize compiled = 0;
+
+	if (g_once_init_enter (&compiled)) {
+		int i;
+
+		for (i = 0; i < G_N_ELEMENTS (volume_name_patterns); i++)
+			volume_name_patterns[i].regex = g_regex_new (volume_name_patterns[i].pattern,
+								     G_REGEX_CASELESS | G_REGEX_OPTIMIZE,
+								     0,
+								     NULL);
+		g_once_init_leave (&compiled, 1);
+	}
+}
+
+
+/* @name is in UTF-8 */
+static gboolean
+volume_name_parse (VolumeName *vname,
+		   const char *name)
+{
+	int i;
+
+	volume_name_compile_patterns ();
+
+	for (i = 0; i < G_N_ELEMENTS (volume_name_patterns); i++) {
+		GMatchInfo *match_info;
+
+		if (g_regex_match (volume_name_patterns[i].regex, name, 0, &match_info)) {
+			vname->type = volume_name_patterns[i].type;
+			vname->prefix = g_match_info_fetch (match_info, 1);
+			vname->number = g_match_info_fetch (match_info, 2);
+			vname->suffix = g_match_info_fetch (match_info, 3);
+			g_match_info_free (match_info);
+			return TRUE;
+		}
+		g_match_info_free (match_info);
+	}
+
+	return FALSE;
+}
+
+
+static void
+volume_name_clear (VolumeName *vname)
+{
+	g_free (vname->prefix);
+	g_free (vname->number);
+	g_free (vname->suffix);
+}
+
+
+/* Returns the name of the @n_volume-th volume in the file system encoding,
+ * or NULL if there's no such volume. */
+static char *
+volume_name_get_volume (VolumeName *vname,
+			int         n_volume)
+{
+	char *name = NULL;
+	char *filename;
+
+	switch (vname->type) {
+	case VOLUME_NAME_PART:
+	case VOLUME_NAME_NUMBER:
+		name = g_strdup_printf ("%s%0*d%s", vname->prefix, (int) strlen (vname->number), n_volume + 1, vname->suffix);
+		break;
+
+	case VOLUME_NAME_RAR:
+		if (n_volume == 0)
+			name = g_strconcat (vname->prefix, g_str_has_suffix (vname->prefix, "r") ? "ar" : "AR", NULL);
+		else if (n_volume < MAX_RAR_VOLUMES)
+			name = g_strdup_printf ("%s%02d", vname->prefix, n_volume - 1);
+		break;
+	}
+
+	if (name == NULL)
+		return NULL;
+
+	filename = g_filename_from_utf8 (name, -1, NULL, NULL, NULL);
+	g_free (name);
+
+	return filename;
+}
+
+
+/* Returns the name of the first volume in the file system encoding, @name
+ * is in UTF-8. */
+char *
+volume_set_get_first_volume_name (const char *name)
+{
+	VolumeName  vname;
+	char       *first_name;
+
+	if ((name == NULL) || ! volume_name_parse (&vname, name))
+		return NULL;
+
+	first_name = volume_name_get_volume (&vname, 0);
+	volume_name_clear (&vname);
+
+	return first_name;
+}
+
+
+/* Returns the name of the archive split in @file and the following volumes
+ * (name.001, name.002, ...), in UTF-8, or NULL if @file is not such a
+ * volume. */
+char *
+volume_set_get_split_archive_name (GFile *file)
+{
+	char       *basename;
+	char       *name;
+	VolumeName  vname;
+	char       *archive_name = NULL;
+
+	basename = g_file_get_basename (file);
+	name = (basename != NULL) ? g_filename_to_utf8 (basename, -1, NULL, NULL, NULL) : NULL;
+	g_free (basename);
+
+	if ((name != NULL) && volume_name_parse (&vname, name)) {
+		if ((vname.type == VOLUME_NAME_NUMBER) && (strlen (vname.prefix) > 1))
+			archive_name = g_strndup (vname.prefix, strlen (vname.prefix) - 1);
+		volume_name_clear (&vname);
+	}
+	g_free (name);
+
+	return archive_name;
+}
+
+
+gboolean
+volume_set_is_split_volume (GFile *file)
+{
+	char     *archive_name;
+	gboolean  result;
+
+	archive_name = volume_set_get_split_archive_name (file);
+	result = (archive_name != NULL);
+	g_free (archive_name);
+
+	return result;
+}
+
+
+/* -- signatures -- */
+
+
+/* The volumes of a split archive are cut at arbitrary positions, a volume
+ * after the first that starts with one of these is a complete archive. */
+static const struct {
+	gsize       offset;
+	gsize       size;
+	const char *bytes;
+} archive_signatures[] = {
+	{ 0,   3, "\x1f\x8b\x08" },       /* gzip */
+	{ 0,   6, "\xfd" "7zXZ\x00" },    /* xz */
+	{ 0,   4, "\x28\xb5\x2f\xfd" },   /* zstd */
+	{ 0,   4, "\x04\x22\x4d\x18" },   /* lz4 */
+	{ 0,   4, "LZIP" },               /* lzip */
+	{ 4,   6, "1AY&SY" },             /* bzip2 */
+	{ 0,   4, "PK\x03\x04" },         /* zip */
+	{ 0,   6, "7z\xbc\xaf\x27\x1c" }, /* 7z */
+	{ 0,   6, "Rar!\x1a\x07" },       /* rar */
+	{ 0,   8, "!<arch>\n" },          /* ar */
+	{ 0,   6, "070701" },             /* cpio */
+	{ 0,   6, "070707" },             /* cpio */
+	{ 257, 5, "ustar" },              /* tar */
+};
+
+
+static gboolean
+file_starts_with_archive_signature (GFile        *file,
+				    GCancellable *cancellable)
+{
+	GInputStream *stream;
+	guchar        buffer[SIGNATURE_SIZE];
+	gsize         size;
+	gboolean      found;
+	int           i;
+
+	stream = (GInputStream *) g_file_read (file, cancellable, NULL);
+	if (stream == NULL)
+		return FALSE;
+
+	size = 0;
+	g_input_stream_read_all (stream, buffer, sizeof (buffer), &size, cancellable, NULL);
+	g_object_unref (stream);
+
+	found = FALSE;
+	for (i = 0; ! found && (i < G_N_ELEMENTS (archive_signatures)); i++) {
+		gsize offset = archive_signatures[i].offset;
+		gsize sig_size = archive_signatures[i].size;
+
+		if ((offset + sig_size <= size)
+		    && (memcmp (buffer + offset, archive_signatures[i].bytes, sig_size) == 0))
+		{
+			found = TRUE;
+		}
+	}
+
+	return found;
+}
+
+
+/* -- ReadAhead -- */
+
+
+typedef struct {
+	GFile        *file;
+	GCancellable *cancellable;
+	GInputStream *stream;
+	GBytes       *head;          /* the first bytes of the volume */
+} ReadAhead;
+
+
+static void
+read_ahead_free (ReadAhead *read_ahead)
+{
+	g_object_unref (read_ahead->file);
+	g_object_unref (read_ahead->cancellable);
+	_g_object_unref (read_ahead->stream);
+	if (read_ahead->head != NULL)
+		g_bytes_unref (read_ahead->head);
+	g_free (read_ahead);
+}
+
+
+static gpointer
+read_ahead_thread (gpointer user_data)
+{
+	ReadAhead *read_ahead = user_data;
+	char      *buffer;
+	gsize      bytes_read;
+
+	read_ahead->stream = (GInputStream *) g_file_read (read_ahead->file, read_ahead->cancellable, NULL);
+	if (read_ahead->stream == NULL)
+		return read_ahead;
+
+	buffer = g_malloc (READ_AHEAD_SIZE);
+	if (g_input_stream_read_all (read_ahead->stream, buffer, READ_AHEAD_SIZE, &bytes_read, read_ahead->cancellable, NULL)) {
+		read_ahead->head = g_bytes_new (buffer, bytes_read);
+	}
+	else {
+		/* the stream position is unknown, let the reader open the
+		 * volume again and report the error. */
+		g_object_unref (read_ahead->stream);
+		read_ahead->stream = NULL;
+	}
+	g_free (buffer);
+
+	return read_ahead;
+}
+
+
+/* -- VolumeSet -- */
+
+
+typedef struct {
+	GFile   *file;
+	goffset  offset;             /* position of the volume in the set */
+	goffset  size;
+} Volume;
+
+
+struct _VolumeSet {
+	Volume       *volumes;
+	int           n_volumes;
+	goffset       size;
+	goffset       position;
+	int           current;           /* the volume read by stream, -1 if none */
+	GInputStream *stream;
+	goffset       stream_position;   /* relative to the current volume */
+	GBytes       *head;              /* bytes read ahead at the start of the current volume */
+	GThread      *read_ahead_thread;
+	ReadAhead    *read_ahead;
+	int           read_ahead_volume;
+};
+
+
+/* Unrelated files with numbered names, such as rotated backups, are not
+ * joined: in a split archive all the volumes but the last have the same
+ * size, and only the first volume starts with an archive signature.  The
+ * rar volume names are not ambiguous. */
+static gboolean
+volume_set_is_valid (VolumeName   *vname,
+		     Volume       *volumes,
+		     int           n_volumes,
+		     GCancellable *cancellable)
+{
+	int i;
+
+	if (vname->type != VOLUME_NAME_NUMBER)
+		return TRUE;
+
+	for (i = 1; i < n_volumes - 1; i++)
+		if (volumes[i].size != volumes[0].size)
+			return FALSE;
+
+	if (volumes[n_volumes - 1].size > volumes[0].size)
+		return FALSE;
+
+	for (i = 1; i < n_volumes; i++)
+		if (file_starts_with_archive_signature (volumes[i].file, cancellable))
+			return FALSE;
+
+	return TRUE;
+}
+
+
+/* Returns the volumes following @file, which must be part of them, or NULL
+ * if @file is not a volume of a multi-volume archive. */
+VolumeSet *
+volume_set_new (GFile        *file,
+		GCancellable *cancellable)
+{
+	char       *basename;
+	char       *name;
+	VolumeName  vname;
+	GFile      *parent;
+	GArray     *volumes;
+	goffset     size;
+	gboolean    file_found;
+	VolumeSet  *set;
+	int         i;
+
+	basename = g_file_get_basename (file);
+	name = (basename != NULL) ? g_filename_to_utf8 (basename, -1, NULL, NULL, NULL) : NULL;
+	g_free (basename);
+
+	if ((name == NULL) || ! volume_name_parse (&vname, name)) {
+		g_free (name);
+		return NULL;
+	}
+	g_free (name);
+
+	parent = g_file_get_parent (file);
+	volumes = g_array_new (FALSE, FALSE, sizeof (Volume));
+	size = 0;
+	file_found = FALSE;
+	for (i = 0; /* void */; i++) {
+		char      *volume_name;
+		Volume     volume;
+		GFileInfo *info;
+
+		volume_name = volume_name_get_volume (&vname, i);
+		if (volume_name == NULL)
+			break;
+
+		volume.file = g_file_get_child (parent, volume_name);
+		g_free (volume_name);
+
+		info = g_file_query_info (volume.file,
+					  G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
+		if ((info == NULL)
+		    || (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+		    || (g_file_info_get_size (info) == 0))
+		{
+			_g_object_unref (info);
+			g_object_unref (volume.file);
+			break;
+		}
+
+		volume.offset = size;
+		volume.size = g_file_info_get_size (info);
+		size += volume.size;
+		g_array_append_val (volumes, volume);
+
+		if (g_file_equal (volume.file, file))
+			file_found = TRUE;
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (parent);
+
+	if (file_found && (volumes->len >= 2)
+	    && ! volume_set_is_valid (&vname, (Volume *) volumes->data, volumes->len, cancellable))
+	{
+		file_found = FALSE;
+	}
+	volume_name_clear (&vname);
+
+	if (! file_found || (volumes->len < 2)) {
+		for (i = 0; i < volumes->len; i++)
+			g_object_unref (g_array_index (volumes, Volume, i).file);
+		g_array_free (volumes, TRUE);
+		return NULL;
+	}
+
+	set = g_new0 (VolumeSet, 1);
+	set->n_volumes = volumes->len;
+	set->volumes = (Volume *) g_array_free (volumes, FALSE);
+	set->size = size;
+	set->position = 0;
+	set->current = -1;
+	set->read_ahead_volume = -1;
+
+	return set;
+}
+
+
+static ReadAhead *
+volume_set_join_read_ahead (VolumeSet *set,
+			    int        n_volume)
+{
+	ReadAhead *read_ahead;
+
+	if (set->read_ahead_thread == NULL)
+		return NULL;
+
+	if (set->read_ahead_volume != n_volume)
+		g_cancellable_cancel (set->read_ahead->cancellable);
+
+	read_ahead = g_thread_join (set->read_ahead_thread);
+	set->read_ahead_thread = NULL;
+	set->read_ahead = NULL;
+
+	if (set->read_ahead_volume != n_volume) {
+		read_ahead_free (read_ahead);
+		read_ahead = NULL;
+	}
+	set->read_ahead_volume = -1;
+
+	return read_ahead;
+}
+
+
+void
+volume_set_free (VolumeSet *set)
+{
+	int i;
+
+	if (set == NULL)
+		return;
+
+	volume_set_join_read_ahead (set, -1);
+	_g_object_unref (set->stream);
+	if (set->head != NULL)
+		g_bytes_unref (set->head);
+	for (i = 0; i < set->n_volumes; i++)
+		g_object_unref (set->volumes[i].file);
+	g_free (set->volumes);
+	g_free (set);
+}
+
+
+int
+volume_set_get_n_volumes (VolumeSet *set)
+{
+	return set->n_volumes;
+}
+
+
+GFile *
+volume_set_get_first_volume (VolumeSet *set)
+{
+	return set->volumes[0].file;
+}
+
+
+goffset
+volume_set_get_size (VolumeSet *set)
+{
+	return set->size;
+}
+
+
+goffset
+volume_set_tell (VolumeSet *set)
+{
+	return set->position;
+}
+
+
+goffset
+volume_set_seek (VolumeSet *set,
+		 goffset    offset,
+		 GSeekType  type)
+{
+	switch (type) {
+	case G_SEEK_SET:
+		break;
+	case G_SEEK_CUR:
+		offset += set->position;
+		break;
+	case G_SEEK_END:
+		offset += set->size;
+		break;
+	}
+
+	if (offset < 0)
+		return -1;
+
+	set->position = offset;
+
+	return set->position;
+}
+
+
+static int
+volume_set_find_volume (VolumeSet *set,
+			goffset    position)
+{
+	int first = 0;
+	int last = set->n_volumes - 1;
+
+	while (first < last) {
+		int middle = (first + last + 1) / 2;
+
+		if (set->volumes[middle].offset <= position)
+			first = middle;
+		else
+			last = middle - 1;
+	}
+
+	return first;
+}
+
+
+static void
+volume_set_start_read_ahead (VolumeSet *set,
+			     int        n_volume)
+{
+	if (n_volume >= set->n_volumes)
+		return;
+
+	set->read_ahead = g_new0 (ReadAhead, 1);
+	set->read_ahead->file = g_object_ref (set->volumes[n_volume].file);
+	set->read_ahead->cancellable = g_cancellable_new ();
+	set->read_ahead_volume = n_volume;
+	set->read_ahead_thread = g_thread_new ("volume-read-ahead", read_ahead_thread, set->read_ahead);
+}
+
+
+static gboolean
+volume_set_open_volume (VolumeSet     *set,
+			int            n_volume,
+			GCancellable  *cancellable,
+			GError       **error)
+{
+	ReadAhead *read_ahead;
+
+	if (set->current == n_volume)
+		return TRUE;
+
+	_g_clear_object (&set->stream);
+	if (set->head != NULL) {
+		g_bytes_unref (set->head);
+		set->head = NULL;
+	}
+	set->current = -1;
+
+	read_ahead = volume_set_join_read_ahead (set, n_volume);
+	if (read_ahead != NULL) {
+		if (read_ahead->stream != NULL) {
+			set->stream = g_object_ref (read_ahead->stream);
+			set->head = g_bytes_ref (read_ahead->head);
+			set->stream_position = g_bytes_get_size (set->head);
+		}
+		read_ahead_free (read_ahead);
+	}
+
+	if (set->stream == NULL) {
+		set->stream = (GInputStream *) g_file_read (set->volumes[n_volume].file, cancellable, error);
+		if (set->stream == NULL)
+			return FALSE;
+		set->stream_position = 0;
+	}
+
+	set->current = n_volume;
+	volume_set_start_read_ahead (set, n_volume + 1);
+
+	return TRUE;
+}
+
+
+/* Reads at most up to the end of the current volume. */
+gssize
+volume_set_read (VolumeSet     *set,
+		 void          *buffer,
+		 gsize          size,
+		 GCancellable  *cancellable,
+		 GError       **error)
+{
+	int     n_volume;
+	Volume *volume;
+	goffset offset;
+	gsize   head_size;
+	gssize  bytes_read;
+
+	if (set->position >= set->size)
+		return 0;
+
+	n_volume = volume_set_find_volume (set, set->position);
+	if (! volume_set_open_volume (set, n_volume, cancellable, error))
+		return -1;
+
+	volume = set->volumes + n_volume;
+	offset = set->position - volume->offset;
+	size = MIN (size, volume->size - offset);
+
+	head_size = (set->head != NULL) ? g_bytes_get_size (set->head) : 0;
+	if (offset < head_size) {
+		bytes_read = MIN (size, head_size - offset);
+		memcpy (buffer, (const char *) g_bytes_get_data (set->head, NULL) + offset, bytes_read);
+	}
+	else {
+		if (offset != set->stream_position) {
+			if (! g_seekable_seek (G_SEEKABLE (set->stream), offset, G_SEEK_SET, cancellable, error))
+				return -1;
+			set->stream_position = offset;
+		}
+
+		bytes_read = g_input_stream_read (set->stream, buffer, size, cancellable, error);
+		if (bytes_read < 0)
+			return -1;
+		set->stream_position += bytes_read;
+	}
+
+	set->position += bytes_read;
+
+	return bytes_read;
+}
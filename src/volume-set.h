@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/*
+ *  File-Roller
+ *
+ *  Copyright (C) 2017 Free Software Foundation, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOLUME_SET_H
+#define VOLUME_SET_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* The volumes of a multi-volume archive (name.part1.rar, name.part2.rar...,
+ * name.rar, name.r00..., name.001, name.002...) read as a single seekable
+ * stream.  The beginning of the next volume is read in a separate thread
+ * while the current one is being read. */
+
+typedef struct _VolumeSet VolumeSet;
+
+char *      volume_set_get_first_volume_name  (const char    *name);
+char *      volume_set_get_split_archive_name (GFile         *file);
+gboolean    volume_set_is_split_volume        (GFile         *file);
+VolumeSet * volume_set_new                    (GFile         *file,
+					       GCancellable  *cancellable);
+void        volume_set_free                   (VolumeSet     *set);
+int         volume_set_get_n_volumes          (VolumeSet     *set);
+GFile *     volume_set_get_first_volume       (VolumeSet     *set);
+goffset     volume_set_get_size               (VolumeSet     *set);
+goffset     volume_set_tell                   (VolumeSet     *set);
+goffset     volume_set_seek                   (VolumeSet     *set,
+					       goffset        offset,
+					       GSeekType      type);
+gssize      volume_set_read                   (VolumeSet     *set,
+					       void          *buffer,
+					       gsize          size,
+					       GCancellable  *cancellable,
+					       GError       **error);
+
+#endif /* VOLUME_SET_H */